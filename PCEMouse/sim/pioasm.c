@@ -0,0 +1,634 @@
+/*
+ * pioasm.c - minimal PIO assembler for the host simulator
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+//--------------------------------------------------------------------+
+// Turns a .pio file into the same kind of header the SDK's pioasm
+// generates (instruction array, wrap defines, program struct, default
+// config, and the "% c-sdk" block copied as-is), so that the unmodified
+// firmware sources can be compiled against the simulator without the SDK.
+//
+// Only what the PIO programs in this repository need is supported:
+// .program, .define, .origin, .wrap_target, .wrap, (public) labels,
+// [delay], and every instruction; .side_set is rejected.
+//
+// usage: pioasm input.pio output.pio.h
+//--------------------------------------------------------------------+
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#define MAX_PROGRAMS  8
+#define MAX_INSTR     32
+#define MAX_SYMBOLS   64
+#define MAX_TOKENS    16
+#define MAX_LINE      512
+
+typedef struct
+{
+  char name[64];
+  int  value;
+  bool is_public;
+  bool is_label;
+} symbol_t;
+
+typedef struct
+{
+  char     name[64];
+  int      origin;
+  int      wrap_target;
+  int      wrap;
+  int      count;
+  uint16_t instr[MAX_INSTR];
+  char     text[MAX_INSTR][MAX_LINE];
+  int      line[MAX_INSTR];             // source line, for pass 2 errors
+  symbol_t sym[MAX_SYMBOLS];
+  int      nsym;
+} program_t;
+
+static program_t prog[MAX_PROGRAMS];
+static int       nprog = 0;
+
+static char     *csdk = NULL;           // all "% c-sdk" blocks, in order
+static size_t    csdk_len = 0;
+
+static const char *src_name;
+static int         src_line;
+
+
+static void fail(const char *fmt, ...)
+{
+  va_list ap;
+
+  fprintf(stderr, "%s:%d: ", src_name, src_line);
+  va_start(ap, fmt);
+  vfprintf(stderr, fmt, ap);
+  va_end(ap);
+  fprintf(stderr, "\n");
+  exit(1);
+}
+
+static void csdk_append(const char *s)
+{
+  size_t n = strlen(s);
+
+  csdk = realloc(csdk, csdk_len + n + 1);
+  memcpy(csdk + csdk_len, s, n + 1);
+  csdk_len += n;
+}
+
+//--------------------------------------------------------------------+
+// Symbols and values
+//--------------------------------------------------------------------+
+
+static symbol_t *find_symbol(program_t *p, const char *name)
+{
+  int i;
+
+  for (i = 0; i < p->nsym; i++)
+    if (strcmp(p->sym[i].name, name) == 0)
+      return &p->sym[i];
+
+  return NULL;
+}
+
+static void add_symbol(program_t *p, const char *name, int value, bool is_public, bool is_label)
+{
+  symbol_t *s;
+
+  if (find_symbol(p, name))
+    fail("'%s' is already defined", name);
+  if (p->nsym >= MAX_SYMBOLS)
+    fail("too many symbols");
+
+  s = &p->sym[p->nsym++];
+  snprintf(s->name, sizeof(s->name), "%s", name);
+  s->value = value;
+  s->is_public = is_public;
+  s->is_label = is_label;
+}
+
+//
+// value - a number (decimal, 0x.., 0b..), or a symbol; labels are only
+//         known in the second pass, which is the only one that encodes
+//
+static int value(program_t *p, const char *tok)
+{
+  symbol_t *s;
+  char *end;
+  long v;
+
+  if ((tok[0] == '0') && ((tok[1] == 'b') || (tok[1] == 'B')))
+    v = strtol(tok + 2, &end, 2);
+  else
+    v = strtol(tok, &end, 0);
+
+  if ((end != tok) && (*end == '\0'))
+    return (int)v;
+
+  s = find_symbol(p, tok);
+  if (s == NULL)
+    fail("unknown symbol '%s'", tok);
+
+  return s->value;
+}
+
+static int lookup(const char *tok, const char *const *names, int count, const char *what)
+{
+  int i;
+
+  for (i = 0; i < count; i++)
+    if (names[i] && (strcasecmp(tok, names[i]) == 0))
+      return i;
+
+  fail("bad %s '%s'", what, tok);
+  return 0;
+}
+
+static int bit_count(program_t *p, const char *tok)
+{
+  int n = value(p, tok);
+
+  if ((n < 1) || (n > 32))
+    fail("bit count must be 1..32");
+
+  return n & 0x1f;                      // 32 is encoded as 0
+}
+
+//--------------------------------------------------------------------+
+// Instructions
+//--------------------------------------------------------------------+
+
+static const char *const jmp_cond[]  = { "", "!x", "x--", "!y", "y--", "x!=y", "pin", "!osre" };
+static const char *const in_src[]    = { "pins", "x", "y", "null", NULL, NULL, "isr", "osr" };
+static const char *const out_dst[]   = { "pins", "x", "y", "null", "pindirs", "pc", "isr", "exec" };
+static const char *const mov_dst[]   = { "pins", "x", "y", NULL, "exec", "pc", "isr", "osr" };
+static const char *const mov_src[]   = { "pins", "x", "y", "null", NULL, "status", "isr", "osr" };
+static const char *const set_dst[]   = { "pins", "x", "y", NULL, "pindirs" };
+static const char *const wait_src[]  = { "gpio", "pin", "irq" };
+
+//
+// irq_index - an IRQ number, with the optional "rel" suffix (bit 4)
+//
+static int irq_index(program_t *p, char **tok, int ntok, int i)
+{
+  int n;
+
+  if (i >= ntok)
+    fail("missing irq number");
+
+  n = value(p, tok[i]);
+  if ((n < 0) || (n > 7))
+    fail("irq number must be 0..7");
+
+  if ((i + 1 < ntok) && (strcasecmp(tok[i + 1], "rel") == 0))
+    n |= 0x10;
+
+  return n;
+}
+
+static uint16_t encode(program_t *p, char **tok, int ntok)
+{
+  const char *op = tok[0];
+  int i, n;
+
+  if (strcasecmp(op, "nop") == 0)
+    return 0xa042;                      // mov y, y
+
+  if (strcasecmp(op, "jmp") == 0)
+  {
+    int cond = 0;
+
+    if (ntok == 3)
+      cond = lookup(tok[1], jmp_cond, 8, "jmp condition");
+    else if (ntok != 2)
+      fail("jmp takes a condition and a target");
+
+    n = value(p, tok[ntok - 1]);
+    if ((n < 0) || (n >= MAX_INSTR))
+      fail("jmp target out of range");
+
+    return 0x0000 | (cond << 5) | n;
+  }
+
+  if (strcasecmp(op, "wait") == 0)
+  {
+    int pol, src;
+
+    if (ntok < 4)
+      fail("wait takes a polarity, a source and an index");
+
+    pol = value(p, tok[1]) & 1;
+    src = lookup(tok[2], wait_src, 3, "wait source");
+    n = (src == 2) ? irq_index(p, tok, ntok, 3) : value(p, tok[3]);
+
+    return 0x2000 | (pol << 7) | (src << 5) | (n & 0x1f);
+  }
+
+  if (strcasecmp(op, "in") == 0)
+  {
+    if (ntok != 3)
+      fail("in takes a source and a bit count");
+
+    return 0x4000 | (lookup(tok[1], in_src, 8, "in source") << 5) | bit_count(p, tok[2]);
+  }
+
+  if (strcasecmp(op, "out") == 0)
+  {
+    if (ntok != 3)
+      fail("out takes a destination and a bit count");
+
+    return 0x6000 | (lookup(tok[1], out_dst, 8, "out destination") << 5) | bit_count(p, tok[2]);
+  }
+
+  if ((strcasecmp(op, "push") == 0) || (strcasecmp(op, "pull") == 0))
+  {
+    bool pull = (strcasecmp(op, "pull") == 0);
+    int cond = 0;
+    int block = 1;
+
+    for (i = 1; i < ntok; i++)
+    {
+      if (strcasecmp(tok[i], pull ? "ifempty" : "iffull") == 0)
+        cond = 1;
+      else if (strcasecmp(tok[i], "block") == 0)
+        block = 1;
+      else if (strcasecmp(tok[i], "noblock") == 0)
+        block = 0;
+      else
+        fail("bad %s option '%s'", op, tok[i]);
+    }
+
+    return 0x8000 | (pull << 7) | (cond << 6) | (block << 5);
+  }
+
+  if (strcasecmp(op, "mov") == 0)
+  {
+    const char *src;
+    int mop = 0;
+
+    if (ntok != 3)
+      fail("mov takes a destination and a source");
+
+    src = tok[2];
+    if ((src[0] == '!') || (src[0] == '~'))
+    {
+      mop = 1;
+      src++;
+    }
+    else if ((src[0] == ':') && (src[1] == ':'))
+    {
+      mop = 2;
+      src += 2;
+    }
+
+    return 0xa000 | (lookup(tok[1], mov_dst, 8, "mov destination") << 5) | (mop << 3) |
+           lookup(src, mov_src, 8, "mov source");
+  }
+
+  if (strcasecmp(op, "irq") == 0)
+  {
+    int clr = 0;
+    int wait = 0;
+
+    i = 1;
+    if (i < ntok)
+    {
+      if (strcasecmp(tok[i], "set") == 0 || strcasecmp(tok[i], "nowait") == 0)
+        i++;
+      else if (strcasecmp(tok[i], "wait") == 0)
+      {
+        wait = 1;
+        i++;
+      }
+      else if (strcasecmp(tok[i], "clear") == 0)
+      {
+        clr = 1;
+        i++;
+      }
+    }
+
+    return 0xc000 | (clr << 6) | (wait << 5) | irq_index(p, tok, ntok, i);
+  }
+
+  if (strcasecmp(op, "set") == 0)
+  {
+    if (ntok != 3)
+      fail("set takes a destination and a value");
+
+    n = value(p, tok[2]);
+    if ((n < 0) || (n > 31))
+      fail("set value must be 0..31");
+
+    return 0xe000 | (lookup(tok[1], set_dst, 5, "set destination") << 5) | n;
+  }
+
+  fail("unknown instruction '%s'", op);
+  return 0;
+}
+
+//--------------------------------------------------------------------+
+// Parsing
+//--------------------------------------------------------------------+
+
+static char *trim(char *s)
+{
+  char *e;
+
+  while (isspace((unsigned char)*s))
+    s++;
+
+  e = s + strlen(s);
+  while ((e > s) && isspace((unsigned char)e[-1]))
+    *--e = '\0';
+
+  return s;
+}
+
+static int tokenize(char *s, char **tok)
+{
+  int n = 0;
+  char *t;
+
+  for (t = strtok(s, " \t,"); t && (n < MAX_TOKENS); t = strtok(NULL, " \t,"))
+    tok[n++] = t;
+
+  return n;
+}
+
+//
+// parse - pass 1 collects the symbols and the c-sdk blocks; pass 2 encodes
+//
+static void parse(FILE *f, int pass)
+{
+  char buf[MAX_LINE];
+  char *tok[MAX_TOKENS];
+  program_t *p = NULL;
+  bool in_csdk = false;
+  bool in_other = false;
+  int pi = -1;
+  int ntok;
+
+  src_line = 0;
+
+  while (fgets(buf, sizeof(buf), f))
+  {
+    char *s, *c;
+    int delay = 0;
+
+    src_line++;
+
+    if (in_csdk || in_other)
+    {
+      if (strncmp(buf, "%}", 2) == 0)
+        in_csdk = in_other = false;
+      else if (in_csdk && (pass == 1))
+        csdk_append(buf);
+      continue;
+    }
+
+    if (buf[0] == '%')
+    {
+      if (strstr(buf, "c-sdk"))
+        in_csdk = true;
+      else
+        in_other = true;
+      continue;
+    }
+
+    // strip comments
+    if ((c = strchr(buf, ';')) != NULL)
+      *c = '\0';
+    if ((c = strstr(buf, "//")) != NULL)
+      *c = '\0';
+
+    s = trim(buf);
+    if (*s == '\0')
+      continue;
+
+    // directives
+    if (*s == '.')
+    {
+      ntok = tokenize(s, tok);
+
+      if (strcasecmp(tok[0], ".program") == 0)
+      {
+        if (ntok != 2)
+          fail(".program needs a name");
+
+        pi++;
+        if (pass == 1)
+        {
+          if (nprog >= MAX_PROGRAMS)
+            fail("too many programs");
+          p = &prog[nprog++];
+          memset(p, 0, sizeof(*p));
+          snprintf(p->name, sizeof(p->name), "%s", tok[1]);
+          p->origin = -1;
+          p->wrap_target = -1;
+          p->wrap = -1;
+        }
+        else
+        {
+          p = &prog[pi];
+          p->count = 0;
+        }
+        continue;
+      }
+
+      if (p == NULL)
+        fail("directive outside a program");
+
+      if (strcasecmp(tok[0], ".define") == 0)
+      {
+        bool pub = (ntok == 4) && (strcasecmp(tok[1], "public") == 0);
+
+        if (ntok != (pub ? 4 : 3))
+          fail(".define needs a name and a value");
+
+        if (pass == 1)
+          add_symbol(p, tok[pub ? 2 : 1], value(p, tok[pub ? 3 : 2]), pub, false);
+      }
+      else if (strcasecmp(tok[0], ".origin") == 0)
+        p->origin = value(p, tok[1]);
+      else if (strcasecmp(tok[0], ".wrap_target") == 0)
+        p->wrap_target = p->count;
+      else if (strcasecmp(tok[0], ".wrap") == 0)
+        p->wrap = p->count - 1;
+      else if (strcasecmp(tok[0], ".side_set") == 0)
+        fail(".side_set is not supported by the simulator's assembler");
+      else if (strcasecmp(tok[0], ".lang_opt") != 0)
+        fail("unknown directive '%s'", tok[0]);
+      continue;
+    }
+
+    if (p == NULL)
+      fail("instruction outside a program");
+
+    // labels (possibly followed by an instruction on the same line)
+    if ((c = strchr(s, ':')) != NULL && (c[1] != ':') && (c == s || c[-1] != ':'))
+    {
+      char *name = s;
+      bool pub = false;
+
+      *c = '\0';
+      s = trim(c + 1);
+
+      name = trim(name);
+      if (strncasecmp(name, "public", 6) == 0 && isspace((unsigned char)name[6]))
+      {
+        pub = true;
+        name = trim(name + 6);
+      }
+
+      if (pass == 1)
+        add_symbol(p, name, p->count, pub, true);
+
+      if (*s == '\0')
+        continue;
+    }
+
+    // [delay]
+    if ((c = strchr(s, '[')) != NULL)
+    {
+      char *e = strchr(c, ']');
+
+      if (e == NULL)
+        fail("missing ']'");
+      *e = '\0';
+      if (pass == 2)
+        delay = value(p, trim(c + 1));
+      *c = '\0';
+      if ((delay < 0) || (delay > 31))
+        fail("delay must be 0..31");
+    }
+
+    if (p->count >= MAX_INSTR)
+      fail("program too long");
+
+    if (pass == 2)
+    {
+      snprintf(p->text[p->count], MAX_LINE, "%s", trim(s));
+      if (delay)
+        snprintf(p->text[p->count] + strlen(p->text[p->count]),
+                 MAX_LINE - strlen(p->text[p->count]), " [%d]", delay);
+
+      ntok = tokenize(trim(s), tok);
+      p->instr[p->count] = encode(p, tok, ntok) | (delay << 8);
+      p->line[p->count] = src_line;
+    }
+
+    p->count++;
+  }
+
+  if (in_csdk || in_other)
+    fail("unterminated %% block");
+}
+
+//--------------------------------------------------------------------+
+// Output
+//--------------------------------------------------------------------+
+
+static void emit(FILE *o)
+{
+  int i, j;
+
+  fprintf(o, "// -------------------------------------------------- //\n");
+  fprintf(o, "// This file is autogenerated by the simulator's pioasm //\n");
+  fprintf(o, "// -------------------------------------------------- //\n\n");
+  fprintf(o, "#pragma once\n\n");
+  fprintf(o, "#if !PICO_NO_HARDWARE\n#include \"hardware/pio.h\"\n#endif\n\n");
+
+  for (i = 0; i < nprog; i++)
+  {
+    program_t *p = &prog[i];
+    int wt = (p->wrap_target < 0) ? 0 : p->wrap_target;
+    int wr = (p->wrap < 0) ? p->count - 1 : p->wrap;
+
+    fprintf(o, "// %.*s //\n", (int)strlen(p->name) + 2, "----------------------------------------------------------------");
+    fprintf(o, "// %s //\n", p->name);
+    fprintf(o, "// %.*s //\n\n", (int)strlen(p->name) + 2, "----------------------------------------------------------------");
+
+    fprintf(o, "#define %s_wrap_target %d\n", p->name, wt);
+    fprintf(o, "#define %s_wrap %d\n\n", p->name, wr);
+
+    for (j = 0; j < p->nsym; j++)
+      if (p->sym[j].is_public)
+        fprintf(o, "#define %s_%s%s %d\n", p->name, p->sym[j].is_label ? "offset_" : "",
+                p->sym[j].name, p->sym[j].value);
+
+    fprintf(o, "\nstatic const uint16_t %s_program_instructions[] = {\n", p->name);
+    for (j = 0; j < p->count; j++)
+    {
+      if (j == wt)
+        fprintf(o, "            //     .wrap_target\n");
+      fprintf(o, "    0x%04x, // %2d: %s\n", p->instr[j], j, p->text[j]);
+      if (j == wr)
+        fprintf(o, "            //     .wrap\n");
+    }
+    fprintf(o, "};\n\n");
+
+    fprintf(o, "#if !PICO_NO_HARDWARE\n");
+    fprintf(o, "static const struct pio_program %s_program = {\n", p->name);
+    fprintf(o, "    .instructions = %s_program_instructions,\n", p->name);
+    fprintf(o, "    .length = %d,\n", p->count);
+    fprintf(o, "    .origin = %d,\n", p->origin);
+    fprintf(o, "};\n\n");
+    fprintf(o, "static inline pio_sm_config %s_program_get_default_config(uint offset) {\n", p->name);
+    fprintf(o, "    pio_sm_config c = pio_get_default_sm_config();\n");
+    fprintf(o, "    sm_config_set_wrap(&c, offset + %s_wrap_target, offset + %s_wrap);\n", p->name, p->name);
+    fprintf(o, "    return c;\n}\n#endif\n\n");
+  }
+
+  if (csdk)
+  {
+    fprintf(o, "#if !PICO_NO_HARDWARE\n");
+    fputs(csdk, o);
+    fprintf(o, "#endif\n\n");
+  }
+}
+
+int main(int argc, char **argv)
+{
+  FILE *f, *o;
+
+  if (argc != 3)
+  {
+    fprintf(stderr, "usage: %s input.pio output.pio.h\n", argv[0]);
+    return 2;
+  }
+
+  src_name = argv[1];
+  f = fopen(argv[1], "r");
+  if (f == NULL)
+  {
+    perror(argv[1]);
+    return 1;
+  }
+
+  parse(f, 1);
+  rewind(f);
+  parse(f, 2);
+  fclose(f);
+
+  o = fopen(argv[2], "w");
+  if (o == NULL)
+  {
+    perror(argv[2]);
+    return 1;
+  }
+
+  emit(o);
+  fclose(o);
+
+  return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * bsp/board.h - simulator stand-in for the TinyUSB board support header
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_BSP_BOARD_H_
+#define _SIM_BSP_BOARD_H_
+
+#include "pico/stdlib.h"
+
+void     board_init(void);
+uint32_t board_millis(void);
+void     board_led_write(bool state);
+
+#endif /* _SIM_BSP_BOARD_H_ */
@@ -0,0 +1,29 @@
+/*
+ * hardware/flash.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_FLASH_H_
+#define _SIM_HARDWARE_FLASH_H_
+
+#include <stddef.h>
+
+#include "pico/types.h"
+
+// The flash is an array which starts out blank; it is read through
+// XIP_BASE as on the Pico, and programmed at once (no time passes)
+//
+#define FLASH_PAGE_SIZE         256
+#define FLASH_SECTOR_SIZE       4096
+#define PICO_FLASH_SIZE_BYTES   (2 * 1024 * 1024)
+
+extern uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+#define XIP_BASE                ((uintptr_t)sim_flash)
+
+void flash_range_erase(uint32_t flash_offs, size_t count);
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
+
+#endif /* _SIM_HARDWARE_FLASH_H_ */
@@ -0,0 +1,32 @@
+/*
+ * hardware/gpio.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_GPIO_H_
+#define _SIM_HARDWARE_GPIO_H_
+
+#include "pico/types.h"
+
+#define GPIO_IN   false
+#define GPIO_OUT  true
+
+enum gpio_override
+{
+  GPIO_OVERRIDE_NORMAL = 0,
+  GPIO_OVERRIDE_INVERT = 1,
+  GPIO_OVERRIDE_LOW = 2,
+  GPIO_OVERRIDE_HIGH = 3,
+};
+
+void gpio_init(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+void gpio_pull_up(uint gpio);
+void gpio_pull_down(uint gpio);
+void gpio_set_inover(uint gpio, uint value);    // what the PIO and gpio_get() see
+
+#endif /* _SIM_HARDWARE_GPIO_H_ */
@@ -0,0 +1,180 @@
+/*
+ * hardware/pio.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_PIO_H_
+#define _SIM_HARDWARE_PIO_H_
+
+#include "pico/types.h"
+#include "hardware/gpio.h"
+
+//--------------------------------------------------------------------+
+// The two PIO blocks are interpreted instruction by instruction, at the
+// system clock (see sim_pio.c). The configuration is kept as plain
+// fields rather than register images; only the accessors below are
+// meant to be used on it, as with the SDK.
+//
+// Of the registers, only the FIFOs are here, and only for their
+// addresses (for DMA; the state machines are kept in sim_pio.c).
+//--------------------------------------------------------------------+
+
+#define NUM_PIOS           2
+#define NUM_PIO_STATE_MACHINES  4
+#define PIO_INSTRUCTION_COUNT   32
+
+typedef struct
+{
+  volatile uint32_t txf[NUM_PIO_STATE_MACHINES];
+  volatile uint32_t rxf[NUM_PIO_STATE_MACHINES];
+} pio_hw_t;
+
+typedef pio_hw_t *PIO;
+
+extern pio_hw_t sim_pio0;
+extern pio_hw_t sim_pio1;
+
+#define pio0  (&sim_pio0)
+#define pio1  (&sim_pio1)
+
+enum pio_fifo_join
+{
+  PIO_FIFO_JOIN_NONE = 0,
+  PIO_FIFO_JOIN_TX = 1,
+  PIO_FIFO_JOIN_RX = 2,
+};
+
+enum pio_mov_status_type
+{
+  STATUS_TX_LESSTHAN = 0,
+  STATUS_RX_LESSTHAN = 1,
+};
+
+typedef struct
+{
+  uint32_t clkdiv_256;        // clock divider, in 1/256ths
+  uint8_t  wrap_target;
+  uint8_t  wrap;
+  uint8_t  in_base;
+  uint8_t  out_base;
+  uint8_t  out_count;
+  uint8_t  set_base;
+  uint8_t  set_count;
+  uint8_t  jmp_pin;
+  bool     in_shift_right;
+  bool     autopush;
+  uint8_t  push_threshold;    // 1..32
+  bool     out_shift_right;
+  bool     autopull;
+  uint8_t  pull_threshold;    // 1..32
+  uint8_t  fifo_join;
+  uint8_t  status_sel;
+  uint8_t  status_n;
+} pio_sm_config;
+
+typedef struct pio_program
+{
+  const uint16_t *instructions;
+  uint8_t         length;
+  int8_t          origin;     // required instruction memory origin or -1
+} pio_program_t;
+
+pio_sm_config pio_get_default_sm_config(void);
+
+static inline void sm_config_set_wrap(pio_sm_config *c, uint wrap_target, uint wrap)
+{
+  c->wrap_target = wrap_target;
+  c->wrap = wrap;
+}
+
+static inline void sm_config_set_in_pins(pio_sm_config *c, uint in_base)
+{
+  c->in_base = in_base;
+}
+
+static inline void sm_config_set_out_pins(pio_sm_config *c, uint out_base, uint out_count)
+{
+  c->out_base = out_base;
+  c->out_count = out_count;
+}
+
+static inline void sm_config_set_set_pins(pio_sm_config *c, uint set_base, uint set_count)
+{
+  c->set_base = set_base;
+  c->set_count = set_count;
+}
+
+static inline void sm_config_set_jmp_pin(pio_sm_config *c, uint pin)
+{
+  c->jmp_pin = pin;
+}
+
+static inline void sm_config_set_in_shift(pio_sm_config *c, bool shift_right, bool autopush, uint push_threshold)
+{
+  c->in_shift_right = shift_right;
+  c->autopush = autopush;
+  c->push_threshold = (push_threshold == 0) ? 32 : push_threshold;
+}
+
+static inline void sm_config_set_out_shift(pio_sm_config *c, bool shift_right, bool autopull, uint pull_threshold)
+{
+  c->out_shift_right = shift_right;
+  c->autopull = autopull;
+  c->pull_threshold = (pull_threshold == 0) ? 32 : pull_threshold;
+}
+
+static inline void sm_config_set_clkdiv_int_frac(pio_sm_config *c, uint16_t div_int, uint8_t div_frac)
+{
+  c->clkdiv_256 = ((uint32_t)(div_int ? div_int : 65536) << 8) | div_frac;
+}
+
+static inline void sm_config_set_clkdiv(pio_sm_config *c, float div)
+{
+  c->clkdiv_256 = (uint32_t)(div * 256.0f);
+  if (c->clkdiv_256 < 256)
+    c->clkdiv_256 = 256;
+}
+
+static inline void sm_config_set_fifo_join(pio_sm_config *c, enum pio_fifo_join join)
+{
+  c->fifo_join = join;
+}
+
+static inline void sm_config_set_mov_status(pio_sm_config *c, enum pio_mov_status_type status_sel, uint status_n)
+{
+  c->status_sel = status_sel;
+  c->status_n = status_n;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program);
+bool pio_can_add_program(PIO pio, const pio_program_t *program);
+int  pio_claim_unused_sm(PIO pio, bool required);
+void pio_sm_claim(PIO pio, uint sm);
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config);
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled);
+void pio_sm_restart(PIO pio, uint sm);
+void pio_sm_clear_fifos(PIO pio, uint sm);
+void pio_gpio_init(PIO pio, uint pin);
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out);
+uint pio_get_index(PIO pio);
+
+// DREQ numbers as on the RP2040 (DREQ_PIO0_TX0 = 0 ...)
+//
+static inline uint pio_get_dreq(PIO pio, uint sm, bool is_tx)
+{
+  return (pio_get_index(pio) << 3) | (is_tx ? 0 : 4) | sm;
+}
+
+void     pio_sm_put(PIO pio, uint sm, uint32_t data);
+void     pio_sm_put_blocking(PIO pio, uint sm, uint32_t data);
+uint32_t pio_sm_get(PIO pio, uint sm);
+uint32_t pio_sm_get_blocking(PIO pio, uint sm);
+bool     pio_sm_is_rx_fifo_empty(PIO pio, uint sm);
+bool     pio_sm_is_tx_fifo_full(PIO pio, uint sm);
+bool     pio_sm_is_tx_fifo_empty(PIO pio, uint sm);
+uint     pio_sm_get_rx_fifo_level(PIO pio, uint sm);
+uint     pio_sm_get_tx_fifo_level(PIO pio, uint sm);
+
+#endif /* _SIM_HARDWARE_PIO_H_ */
@@ -0,0 +1,25 @@
+/*
+ * hardware/sync.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_SYNC_H_
+#define _SIM_HARDWARE_SYNC_H_
+
+#include "pico/types.h"
+
+// The simulated cores take turns on one host thread, so barriers are no-ops;
+// events (SEV/WFE) are modelled, as core 0 sleeps on them.
+//
+static inline void __dmb(void) { }
+static inline void __compiler_memory_barrier(void) { }
+
+void __sev(void);
+void __wfe(void);
+
+static inline uint32_t save_and_disable_interrupts(void) { return 0; }
+static inline void restore_interrupts(uint32_t status) { (void)status; }
+
+#endif /* _SIM_HARDWARE_SYNC_H_ */
@@ -0,0 +1,35 @@
+/*
+ * hardware/uart.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_UART_H_
+#define _SIM_HARDWARE_UART_H_
+
+#include "pico/types.h"
+
+// The firmware's output goes straight to the host (sim_printf), so the
+// UART's TX FIFO is always empty
+//
+#define UART_UARTFR_TXFE_BITS   0x00000080
+
+typedef struct
+{
+  volatile uint32_t fr;
+} uart_hw_t;
+
+typedef struct uart_inst uart_inst_t;
+
+#define uart_default    ((uart_inst_t *)0)
+
+static inline uart_hw_t *uart_get_hw(uart_inst_t *uart)
+{
+  static uart_hw_t hw = { UART_UARTFR_TXFE_BITS };
+
+  (void)uart;
+  return &hw;
+}
+
+#endif /* _SIM_HARDWARE_UART_H_ */
@@ -0,0 +1,22 @@
+/*
+ * pico/multicore.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_PICO_MULTICORE_H_
+#define _SIM_PICO_MULTICORE_H_
+
+#include "pico/types.h"
+
+void multicore_launch_core1(void (*entry)(void));
+
+// Flash writes are instantaneous here, so core 1 never has to be paused
+//
+static inline void multicore_lockout_victim_init(void) { }
+static inline bool multicore_lockout_victim_is_initialized(uint core_num) { (void)core_num; return false; }
+static inline void multicore_lockout_start_blocking(void) { }
+static inline void multicore_lockout_end_blocking(void) { }
+
+#endif /* _SIM_PICO_MULTICORE_H_ */
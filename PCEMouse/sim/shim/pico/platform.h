@@ -0,0 +1,17 @@
+/*
+ * pico/platform.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_PICO_PLATFORM_H_
+#define _SIM_PICO_PLATFORM_H_
+
+#include "pico/types.h"
+
+uint get_core_num(void);
+
+static inline void tight_loop_contents(void) { }
+
+#endif /* _SIM_PICO_PLATFORM_H_ */
@@ -0,0 +1,24 @@
+/*
+ * pico/stdlib.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_PICO_STDLIB_H_
+#define _SIM_PICO_STDLIB_H_
+
+#include <stdio.h>
+
+#include "pico/types.h"
+#include "pico/time.h"
+#include "pico/platform.h"
+#include "hardware/gpio.h"
+
+// the firmware's printf() (see the Makefile), checked as printf() is
+int  sim_printf(const char *fmt, ...) __attribute__((format(__printf__, 1, 2)));
+
+bool stdio_init_all(void);
+int  getchar_timeout_us(uint32_t timeout_us);
+
+#endif /* _SIM_PICO_STDLIB_H_ */
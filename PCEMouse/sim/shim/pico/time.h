@@ -0,0 +1,53 @@
+/*
+ * pico/time.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_PICO_TIME_H_
+#define _SIM_PICO_TIME_H_
+
+#include "pico/types.h"
+
+// Time is the simulated time of the calling core (see sim_sched.c)
+//
+uint32_t        time_us_32(void);
+uint64_t        time_us_64(void);
+absolute_time_t get_absolute_time(void);
+
+static inline uint64_t to_us_since_boot(absolute_time_t t)
+{
+  return t;
+}
+
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us)
+{
+  return t + us;
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us)
+{
+  return get_absolute_time() + us;
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms)
+{
+  return get_absolute_time() + ((uint64_t)ms * 1000);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to)
+{
+  return (int64_t)(to - from);
+}
+
+static inline bool time_reached(absolute_time_t t)
+{
+  return get_absolute_time() >= t;
+}
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+bool best_effort_wfe_or_timeout(absolute_time_t timeout);
+
+#endif /* _SIM_PICO_TIME_H_ */
@@ -0,0 +1,31 @@
+/*
+ * pico/types.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_PICO_TYPES_H_
+#define _SIM_PICO_TYPES_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef unsigned int uint;
+
+typedef uint64_t absolute_time_t;     // microseconds since boot
+
+// code placement has no meaning on the host
+#define __not_in_flash_func(f)    f
+#define __time_critical_func(f)   f
+#define __not_in_flash(group)
+#define __scratch_x(name)
+#define __scratch_y(name)
+
+#define count_of(a)   (sizeof(a) / sizeof((a)[0]))
+
+#define PICO_OK              0
+#define PICO_ERROR_TIMEOUT  (-1)
+
+#endif /* _SIM_PICO_TYPES_H_ */
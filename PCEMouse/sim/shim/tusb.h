@@ -0,0 +1,113 @@
+/*
+ * tusb.h - simulator stand-in for the TinyUSB host API used by the firmware
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_TUSB_H_
+#define _SIM_TUSB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//--------------------------------------------------------------------+
+// Devices are scripted by the simulator (see sim_usb.c): tuh_task()
+// mounts them and delivers their reports through the same callbacks
+// which TinyUSB would invoke.
+//--------------------------------------------------------------------+
+
+#define OPT_MCU_LPC18XX       6
+#define OPT_MCU_LPC43XX       7
+#define OPT_MCU_MIMXRT10XX    11
+#define OPT_MCU_RP2040        1100
+#define CFG_TUSB_MCU          OPT_MCU_RP2040
+
+#define OPT_OS_NONE           1
+#define OPT_MODE_HOST         0x0002
+#define OPT_MODE_HIGH_SPEED   0x0400
+
+#include "tusb_config.h"
+
+#define TU_ATTR_PACKED        __attribute__((packed))
+#define TU_ATTR_WEAK          __attribute__((weak))
+
+#define TU_LOG1(...)
+#define TU_LOG2(...)
+
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t modifier;
+  uint8_t reserved;
+  uint8_t keycode[6];
+} hid_keyboard_report_t;
+
+typedef struct TU_ATTR_PACKED
+{
+  uint8_t buttons;
+  int8_t  x;
+  int8_t  y;
+  int8_t  wheel;
+  int8_t  pan;
+} hid_mouse_report_t;
+
+typedef struct
+{
+  uint8_t  report_id;
+  uint8_t  usage;
+  uint16_t usage_page;
+} tuh_hid_report_info_t;
+
+typedef enum
+{
+  HID_ITF_PROTOCOL_NONE     = 0,
+  HID_ITF_PROTOCOL_KEYBOARD = 1,
+  HID_ITF_PROTOCOL_MOUSE    = 2,
+} hid_interface_protocol_enum_t;
+
+enum
+{
+  MOUSE_BUTTON_LEFT     = 1 << 0,
+  MOUSE_BUTTON_RIGHT    = 1 << 1,
+  MOUSE_BUTTON_MIDDLE   = 1 << 2,
+  MOUSE_BUTTON_BACKWARD = 1 << 3,
+  MOUSE_BUTTON_FORWARD  = 1 << 4,
+};
+
+enum
+{
+  KEYBOARD_MODIFIER_LEFTSHIFT  = 1 << 1,
+  KEYBOARD_MODIFIER_RIGHTSHIFT = 1 << 5,
+};
+
+enum
+{
+  HID_USAGE_PAGE_DESKTOP = 0x01,
+};
+
+enum
+{
+  HID_USAGE_DESKTOP_MOUSE    = 0x02,
+  HID_USAGE_DESKTOP_KEYBOARD = 0x06,
+};
+
+// no keyboard is ever scripted, so no translation table is needed
+#define HID_KEYCODE_TO_ASCII  { 0, 0 }
+
+bool    tusb_init(void);
+void    tuh_task(void);
+
+bool    tuh_vid_pid_get(uint8_t dev_addr, uint16_t *vid, uint16_t *pid);
+uint8_t tuh_hid_interface_protocol(uint8_t dev_addr, uint8_t instance);
+bool    tuh_hid_receive_report(uint8_t dev_addr, uint8_t instance);
+uint8_t tuh_hid_parse_report_descriptor(tuh_hid_report_info_t *report_info_arr, uint8_t arr_count,
+                                        uint8_t const *desc_report, uint16_t desc_len);
+
+// implemented by the firmware
+void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len);
+void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance);
+void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len);
+
+#endif /* _SIM_TUSB_H_ */
@@ -0,0 +1,151 @@
+/*
+ * sim.h - host-side simulator for PCEMouse: internal interfaces
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_H_
+#define _SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/types.h"
+#include "hardware/pio.h"
+
+//--------------------------------------------------------------------+
+// The firmware runs unmodified on top of stand-in SDK headers (shim/).
+// Everything which happens in parallel on the real board - the two
+// cores, the PIO state machines, the PC Engine and the USB mouse -
+// is a "thread" here, each with its own simulated time; a thread only
+// runs when it is the furthest behind, so each one sees the others (and
+// the PIO state machines, which are stepped cycle by cycle) exactly as
+// they were at its own time. The cores are switched only inside SDK
+// calls, which is where they observe each other on the real hardware.
+//
+// Time is counted in system clock cycles (125MHz).
+//
+// XE1AP's simulator (XE1AP/sim) runs on this one too, with its own
+// console, controller and DMA; sim_pce.c, sim_pad.c and sim_usb.c are not
+// part of it.
+//--------------------------------------------------------------------+
+
+// SIM_GAMEPAD: the USB device is a gamepad, and the console reads a joypad
+// (sim_pad.c) rather than a mouse. Always so with PAD_EMULATION; without it,
+// the gamepad is shown on the console port by the plex program instead.
+//
+#if defined(PAD_EMULATION) && !defined(SIM_GAMEPAD)
+#define SIM_GAMEPAD true
+#endif
+
+typedef uint64_t sim_time_t;
+
+#define SIM_CLOCK_HZ        125000000
+#define SIM_CYCLES_PER_US   125
+#define SIM_US(us)          ((sim_time_t)(us) * SIM_CYCLES_PER_US)
+#define SIM_NEVER           UINT64_MAX
+
+#define SIM_CALL_CYCLES     12      // rough cost of an SDK call, and the code around it
+#define SIM_WAKE_CYCLES     8       // from an event (FIFO, SEV, interrupt) to running again
+
+// Threads
+//
+enum
+{
+  SIM_CORE0 = 0,
+  SIM_CORE1,
+  SIM_CONSOLE,                      // the PC Engine
+  SIM_MOUSE,                        // the USB mouse
+  SIM_THREADS
+};
+
+extern sim_time_t sim_now;          // time up to which the PIO blocks have run
+
+void sim_thread_start(int id, void (*entry)(void), sim_time_t at);
+int  sim_thread_current(void);      // -1 outside of any thread
+void sim_run(sim_time_t end);
+
+void sim_sync(sim_time_t cost);     // spend 'cost', then catch the world up
+void sim_sleep_until(sim_time_t t);
+bool sim_wait(const void *object, sim_time_t timeout);  // false if timed out
+void sim_notify(const void *object);                    // wake its waiters
+void sim_event(int id);             // SEV/interrupt, to one core
+
+// Pins
+//
+bool sim_pin_level(uint pin);
+bool sim_pin_input(uint pin);       // as seen from inside (gpio_set_inover())
+void sim_pin_drive(uint pin, bool level);     // driven from outside (the console)
+void sim_pin_release(uint pin);
+
+// PIO blocks
+//
+extern bool sim_woken;              // a thread was woken by sim_notify()
+
+void sim_pio_run_until(sim_time_t t);     // stops early if a thread is woken
+void sim_pio_disturb(void);         // inputs changed: stop skipping idle loops
+
+// Other hardware which runs alongside the PIO blocks (DMA), stepped at
+// the end of each cycle in which anything runs; it returns true while it
+// has something to do, and anything which disturbs the PIO blocks also
+// counts as something to do
+//
+extern bool (*sim_hw_cycle)(void);
+
+// USB mouse (sim_usb.c)
+//
+typedef struct
+{
+  sim_time_t t;                     // when the firmware posted it
+  int32_t    cx;                    // cumulative motion, in firmware units
+  int32_t    cy;
+  uint8_t    buttons;               // PCE order Run/Sel/II/I, active-low
+  bool       moved;
+  uint32_t   reads_before;          // console reads started before it
+} sim_post_t;
+
+extern sim_post_t *sim_posts;       // everything posted to console port 1
+extern int         sim_post_count;
+extern int         sim_report_count;
+extern uint32_t    sim_report_rate_us;
+
+// ... and with SIM_GAMEPAD, everything posted to the joypad
+//
+typedef struct
+{
+  sim_time_t t;                     // when the firmware posted it
+  uint16_t   pad;                   // see post_pad() (active-low)
+} sim_pad_post_t;
+
+extern sim_pad_post_t *sim_pads;
+extern int             sim_pad_count;
+
+int        sim_usb_load(const char *script);
+sim_time_t sim_usb_duration(void);
+void       sim_usb_start(sim_time_t at);
+
+// Console (sim_pce.c; sim_pad.c with SIM_GAMEPAD)
+//
+typedef struct
+{
+  uint32_t frame_us;                // read period (one mouse read per frame)
+  uint32_t scan_gap_us;             // CLR edge to CLR edge within a read
+  uint32_t read_delay_us;           // CLR falling to sampling the data
+  uint32_t sel_delay_us;            // SEL change to sampling the data
+  uint32_t clr_us;                  // length of the CLR pulse
+  bool     relaxed;                 // extrapolation: a read may run ahead of the reports (by one report's move)
+  bool     trace;                   // print every read
+} sim_pce_cfg_t;
+
+extern sim_pce_cfg_t sim_pce_cfg;
+extern uint32_t      sim_reads_started;
+
+void sim_pce_start(sim_time_t measure_from);
+bool sim_pce_report(void);          // prints the results; false on failure
+
+// Firmware output (printf) is shown only if this is set
+//
+extern bool sim_firmware_output;
+
+#endif /* _SIM_H_ */
@@ -0,0 +1,115 @@
+/*
+ * sim_main.c - host-side simulator for PCEMouse: runs the firmware against
+ *              a simulated PC Engine and a scripted USB mouse
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+extern int  pcemouse_main(void);   // the firmware's main() (see the Makefile)
+
+extern bool frame_sync;
+extern bool frame_extrapolate;
+extern uint32_t motion_dropped;
+extern volatile bool dlog_on;
+
+extern void telemetry_command(int c);
+
+#define SIM_SETTLE_US   1500000     // firmware start-up, and the console timing learned
+#define SIM_TAIL_US     500000      // after the last report, for it to be read
+
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options] script\n"
+          "  -l       latch just ahead of the learned scan time (FRAME_SYNC_LATCH)\n"
+          "  -e       extrapolate to the latch time (a read may run one report ahead)\n"
+          "  -f <us>  frame period (default %lu)\n"
+          "  -g <us>  CLR edge to CLR edge within a read (default %lu)\n"
+          "  -c <us>  CLR pulse (default %lu)\n"
+          "  -d <us>  CLR/SEL change to sampling (default %lu)\n"
+          "  -v       show the firmware's output and log\n"
+          "  -V       show every read\n"
+          "  -t       show the firmware's telemetry at the end\n",
+          name, (unsigned long)sim_pce_cfg.frame_us, (unsigned long)sim_pce_cfg.scan_gap_us,
+          (unsigned long)sim_pce_cfg.clr_us, (unsigned long)sim_pce_cfg.read_delay_us);
+}
+
+static void firmware(void)
+{
+  pcemouse_main();
+}
+
+int main(int argc, char *argv[])
+{
+  bool telemetry = false;
+  sim_time_t end;
+  int c;
+
+  dlog_on = false;
+
+  while ((c = getopt(argc, argv, "lef:g:c:d:vVt")) != -1)
+  {
+    switch (c)
+    {
+      case 'l': frame_sync = true; break;
+      case 'e': frame_sync = true; frame_extrapolate = true; sim_pce_cfg.relaxed = true; break;
+      case 'f': sim_pce_cfg.frame_us = strtoul(optarg, NULL, 0); break;
+      case 'g': sim_pce_cfg.scan_gap_us = strtoul(optarg, NULL, 0); break;
+      case 'c': sim_pce_cfg.clr_us = strtoul(optarg, NULL, 0); break;
+      case 'd': sim_pce_cfg.read_delay_us = strtoul(optarg, NULL, 0); break;
+      case 'v': sim_firmware_output = true; dlog_on = true; break;
+      case 'V': sim_pce_cfg.trace = true; break;
+      case 't': telemetry = true; break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  if (optind != argc - 1)
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (sim_usb_load(argv[optind]) != 0)
+    return 2;
+
+  printf("%s: %d reports at %luus, console read every %luus (scans %luus apart)%s%s\n",
+         argv[optind], sim_report_count, (unsigned long)sim_report_rate_us,
+         (unsigned long)sim_pce_cfg.frame_us, (unsigned long)sim_pce_cfg.scan_gap_us,
+         frame_sync ? ", frame sync" : "", frame_extrapolate ? ", extrapolated" : "");
+
+  sim_thread_start(SIM_CORE0, firmware, 0);
+  sim_pce_start(SIM_US(SIM_SETTLE_US));
+  sim_usb_start(SIM_US(SIM_SETTLE_US));
+
+  end = SIM_US(SIM_SETTLE_US) + sim_usb_duration() + SIM_US(SIM_TAIL_US);
+  sim_run(end);
+
+  if (telemetry)
+  {
+    sim_firmware_output = true;
+    telemetry_command('t');
+  }
+
+  if (motion_dropped)
+    printf("firmware dropped motion %lu times (carry limit)\n", (unsigned long)motion_dropped);
+
+  if (!sim_pce_report() || motion_dropped)
+  {
+    printf("FAIL\n");
+    return 1;
+  }
+
+  printf("PASS\n");
+  return 0;
+}
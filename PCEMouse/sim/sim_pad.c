@@ -0,0 +1,298 @@
+/*
+ * sim_pad.c - the PC Engine side with SIM_GAMEPAD: reads the joypad every
+ *             frame, both banks, and checks each nybble against the pad posted
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "pcemouse.h"
+
+#ifdef SIM_GAMEPAD        // (otherwise the mouse is read by sim_pce.c)
+
+//--------------------------------------------------------------------+
+// Each frame, the console reads the pad twice, as a game which knows the
+// 6-button pad does. Each read pulses CLR (with PAD_EMULATION, all four
+// data lines must be low while it is high, and the pad moves on to its
+// other bank; the plex program shows a mouse's nybble instead), then
+// samples the directions with SEL high, and the buttons with SEL low.
+//
+// Every nybble must show the pad the firmware was last given (post_pad()),
+// or the one before if that changed only just before the sample. The
+// first bank shows the directions and Run/Sel/II/I; with PAD_SIX_BUTTON,
+// the second shows all four directions pressed and VI/V/IV/III (which is
+// how the first read finds out which bank it is on), otherwise it is the
+// same as the first. Every pad posted must be shown by some read.
+//--------------------------------------------------------------------+
+
+// The simulator is built without a board define, so main.c uses the
+// Raspberry Pi Pico pin assignment
+//
+#define SEL_PIN       16              // DATAIN_PIN
+#define CLR_PIN       17              // CLKIN_PIN
+#define OUTD0_PIN     18
+
+#define PAD_READS     2               // per frame: one for each bank
+#define PAD_SETTLE_US 20              // a pad posted this recently may not be shown yet
+
+#define TRACE_ERRORS  10              // bad nybbles shown in detail
+
+sim_pce_cfg_t sim_pce_cfg =
+{
+  .frame_us      = 16683,
+  .scan_gap_us   = 100,
+  .read_delay_us = 10,
+  .sel_delay_us  = 2,
+  .clr_us        = 1,
+  .relaxed       = false,
+  .trace         = false,
+};
+
+uint32_t sim_reads_started = 0;
+
+static sim_time_t host_t;
+static sim_time_t measure_from;
+
+// results
+static uint32_t reads = 0;
+static uint32_t bad_nybbles = 0;
+static uint32_t clr_errors = 0;
+static int      bank = -1;            // bank of the next read (-1: not known yet)
+static bool    *shown = NULL;         // per pad posted: read in full, while newest
+static int      shown_count = 0;
+
+
+//--------------------------------------------------------------------+
+// Console timing
+//--------------------------------------------------------------------+
+
+static void host_wait_us(uint32_t us)
+{
+  host_t += SIM_US(us);
+  sim_sleep_until(host_t);
+}
+
+static void host_set(bool sel, bool clr)
+{
+  sim_pin_drive(SEL_PIN, sel);
+  sim_pin_drive(CLR_PIN, clr);
+}
+
+static uint8_t host_read(void)
+{
+  uint8_t v = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    v |= sim_pin_level(OUTD0_PIN + i) << i;
+
+  return v;
+}
+
+//--------------------------------------------------------------------+
+// Checks
+//--------------------------------------------------------------------+
+
+//
+// pad_at - the newest pad posted before t (-1: none yet, so nothing pressed;
+//          or without PAD_EMULATION, a mouse which hasn't moved)
+//
+static int pad_at(sim_time_t t)
+{
+  int k;
+
+  for (k = sim_pad_count - 1; (k >= 0) && (sim_pads[k].t > t); k--)
+    ;
+  return k;
+}
+
+static uint16_t pad_value(int k)
+{
+  if (k >= 0)
+    return sim_pads[k].pad;
+#ifdef PAD_EMULATION
+  return PAD_RELEASED;
+#else
+  return PAD_RELEASED & ~0x0f;
+#endif
+}
+
+//
+// pad_nybble - what a pad shows in a bank, with SEL high (directions) or low
+//
+static uint8_t pad_nybble(uint16_t pad, int in_bank, bool sel)
+{
+#ifdef PAD_SIX_BUTTON
+  if (in_bank == 1)
+    return sel ? 0x0 : ((pad >> 8) & 0x0f);
+#else
+  (void)in_bank;
+#endif
+  return sel ? (pad & 0x0f) : ((pad >> 4) & 0x0f);
+}
+
+static void mark_shown(int k)
+{
+  if (k >= shown_count)
+  {
+    shown = realloc(shown, (k + 1) * sizeof(bool));
+    memset(shown + shown_count, 0, (k + 1 - shown_count) * sizeof(bool));
+    shown_count = k + 1;
+  }
+  shown[k] = true;
+}
+
+//
+// check_nybble - the pad posted last before the sample (returned), or
+//                the one before it if that was only just posted (-2: neither)
+//
+static int check_nybble(uint8_t v, sim_time_t t, bool sel)
+{
+  int k = pad_at(t);
+
+  if (v == pad_nybble(pad_value(k), bank, sel))
+    return k;
+
+  if ((k >= 0) && ((t - sim_pads[k].t) < SIM_US(PAD_SETTLE_US)) &&
+      (v == pad_nybble(pad_value(k - 1), bank, sel)))
+    return k - 1;
+
+  bad_nybbles++;
+  if (bad_nybbles <= TRACE_ERRORS)
+    printf("  bad nybble at %.3fms: bank %d, SEL %s: %x, expected %x\n",
+           t / (double)SIM_US(1000), bank + 1, sel ? "high" : "low", v,
+           pad_nybble(pad_value(k), bank, sel));
+  return -2;
+}
+
+//
+// read_pad - one read (CLR pulse, then directions and buttons), checked
+//            if measuring
+//
+static void read_pad(bool measure)
+{
+  sim_time_t dir_t, button_t;
+  uint8_t clr, dirs, buttons;
+  int kd, kb;
+
+  host_set(true, true);
+  host_wait_us(sim_pce_cfg.clr_us);
+  clr = host_read();
+  host_set(true, false);
+  sim_reads_started++;
+
+  host_wait_us(sim_pce_cfg.read_delay_us);
+  dirs = host_read();
+  dir_t = host_t;
+
+  host_set(false, false);
+  host_wait_us(sim_pce_cfg.sel_delay_us);
+  buttons = host_read();
+  button_t = host_t;
+
+  host_set(true, false);
+
+  if (!measure)
+    return;
+
+  // the first read finds the bank; from then on, every CLR pulse swaps it
+  if (bank < 0)
+  {
+#ifdef PAD_SIX_BUTTON
+    bank = (dirs == 0x0) ? 1 : 0;
+#else
+    bank = 0;
+#endif
+  }
+
+  reads++;
+
+#ifdef PAD_EMULATION
+  if (clr != 0)
+    clr_errors++;
+#endif
+
+  kd = check_nybble(dirs, dir_t, true);
+  kb = check_nybble(buttons, button_t, false);
+
+  // a pad is shown when a first bank read has it in full
+  if ((bank == 0) && (kd >= 0) && (kd == kb))
+    mark_shown(kd);
+
+  if (sim_pce_cfg.trace)
+    printf("  read %.3fms: bank %d, CLR %x, directions %x, buttons %x\n",
+           dir_t / (double)SIM_US(1000), bank + 1, clr, dirs, buttons);
+
+  bank ^= 1;
+}
+
+//
+// console - the pad is read (twice) every frame, from the start
+//
+static void console(void)
+{
+  sim_time_t frame = SIM_US(sim_pce_cfg.frame_us);
+  sim_time_t next = host_t;
+  sim_time_t read_t;
+  int i;
+
+  host_set(true, false);
+
+  while (1)
+  {
+    host_t = next;
+    sim_sleep_until(host_t);
+    next += frame;
+
+    for (i = 0; i < PAD_READS; i++)
+    {
+      read_t = host_t;
+      read_pad(host_t >= measure_from);
+
+      host_t = read_t + SIM_US(sim_pce_cfg.scan_gap_us);
+      sim_sleep_until(host_t);
+    }
+  }
+}
+
+void sim_pce_start(sim_time_t from)
+{
+  measure_from = from;
+  host_t = 0;
+  sim_thread_start(SIM_CONSOLE, console, 0);
+}
+
+//--------------------------------------------------------------------+
+// Results
+//--------------------------------------------------------------------+
+
+bool sim_pce_report(void)
+{
+  uint32_t hidden = 0;
+  int k;
+
+  for (k = 0; k < sim_pad_count; k++)
+    if ((k >= shown_count) || !shown[k])
+      hidden++;
+
+  printf("reads: %lu (%s); %lu bad nybbles, %lu not all low with CLR high\n",
+         (unsigned long)reads,
+#if defined(PAD_SIX_BUTTON)
+         "6-button pad",
+#elif defined(PAD_EMULATION)
+         "2-button pad",
+#else
+         "gamepad on the mouse port",
+#endif
+         (unsigned long)bad_nybbles, (unsigned long)clr_errors);
+  printf("pads posted: %d, never shown: %lu\n", sim_pad_count, (unsigned long)hidden);
+
+  return (reads > 0) && (sim_pad_count > 0) && (bad_nybbles == 0) && (clr_errors == 0) && (hidden == 0);
+}
+
+#endif /* SIM_GAMEPAD */
@@ -0,0 +1,405 @@
+/*
+ * sim_pce.c - the PC Engine side: reads the mouse every frame, and checks
+ *             each packet against what the firmware was given
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "pcemouse.h"
+
+#ifndef SIM_GAMEPAD       // (the joypad is read by sim_pad.c instead)
+
+//--------------------------------------------------------------------+
+// Each frame, the console reads the mouse as a burst of 4 scans. Each
+// scan pulses CLR (moving the mouse on to its next nybble), samples the
+// data lines with SEL high (x high, x low, y high, y low in turn), then
+// drops SEL and samples the buttons. With MULTITAP_EMULATION, each scan
+// walks all the ports of the multitap (and one beyond), toggling SEL.
+//
+// A packet must be one consistent snapshot: its motion must bring the
+// total delivered to within one count (the one the >>1 encoding can't
+// carry) of the total posted up to some report, no earlier than the one
+// matched by the previous packet, and its buttons must be the ones posted
+// with that report. Only a packet clipped to the range of one scan may
+// fall short. The latency of each report is measured up to the end of
+// the read which completes it (when the game has it).
+//--------------------------------------------------------------------+
+
+// The simulator is built without a board define, so main.c uses the
+// Raspberry Pi Pico pin assignment
+//
+#define SEL_PIN       16              // DATAIN_PIN
+#define CLR_PIN       17              // CLKIN_PIN
+#define OUTD0_PIN     18
+
+#define READ_SCANS    4
+#define TAP_WALK      (MOUSE_PORTS + 1)   // ports read per scan (one beyond the tap)
+
+#define TRACE_ERRORS  10                  // inconsistent packets shown in detail
+
+sim_pce_cfg_t sim_pce_cfg =
+{
+  .frame_us      = 16683,
+  .scan_gap_us   = 100,
+  .read_delay_us = 10,
+  .sel_delay_us  = 2,
+  .clr_us        = 1,
+  .relaxed       = false,
+  .trace         = false,
+};
+
+uint32_t sim_reads_started = 0;
+
+typedef struct
+{
+  sim_time_t t;                       // first CLR edge
+  sim_time_t done;                    // last nybble sampled
+  uint8_t    data[READ_SCANS];        // nybbles with SEL high (port 1)
+  uint8_t    buttons[READ_SCANS];     // nybbles with SEL low (port 1)
+  bool       pads_idle;               // other ports (multitap) all read 0xF
+} sim_read_t;
+
+static sim_time_t host_t;
+static sim_time_t measure_from;
+
+// results
+static uint32_t reads = 0;
+static uint32_t reads_matched = 0;
+static uint32_t reads_ahead = 0;      // (relaxed) extrapolated past the newest report
+static uint32_t reads_clipped = 0;
+static uint32_t reads_bad = 0;
+static uint32_t reads_torn_buttons = 0;
+static uint32_t pad_errors = 0;
+
+static int32_t  delivered_x = 0;
+static int32_t  delivered_y = 0;
+static int      last_match = -1;      // newest post delivered (-1: none yet)
+
+static uint32_t *latency = NULL;      // per report with motion, in us
+static uint32_t  latency_count = 0;
+static uint32_t  reads_late[4];       // delivered at the 1st, 2nd, 3rd, 4th+ read
+
+
+//--------------------------------------------------------------------+
+// Console timing
+//--------------------------------------------------------------------+
+
+static void host_wait_us(uint32_t us)
+{
+  host_t += SIM_US(us);
+  sim_sleep_until(host_t);
+}
+
+static void host_set(bool sel, bool clr)
+{
+  sim_pin_drive(SEL_PIN, sel);
+  sim_pin_drive(CLR_PIN, clr);
+}
+
+static uint8_t host_read(void)
+{
+  uint8_t v = 0;
+  int i;
+
+  for (i = 0; i < 4; i++)
+    v |= sim_pin_level(OUTD0_PIN + i) << i;
+
+  return v;
+}
+
+static void read_mouse(sim_read_t *r)
+{
+  int scan, port;
+
+  memset(r, 0, sizeof(*r));
+  r->pads_idle = true;
+
+  for (scan = 0; scan < READ_SCANS; scan++)
+  {
+    sim_time_t scan_t = host_t;
+
+    host_set(true, true);
+    host_wait_us(sim_pce_cfg.clr_us);
+    host_set(true, false);
+
+    if (scan == 0)
+    {
+      r->t = host_t;
+      sim_reads_started++;
+    }
+
+    host_wait_us(sim_pce_cfg.read_delay_us);
+
+    for (port = 0; port < ((MOUSE_PORTS > 1) ? TAP_WALK : 1); port++)
+    {
+      uint8_t d = host_read();
+      uint8_t b;
+
+      host_set(false, false);
+      host_wait_us(sim_pce_cfg.sel_delay_us);
+      b = host_read();
+
+      if (port == 0)
+      {
+        r->data[scan] = d;
+        r->buttons[scan] = b;
+      }
+      else if ((d != 0x0f) || (b != 0x0f))
+        r->pads_idle = false;
+
+      if (MOUSE_PORTS > 1)
+      {
+        host_set(true, false);
+        host_wait_us(sim_pce_cfg.sel_delay_us);
+      }
+    }
+
+    r->done = host_t;
+    host_t = scan_t + SIM_US(sim_pce_cfg.scan_gap_us);
+    sim_sleep_until(host_t);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Checks
+//--------------------------------------------------------------------+
+
+static inline int32_t iabs(int32_t v)
+{
+  return (v < 0) ? -v : v;
+}
+
+static void deliver(int upto, const sim_read_t *r)
+{
+  int k;
+
+  for (k = last_match + 1; k <= upto; k++)
+  {
+    uint32_t late;
+
+    if (!sim_posts[k].moved)
+      continue;
+
+    latency = realloc(latency, (latency_count + 1) * sizeof(uint32_t));
+    latency[latency_count++] = (uint32_t)((r->done - sim_posts[k].t) / SIM_CYCLES_PER_US);
+
+    // 1 = the first read started after the report (or the one it arrived during)
+    late = sim_reads_started - sim_posts[k].reads_before;
+    reads_late[(late <= 1) ? 0 : (late > 4) ? 3 : (late - 1)]++;
+  }
+
+  last_match = upto;
+}
+
+static inline bool within(int32_t v, int32_t a, int32_t b)
+{
+  return (v >= ((a < b) ? a : b) - 1) && (v <= ((a > b) ? a : b) + 1);
+}
+
+//
+// ahead_of - (relaxed) the total delivered lies between report k's position and
+//            where its last move takes it in one more report interval, which is
+//            as far as extrapolation runs ahead of the reports
+//
+static bool ahead_of(int k, uint8_t buttons)
+{
+  int32_t cx = sim_posts[k].cx;
+  int32_t cy = sim_posts[k].cy;
+  int32_t dx = cx - ((k > 0) ? sim_posts[k - 1].cx : 0);
+  int32_t dy = cy - ((k > 0) ? sim_posts[k - 1].cy : 0);
+
+  return within(delivered_x, cx, cx + dx) && within(delivered_y, cy, cy + dy) &&
+         (buttons == sim_posts[k].buttons);
+}
+
+static void check_read(const sim_read_t *r)
+{
+  uint8_t bx = (r->data[0] << 4) | r->data[1];
+  uint8_t by = (r->data[2] << 4) | r->data[3];
+  int32_t dx = (int8_t)bx * 2;
+  int32_t dy = (int8_t)by * 2;
+  bool clipped = (bx == 0x7f) || (bx == 0x80) || (by == 0x7f) || (by == 0x80);
+  int newest, j, k;
+  bool ahead = false;
+  int scan;
+
+  // with MULTITAP_EMULATION, a port shows an idle joypad until a mouse
+  // on it has sent its first report
+  if ((MOUSE_PORTS > 1) && ((sim_post_count == 0) || (sim_posts[0].t > r->done)) &&
+      (bx == 0xff) && (by == 0xff) && (r->buttons[0] == 0x0f))
+    return;
+
+  reads++;
+
+  for (scan = 1; scan < READ_SCANS; scan++)
+    if (r->buttons[scan] != r->buttons[0])
+      break;
+  if (scan < READ_SCANS)
+    reads_torn_buttons++;
+
+  if (!r->pads_idle)
+    pad_errors++;
+
+  delivered_x += dx;
+  delivered_y += dy;
+
+  // newest report the firmware could have had before the read was over
+  for (newest = sim_post_count - 1; (newest >= 0) && (sim_posts[newest].t > r->done); newest--)
+    ;
+
+  for (j = newest; j >= last_match; j--)
+  {
+    int32_t cx = (j >= 0) ? sim_posts[j].cx : 0;
+    int32_t cy = (j >= 0) ? sim_posts[j].cy : 0;
+    uint8_t cb = (j >= 0) ? sim_posts[j].buttons : 0x0f;
+
+    if ((iabs(cx - delivered_x) <= 1) && (iabs(cy - delivered_y) <= 1) && (cb == r->buttons[0]))
+      break;
+  }
+
+  // with extrapolation, a packet may run ahead of the newest report the
+  // firmware had (or of the one before, if another arrived during the read)
+  if ((j < last_match) && sim_pce_cfg.relaxed)
+  {
+    for (k = newest; !ahead && (k >= 0) && (k >= last_match) && (k >= newest - 1); k--)
+      ahead = ahead_of(k, r->buttons[0]);
+  }
+
+  if (j >= last_match)
+  {
+    deliver(j, r);
+    reads_matched++;
+  }
+  else if (ahead)
+    reads_ahead++;
+  else if (clipped)
+    reads_clipped++;
+  else
+  {
+    reads_bad++;
+    if (reads_bad <= TRACE_ERRORS)
+      printf("  bad packet at %.3fms: x=%+ld y=%+ld buttons=%x; total delivered x=%+ld y=%+ld, "
+             "posted x=%+ld y=%+ld\n",
+             r->t / (double)SIM_US(1000), (long)dx, (long)dy, r->buttons[0],
+             (long)delivered_x, (long)delivered_y,
+             (long)((newest >= 0) ? sim_posts[newest].cx : 0),
+             (long)((newest >= 0) ? sim_posts[newest].cy : 0));
+  }
+
+  if (sim_pce_cfg.trace)
+    printf("  read %.3fms: %x%x %x%x buttons=%x%x%x%x  x=%+ld y=%+ld  %s\n",
+           r->t / (double)SIM_US(1000), r->data[0], r->data[1], r->data[2], r->data[3],
+           r->buttons[0], r->buttons[1], r->buttons[2], r->buttons[3], (long)dx, (long)dy,
+           (j >= last_match) ? "ok" : ahead ? "ahead" : (clipped ? "clipped" : "BAD"));
+}
+
+//
+// console - one mouse read per frame, from the start
+//
+static void console(void)
+{
+  sim_time_t frame = SIM_US(sim_pce_cfg.frame_us);
+  sim_time_t next = host_t;
+  sim_read_t r;
+
+  host_set(false, false);
+
+  while (1)
+  {
+    host_t = next;
+    sim_sleep_until(host_t);
+    next += frame;
+
+    read_mouse(&r);
+
+    if (r.t >= measure_from)
+      check_read(&r);
+  }
+}
+
+void sim_pce_start(sim_time_t from)
+{
+  measure_from = from;
+  host_t = 0;
+  sim_thread_start(SIM_CONSOLE, console, 0);
+}
+
+//--------------------------------------------------------------------+
+// Results
+//--------------------------------------------------------------------+
+
+static int cmp_u32(const void *a, const void *b)
+{
+  uint32_t x = *(const uint32_t *)a;
+  uint32_t y = *(const uint32_t *)b;
+
+  return (x > y) - (x < y);
+}
+
+static uint32_t percentile(uint32_t pct)
+{
+  uint32_t i = (latency_count * pct) / 100;
+
+  return latency[(i >= latency_count) ? (latency_count - 1) : i];
+}
+
+bool sim_pce_report(void)
+{
+  int32_t posted_x = sim_post_count ? sim_posts[sim_post_count - 1].cx : 0;
+  int32_t posted_y = sim_post_count ? sim_posts[sim_post_count - 1].cy : 0;
+  uint32_t moved = 0;
+  uint64_t sum = 0;
+  bool conserved = (iabs(posted_x - delivered_x) <= 1) && (iabs(posted_y - delivered_y) <= 1);
+  bool pass;
+  uint32_t i;
+
+  for (i = 0; i < (uint32_t)sim_post_count; i++)
+    moved += sim_posts[i].moved;
+
+  printf("reads: %lu; %lu consistent, ", (unsigned long)reads, (unsigned long)reads_matched);
+  if (sim_pce_cfg.relaxed)
+    printf("%lu ahead, ", (unsigned long)reads_ahead);
+  printf("%lu clipped, %lu bad; torn buttons=%lu", (unsigned long)reads_clipped,
+         (unsigned long)reads_bad, (unsigned long)reads_torn_buttons);
+  if (MOUSE_PORTS > 1)
+    printf("; other ports not idle=%lu", (unsigned long)pad_errors);
+  printf("\n");
+
+  printf("motion: posted x=%+ld y=%+ld, delivered x=%+ld y=%+ld -> %s\n",
+         (long)posted_x, (long)posted_y, (long)delivered_x, (long)delivered_y,
+         conserved ? "nothing lost or duplicated" : "LOST OR DUPLICATED");
+
+  if (latency_count)
+  {
+    qsort(latency, latency_count, sizeof(uint32_t), cmp_u32);
+    for (i = 0; i < latency_count; i++)
+      sum += latency[i];
+
+    printf("latency, report to read: n=%lu avg=%luus p50=%luus p90=%luus p99=%luus max=%luus\n",
+           (unsigned long)latency_count, (unsigned long)(sum / latency_count),
+           (unsigned long)percentile(50), (unsigned long)percentile(90),
+           (unsigned long)percentile(99), (unsigned long)latency[latency_count - 1]);
+    printf("delivered at read: 1st=%lu 2nd=%lu 3rd=%lu later=%lu\n",
+           (unsigned long)reads_late[0], (unsigned long)reads_late[1],
+           (unsigned long)reads_late[2], (unsigned long)reads_late[3]);
+  }
+
+  if (latency_count < moved)
+    printf("reports never delivered: %lu\n", (unsigned long)(moved - latency_count));
+
+  // with extrapolation, single reads may run ahead (by no more than a report's
+  // worth), but the totals must still match, and every report must be caught
+  // up with eventually
+  pass = conserved && (latency_count == moved) && (reads_bad == 0) &&
+         (reads_torn_buttons == 0) && (pad_errors == 0) && (reads > 0);
+
+  return pass;
+}
+
+#endif /* SIM_GAMEPAD */
@@ -0,0 +1,969 @@
+/*
+ * sim_pio.c - PIO interpreter for the host simulator
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim.h"
+
+//--------------------------------------------------------------------+
+// Each enabled state machine executes one instruction (or one cycle of
+// a delay or a stall) per tick of its clock divider, as on the RP2040.
+//
+// Most of the time, the programs here just poll their inputs. A state
+// machine which arrives back at an instruction in exactly the state it
+// was in the last time it was there (registers, shift counts, FIFO
+// levels, IRQ flags and pins) is in a loop which can't change anything
+// until an input does, so it is not stepped any further; instead, the
+// ticks are counted, and when something changes, it is first advanced
+// by (ticks mod loop length) - which leaves it exactly where it would
+// have been. This keeps long simulations fast without losing any cycle
+// accuracy.
+//--------------------------------------------------------------------+
+
+#define FIFO_MAX  8
+
+typedef struct
+{
+  uint8_t  pc;
+  uint8_t  isr_count;
+  uint8_t  osr_count;
+  uint8_t  tx_level;
+  uint8_t  rx_level;
+  uint8_t  flags;
+  uint8_t  irq;
+  uint8_t  pad;
+  uint32_t x;
+  uint32_t y;
+  uint32_t isr;
+  uint32_t osr;
+  uint32_t pins;
+  uint32_t pindirs;
+} sm_snap_t;
+
+typedef struct
+{
+  pio_sm_config cfg;
+  bool     claimed;
+  bool     enabled;
+
+  uint8_t  pc;
+  uint8_t  delay;
+  uint32_t x;
+  uint32_t y;
+  uint32_t isr;
+  uint32_t osr;
+  uint8_t  isr_count;               // bits shifted in
+  uint8_t  osr_count;               // bits shifted out (32 = empty)
+  bool     push_stalled;            // autopush waiting for room in the RX FIFO
+  bool     irq_waiting;             // "irq wait" has set its flag
+  bool     exec_pending;            // OUT/MOV EXEC: run exec_instr next
+  uint16_t exec_instr;
+
+  uint32_t tx[FIFO_MAX];
+  uint32_t rx[FIFO_MAX];
+  uint8_t  tx_level, tx_read;
+  uint8_t  rx_level, rx_read;
+
+  uint32_t div_acc;                 // clock divider accumulator (1/256ths)
+
+  // idle loop detection
+  bool       quiet;
+  uint64_t   ticks;
+  uint64_t   quiet_ticks;
+  uint64_t   period;
+  uint32_t   seen_mask;
+  uint64_t   seen_tick[PIO_INSTRUCTION_COUNT];
+  sm_snap_t  seen[PIO_INSTRUCTION_COUNT];
+} sim_sm_t;
+
+struct sim_pio
+{
+  uint16_t instr[PIO_INSTRUCTION_COUNT];
+  uint32_t used;
+  uint8_t  irq;
+  sim_sm_t sm[NUM_PIO_STATE_MACHINES];
+};
+
+pio_hw_t sim_pio0;                  // (the FIFO addresses; see hardware/pio.h)
+pio_hw_t sim_pio1;
+
+static struct sim_pio blocks[NUM_PIOS];
+static struct sim_pio *const pios[NUM_PIOS] = { &blocks[0], &blocks[1] };
+
+sim_time_t sim_now = 0;
+
+bool (*sim_hw_cycle)(void) = NULL;
+static bool hw_busy = false;        // sim_hw_cycle() has something to do
+
+// Pins: what the PIO blocks drive, and what is driven from outside
+//
+static uint32_t pin_out = 0;
+static uint32_t pin_dir = 0;
+static uint32_t ext_level = 0;
+static uint32_t ext_mask = 0;
+static uint32_t in_invert = 0;      // gpio_set_inover()
+
+static bool     changed;            // a state machine did something visible
+
+
+bool sim_pin_level(uint pin)
+{
+  uint32_t bit = 1u << (pin & 31);
+
+  if (ext_mask & bit)
+    return (ext_level & bit) != 0;
+  if (pin_dir & bit)
+    return (pin_out & bit) != 0;
+
+  return true;                      // pulled up
+}
+
+static uint32_t pin_levels(void)
+{
+  return (ext_level & ext_mask) | (pin_out & pin_dir & ~ext_mask) | (~pin_dir & ~ext_mask);
+}
+
+// as the PIO blocks (and gpio_get()) see it
+//
+bool sim_pin_input(uint pin)
+{
+  return sim_pin_level(pin) ^ ((in_invert >> (pin & 31)) & 1);
+}
+
+// Idle state machines are brought up to date (as they were) before any
+// change which they might see is made
+//
+void sim_pin_drive(uint pin, bool level)
+{
+  uint32_t bit = 1u << (pin & 31);
+
+  if (sim_pin_level(pin) != level)
+    sim_pio_disturb();
+
+  ext_mask |= bit;
+  ext_level = level ? (ext_level | bit) : (ext_level & ~bit);
+}
+
+void sim_pin_release(uint pin)
+{
+  sim_pio_disturb();
+  ext_mask &= ~(1u << (pin & 31));
+}
+
+//--------------------------------------------------------------------+
+// Execution
+//--------------------------------------------------------------------+
+
+static inline uint32_t rotate_pins(uint base)
+{
+  uint32_t v = pin_levels() ^ in_invert;
+
+  base &= 31;
+  return base ? ((v >> base) | (v << (32 - base))) : v;
+}
+
+static void write_pins(uint32_t *reg, uint base, uint count, uint32_t data)
+{
+  uint32_t old = *reg;
+  uint i;
+
+  for (i = 0; i < count; i++)
+  {
+    uint32_t bit = 1u << ((base + i) & 31);
+
+    *reg = (data & (1u << i)) ? (*reg | bit) : (*reg & ~bit);
+  }
+
+  if (*reg != old)
+    changed = true;
+}
+
+static inline uint32_t bit_mask(uint n)
+{
+  return (n >= 32) ? 0xffffffffu : ((1u << n) - 1);
+}
+
+static inline uint32_t bit_reverse(uint32_t v)
+{
+  uint32_t r = 0;
+  int i;
+
+  for (i = 0; i < 32; i++)
+    if (v & (1u << i))
+      r |= 1u << (31 - i);
+
+  return r;
+}
+
+static inline uint irq_number(uint sm_index, uint idx)
+{
+  if (idx & 0x10)
+    return (idx & 4) | (((idx & 3) + sm_index) & 3);
+
+  return idx & 7;
+}
+
+static inline uint fifo_depth(sim_sm_t *sm, bool tx)
+{
+  if (sm->cfg.fifo_join == (tx ? PIO_FIFO_JOIN_TX : PIO_FIFO_JOIN_RX))
+    return 8;
+  if (sm->cfg.fifo_join == (tx ? PIO_FIFO_JOIN_RX : PIO_FIFO_JOIN_TX))
+    return 0;
+
+  return 4;
+}
+
+static bool rx_push(sim_sm_t *sm, uint32_t v)
+{
+  if (sm->rx_level >= fifo_depth(sm, false))
+    return false;
+
+  sm->rx[(sm->rx_read + sm->rx_level) % FIFO_MAX] = v;
+  sm->rx_level++;
+  changed = true;
+  sim_notify(&sm->rx);
+  return true;
+}
+
+static bool tx_pop(sim_sm_t *sm, uint32_t *v)
+{
+  if (sm->tx_level == 0)
+    return false;
+
+  *v = sm->tx[sm->tx_read];
+  sm->tx_read = (sm->tx_read + 1) % FIFO_MAX;
+  sm->tx_level--;
+  sim_notify(&sm->tx);
+  return true;
+}
+
+//
+// exec - run one instruction; false if it stalls (to be retried next tick)
+//
+static bool exec(struct sim_pio *pio, sim_sm_t *sm, uint index, uint16_t instr, bool *jumped)
+{
+  uint op  = instr >> 13;
+  uint arg = (instr >> 5) & 7;
+  uint idx = instr & 0x1f;
+  uint n   = idx ? idx : 32;
+  uint32_t data = 0;
+
+  switch (op)
+  {
+    case 0:   // JMP
+    {
+      bool take = false;
+
+      switch (arg)
+      {
+        case 0: take = true;                                            break;
+        case 1: take = (sm->x == 0);                                    break;
+        case 2: take = (sm->x != 0); sm->x--;                           break;
+        case 3: take = (sm->y == 0);                                    break;
+        case 4: take = (sm->y != 0); sm->y--;                           break;
+        case 5: take = (sm->x != sm->y);                                break;
+        case 6: take = sim_pin_input(sm->cfg.jmp_pin);                  break;
+        case 7: take = (sm->osr_count < sm->cfg.pull_threshold);        break;
+      }
+      if (take)
+      {
+        sm->pc = idx;
+        *jumped = true;
+      }
+      return true;
+    }
+
+    case 1:   // WAIT
+    {
+      bool pol = (instr >> 7) & 1;
+      uint src = (instr >> 5) & 3;
+
+      if (src == 0)
+        return sim_pin_input(idx) == pol;
+      if (src == 1)
+        return sim_pin_input((sm->cfg.in_base + idx) & 31) == pol;
+      if (src == 2)
+      {
+        uint bit = 1u << irq_number(index, idx);
+
+        if (((pio->irq & bit) != 0) != pol)
+          return false;
+        if (pol)
+        {
+          pio->irq &= ~bit;
+          changed = true;
+        }
+        return true;
+      }
+      return true;
+    }
+
+    case 2:   // IN
+    {
+      if (sm->push_stalled)
+      {
+        if (!rx_push(sm, sm->isr))
+          return false;
+        sm->push_stalled = false;
+        sm->isr = 0;
+        sm->isr_count = 0;
+        return true;
+      }
+
+      switch (arg)
+      {
+        case 0: data = rotate_pins(sm->cfg.in_base); break;
+        case 1: data = sm->x;                        break;
+        case 2: data = sm->y;                        break;
+        case 6: data = sm->isr;                      break;
+        case 7: data = sm->osr;                      break;
+        default: data = 0;                           break;
+      }
+      data &= bit_mask(n);
+
+      if (n == 32)
+        sm->isr = data;
+      else if (sm->cfg.in_shift_right)
+        sm->isr = (sm->isr >> n) | (data << (32 - n));
+      else
+        sm->isr = (sm->isr << n) | data;
+
+      sm->isr_count = (sm->isr_count + n > 32) ? 32 : (sm->isr_count + n);
+
+      if (sm->cfg.autopush && (sm->isr_count >= sm->cfg.push_threshold))
+      {
+        if (!rx_push(sm, sm->isr))
+        {
+          sm->push_stalled = true;
+          return false;
+        }
+        sm->isr = 0;
+        sm->isr_count = 0;
+      }
+      return true;
+    }
+
+    case 3:   // OUT
+    {
+      if (sm->cfg.autopull && (sm->osr_count >= sm->cfg.pull_threshold))
+      {
+        if (!tx_pop(sm, &sm->osr))
+          return false;
+        sm->osr_count = 0;
+      }
+
+      if (n == 32)
+      {
+        data = sm->osr;
+        sm->osr = 0;
+      }
+      else if (sm->cfg.out_shift_right)
+      {
+        data = sm->osr & bit_mask(n);
+        sm->osr >>= n;
+      }
+      else
+      {
+        data = sm->osr >> (32 - n);
+        sm->osr <<= n;
+      }
+      sm->osr_count = (sm->osr_count + n > 32) ? 32 : (sm->osr_count + n);
+
+      switch (arg)
+      {
+        case 0: write_pins(&pin_out, sm->cfg.out_base, sm->cfg.out_count, data); break;
+        case 1: sm->x = data;                                                   break;
+        case 2: sm->y = data;                                                   break;
+        case 4: write_pins(&pin_dir, sm->cfg.out_base, sm->cfg.out_count, data); break;
+        case 5: sm->pc = data & 31; *jumped = true;                             break;
+        case 6: sm->isr = data; sm->isr_count = n;                              break;
+        case 7: sm->exec_pending = true; sm->exec_instr = data;                 break;
+        default:                                                                break;
+      }
+      return true;
+    }
+
+    case 4:   // PUSH / PULL
+    {
+      bool cond  = (instr >> 6) & 1;
+      bool block = (instr >> 5) & 1;
+
+      if ((instr & 0x80) == 0)
+      {
+        if (cond && (sm->isr_count < sm->cfg.push_threshold))
+          return true;
+        if (!rx_push(sm, sm->isr) && block)
+          return false;
+        sm->isr = 0;
+        sm->isr_count = 0;
+      }
+      else
+      {
+        if (cond && (sm->osr_count < sm->cfg.pull_threshold))
+          return true;
+        if (!tx_pop(sm, &sm->osr))
+        {
+          if (block)
+            return false;
+          sm->osr = sm->x;
+        }
+        sm->osr_count = 0;
+      }
+      return true;
+    }
+
+    case 5:   // MOV
+    {
+      uint src = instr & 7;
+      uint mop = (instr >> 3) & 3;
+
+      switch (src)
+      {
+        case 0: data = rotate_pins(sm->cfg.in_base); break;
+        case 1: data = sm->x;                        break;
+        case 2: data = sm->y;                        break;
+        case 5:
+          data = (sm->cfg.status_sel == STATUS_RX_LESSTHAN) ?
+                 ((sm->rx_level < sm->cfg.status_n) ? 0xffffffffu : 0) :
+                 ((sm->tx_level < sm->cfg.status_n) ? 0xffffffffu : 0);
+          break;
+        case 6: data = sm->isr;                      break;
+        case 7: data = sm->osr;                      break;
+        default: data = 0;                           break;
+      }
+
+      if (mop == 1)
+        data = ~data;
+      else if (mop == 2)
+        data = bit_reverse(data);
+
+      switch (arg)
+      {
+        case 0: write_pins(&pin_out, sm->cfg.out_base, sm->cfg.out_count, data); break;
+        case 1: sm->x = data;                                                   break;
+        case 2: sm->y = data;                                                   break;
+        case 4: sm->exec_pending = true; sm->exec_instr = data;                 break;
+        case 5: sm->pc = data & 31; *jumped = true;                             break;
+        case 6: sm->isr = data; sm->isr_count = 0;                              break;
+        case 7: sm->osr = data; sm->osr_count = 0;                              break;
+        default:                                                                break;
+      }
+      return true;
+    }
+
+    case 6:   // IRQ
+    {
+      uint bit = 1u << irq_number(index, idx);
+
+      if (instr & 0x40)
+      {
+        if (pio->irq & bit)
+          changed = true;
+        pio->irq &= ~bit;
+        return true;
+      }
+
+      if (sm->irq_waiting)
+      {
+        if (pio->irq & bit)
+          return false;
+        sm->irq_waiting = false;
+        return true;
+      }
+
+      if (!(pio->irq & bit))
+        changed = true;
+      pio->irq |= bit;
+
+      if (instr & 0x20)
+      {
+        sm->irq_waiting = true;
+        return false;
+      }
+      return true;
+    }
+
+    case 7:   // SET
+      switch (arg)
+      {
+        case 0: write_pins(&pin_out, sm->cfg.set_base, sm->cfg.set_count, idx); break;
+        case 1: sm->x = idx;                                                   break;
+        case 2: sm->y = idx;                                                   break;
+        case 4: write_pins(&pin_dir, sm->cfg.set_base, sm->cfg.set_count, idx); break;
+        default:                                                               break;
+      }
+      return true;
+  }
+
+  return true;
+}
+
+static void snapshot(struct sim_pio *pio, sim_sm_t *sm, sm_snap_t *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->pc = sm->pc;
+  s->isr_count = sm->isr_count;
+  s->osr_count = sm->osr_count;
+  s->tx_level = sm->tx_level;
+  s->rx_level = sm->rx_level;
+  s->flags = sm->push_stalled | (sm->irq_waiting << 1) | (sm->exec_pending << 2);
+  s->irq = pio->irq;
+  s->x = sm->x;
+  s->y = sm->y;
+  s->isr = sm->isr;
+  s->osr = sm->osr;
+  s->pins = pin_out;
+  s->pindirs = pin_dir;
+}
+
+//
+// tick - one clock of one state machine
+//
+static void tick(struct sim_pio *pio, sim_sm_t *sm, uint index, bool detect)
+{
+  uint16_t instr;
+  bool jumped = false;
+  sm_snap_t s;
+
+  if (sm->delay)
+  {
+    sm->delay--;
+    sm->ticks++;
+    return;
+  }
+
+  if (detect && !sm->exec_pending)
+  {
+    uint32_t bit = 1u << sm->pc;
+
+    snapshot(pio, sm, &s);
+    if ((sm->seen_mask & bit) && (memcmp(&s, &sm->seen[sm->pc], sizeof(s)) == 0))
+    {
+      // back here with nothing changed: an idle loop (this tick is skipped too)
+      sm->quiet = true;
+      sm->period = sm->ticks - sm->seen_tick[sm->pc];
+      sm->quiet_ticks = 1;
+      return;
+    }
+    sm->seen[sm->pc] = s;
+    sm->seen_tick[sm->pc] = sm->ticks;
+    sm->seen_mask |= bit;
+  }
+
+  sm->ticks++;
+
+  if (sm->exec_pending)
+  {
+    instr = sm->exec_instr;
+    sm->exec_pending = false;
+    if (!exec(pio, sm, index, instr, &jumped))
+    {
+      sm->exec_pending = true;      // a stalled EXEC'd instruction is retried
+      return;
+    }
+  }
+  else
+  {
+    instr = pio->instr[sm->pc];
+    if (!exec(pio, sm, index, instr, &jumped))
+      return;
+  }
+
+  sm->delay = (instr >> 8) & 0x1f;
+
+  if (!jumped && !sm->exec_pending)
+    sm->pc = (sm->pc == sm->cfg.wrap) ? sm->cfg.wrap_target : ((sm->pc + 1) & 31);
+}
+
+//
+// wake - bring an idle state machine up to date, and watch it again
+//
+static void wake(struct sim_pio *pio, sim_sm_t *sm, uint index)
+{
+  uint64_t n;
+
+  if (sm->quiet)
+  {
+    sm->quiet = false;
+    n = sm->period ? (sm->quiet_ticks % sm->period) : 0;
+    while (n--)
+      tick(pio, sm, index, false);
+    sm->quiet_ticks = 0;
+  }
+  sm->seen_mask = 0;
+}
+
+void sim_pio_disturb(void)
+{
+  int p, i;
+
+  hw_busy = true;
+
+  for (p = 0; p < NUM_PIOS; p++)
+    for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+      wake(pios[p], &pios[p]->sm[i], i);
+}
+
+static inline uint64_t divider_ticks(sim_sm_t *sm, uint64_t cycles)
+{
+  uint64_t acc = sm->div_acc + (cycles << 8);
+  uint64_t t = acc / sm->cfg.clkdiv_256;
+
+  sm->div_acc = acc % sm->cfg.clkdiv_256;
+  return t;
+}
+
+void sim_pio_run_until(sim_time_t t)
+{
+  uint32_t out_before, dir_before;
+  uint8_t irq_before[NUM_PIOS];
+  int p, i;
+
+  sim_woken = false;
+
+  while ((sim_now < t) && !sim_woken)
+  {
+    bool busy = false;
+
+    for (p = 0; p < NUM_PIOS; p++)
+      for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+        if (pios[p]->sm[i].enabled && !pios[p]->sm[i].quiet)
+          busy = true;
+
+    if (sim_hw_cycle && hw_busy)
+      busy = true;
+
+    if (!busy)
+    {
+      // nothing can change until an input does
+      for (p = 0; p < NUM_PIOS; p++)
+        for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+          if (pios[p]->sm[i].enabled)
+            pios[p]->sm[i].quiet_ticks += divider_ticks(&pios[p]->sm[i], t - sim_now);
+
+      sim_now = t;
+      break;
+    }
+
+    changed = false;
+    out_before = pin_out;
+    dir_before = pin_dir;
+    for (p = 0; p < NUM_PIOS; p++)
+      irq_before[p] = pios[p]->irq;
+
+    for (p = 0; p < NUM_PIOS; p++)
+      for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+      {
+        sim_sm_t *sm = &pios[p]->sm[i];
+
+        if (!sm->enabled)
+          continue;
+
+        if (sm->cfg.clkdiv_256 != 256)
+        {
+          sm->div_acc += 256;
+          if (sm->div_acc < sm->cfg.clkdiv_256)
+            continue;
+          sm->div_acc -= sm->cfg.clkdiv_256;
+        }
+
+        if (sm->quiet)
+          sm->quiet_ticks++;
+        else
+          tick(pios[p], sm, i, true);
+      }
+
+    sim_now++;
+
+    // idle state machines catch up without this cycle's changes
+    if (changed)
+    {
+      uint32_t out_after = pin_out;
+      uint32_t dir_after = pin_dir;
+      uint8_t irq_after[NUM_PIOS];
+
+      for (p = 0; p < NUM_PIOS; p++)
+      {
+        irq_after[p] = pios[p]->irq;
+        pios[p]->irq = irq_before[p];
+      }
+      pin_out = out_before;
+      pin_dir = dir_before;
+
+      sim_pio_disturb();
+
+      pin_out = out_after;
+      pin_dir = dir_after;
+      for (p = 0; p < NUM_PIOS; p++)
+        pios[p]->irq = irq_after[p];
+    }
+
+    if (sim_hw_cycle)
+      hw_busy = sim_hw_cycle();
+  }
+}
+
+//--------------------------------------------------------------------+
+// SDK functions
+//--------------------------------------------------------------------+
+
+static sim_sm_t *get_sm(PIO pio, uint sm)
+{
+  if (sm >= NUM_PIO_STATE_MACHINES)
+  {
+    fprintf(stderr, "sim: bad state machine %u\n", sm);
+    exit(1);
+  }
+  return &blocks[pio_get_index(pio)].sm[sm];
+}
+
+pio_sm_config pio_get_default_sm_config(void)
+{
+  pio_sm_config c;
+
+  memset(&c, 0, sizeof(c));
+  c.clkdiv_256 = 256;
+  c.wrap_target = 0;
+  c.wrap = 31;
+  c.in_shift_right = true;
+  c.out_shift_right = true;
+  c.push_threshold = 32;
+  c.pull_threshold = 32;
+  c.out_count = 32;
+  return c;
+}
+
+static int find_offset(struct sim_pio *pio, const pio_program_t *program)
+{
+  uint32_t mask = bit_mask(program->length);
+  int i;
+
+  if (program->origin >= 0)
+    return ((pio->used & (mask << program->origin)) == 0) ? program->origin : -1;
+
+  for (i = PIO_INSTRUCTION_COUNT - program->length; i >= 0; i--)
+    if ((pio->used & (mask << i)) == 0)
+      return i;
+
+  return -1;
+}
+
+bool pio_can_add_program(PIO pio, const pio_program_t *program)
+{
+  return find_offset(&blocks[pio_get_index(pio)], program) >= 0;
+}
+
+uint pio_add_program(PIO pio, const pio_program_t *program)
+{
+  struct sim_pio *b = &blocks[pio_get_index(pio)];
+  int offset = find_offset(b, program);
+  int i;
+
+  if (offset < 0)
+  {
+    fprintf(stderr, "sim: no program space\n");
+    exit(1);
+  }
+
+  for (i = 0; i < program->length; i++)
+  {
+    uint16_t instr = program->instructions[i];
+
+    // JMP targets are relocated, as the SDK does
+    b->instr[offset + i] = ((instr & 0xe000) == 0) ? (instr + offset) : instr;
+  }
+
+  b->used |= bit_mask(program->length) << offset;
+  return offset;
+}
+
+int pio_claim_unused_sm(PIO pio, bool required)
+{
+  int i;
+
+  for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+    if (!get_sm(pio, i)->claimed)
+    {
+      get_sm(pio, i)->claimed = true;
+      return i;
+    }
+
+  if (required)
+  {
+    fprintf(stderr, "sim: no free state machine\n");
+    exit(1);
+  }
+  return -1;
+}
+
+void pio_sm_claim(PIO pio, uint sm)
+{
+  get_sm(pio, sm)->claimed = true;
+}
+
+void pio_sm_clear_fifos(PIO pio, uint sm)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  s->tx_level = s->tx_read = 0;
+  s->rx_level = s->rx_read = 0;
+}
+
+void pio_sm_restart(PIO pio, uint sm)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  s->isr = 0;
+  s->isr_count = 0;
+  s->osr_count = 32;
+  s->delay = 0;
+  s->push_stalled = false;
+  s->irq_waiting = false;
+  s->exec_pending = false;
+}
+
+void pio_sm_init(PIO pio, uint sm, uint initial_pc, const pio_sm_config *config)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  sim_sync(SIM_CALL_CYCLES);
+
+  s->enabled = false;
+  s->cfg = *config;
+  pio_sm_clear_fifos(pio, sm);
+  pio_sm_restart(pio, sm);
+  s->pc = initial_pc & 31;
+  s->div_acc = 0;
+  s->quiet = false;
+  s->seen_mask = 0;
+}
+
+void pio_sm_set_enabled(PIO pio, uint sm, bool enabled)
+{
+  sim_sync(SIM_CALL_CYCLES);
+
+  sim_pio_disturb();
+  get_sm(pio, sm)->enabled = enabled;
+}
+
+void pio_gpio_init(PIO pio, uint pin)
+{
+  (void)pio;
+  (void)pin;
+}
+
+void pio_sm_set_consecutive_pindirs(PIO pio, uint sm, uint pin_base, uint pin_count, bool is_out)
+{
+  (void)pio;
+  (void)sm;
+
+  sim_pio_disturb();
+  write_pins(&pin_dir, pin_base, pin_count, is_out ? 0xffffffffu : 0);
+}
+
+uint pio_get_index(PIO pio)
+{
+  return (pio == pio1) ? 1 : 0;
+}
+
+// (only the inversion is simulated)
+//
+void gpio_set_inover(uint gpio, uint value)
+{
+  uint32_t bit = 1u << (gpio & 31);
+
+  sim_pio_disturb();
+  in_invert = (value == GPIO_OVERRIDE_INVERT) ? (in_invert | bit) : (in_invert & ~bit);
+}
+
+void pio_sm_put(PIO pio, uint sm, uint32_t data)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  sim_sync(SIM_CALL_CYCLES);
+
+  // as on the hardware, a write to a full FIFO is lost
+  if (s->tx_level < fifo_depth(s, true))
+  {
+    sim_pio_disturb();
+    s->tx[(s->tx_read + s->tx_level) % FIFO_MAX] = data;
+    s->tx_level++;
+  }
+}
+
+void pio_sm_put_blocking(PIO pio, uint sm, uint32_t data)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  sim_sync(SIM_CALL_CYCLES);
+  while (s->tx_level >= fifo_depth(s, true))
+    sim_wait(&s->tx, SIM_NEVER);
+
+  pio_sm_put(pio, sm, data);
+}
+
+uint32_t pio_sm_get(PIO pio, uint sm)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+  uint32_t v = 0;
+
+  sim_sync(SIM_CALL_CYCLES);
+
+  if (s->rx_level)
+  {
+    sim_pio_disturb();
+    v = s->rx[s->rx_read];
+    s->rx_read = (s->rx_read + 1) % FIFO_MAX;
+    s->rx_level--;
+  }
+  return v;
+}
+
+uint32_t pio_sm_get_blocking(PIO pio, uint sm)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  sim_sync(SIM_CALL_CYCLES);
+  while (s->rx_level == 0)
+    sim_wait(&s->rx, SIM_NEVER);
+
+  return pio_sm_get(pio, sm);
+}
+
+bool pio_sm_is_rx_fifo_empty(PIO pio, uint sm)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return get_sm(pio, sm)->rx_level == 0;
+}
+
+bool pio_sm_is_tx_fifo_full(PIO pio, uint sm)
+{
+  sim_sm_t *s = get_sm(pio, sm);
+
+  sim_sync(SIM_CALL_CYCLES);
+  return s->tx_level >= fifo_depth(s, true);
+}
+
+bool pio_sm_is_tx_fifo_empty(PIO pio, uint sm)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return get_sm(pio, sm)->tx_level == 0;
+}
+
+uint pio_sm_get_rx_fifo_level(PIO pio, uint sm)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return get_sm(pio, sm)->rx_level;
+}
+
+uint pio_sm_get_tx_fifo_level(PIO pio, uint sm)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return get_sm(pio, sm)->tx_level;
+}
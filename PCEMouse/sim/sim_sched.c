@@ -0,0 +1,377 @@
+/*
+ * sim_sched.c - simulated time, threads, and the core SDK functions
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <ucontext.h>
+
+#include "sim.h"
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+#include "hardware/flash.h"
+#include "bsp/board.h"
+
+//--------------------------------------------------------------------+
+// Threads are coroutines (ucontext); the scheduler always resumes the
+// one furthest behind in time, after running the PIO blocks up to that
+// point. A thread gives control back only from sim_sync()/sim_wait(),
+// i.e. inside SDK calls.
+//--------------------------------------------------------------------+
+
+#define SIM_STACK_SIZE  (256 * 1024)
+
+enum
+{
+  TH_UNUSED = 0,
+  TH_READY,                         // runs at 't'
+  TH_WAITING,                       // waits on 'object', or until 'timeout'
+  TH_DONE
+};
+
+typedef struct
+{
+  ucontext_t   ctx;
+  void        *stack;
+  void       (*entry)(void);
+  int          state;
+  sim_time_t   t;
+  sim_time_t   timeout;
+  const void  *object;
+  bool         event;               // event register (SEV/WFE)
+  bool         woken;               // left sim_wait() because of its object
+} sim_thread_t;
+
+static sim_thread_t thread[SIM_THREADS];
+static ucontext_t   sched_ctx;
+static int          current = -1;
+
+bool sim_woken = false;
+
+bool sim_firmware_output = false;
+
+
+static void trampoline(void)
+{
+  thread[current].entry();
+  thread[current].state = TH_DONE;
+  swapcontext(&thread[current].ctx, &sched_ctx);
+}
+
+void sim_thread_start(int id, void (*entry)(void), sim_time_t at)
+{
+  sim_thread_t *th = &thread[id];
+
+  th->stack = malloc(SIM_STACK_SIZE);
+  th->entry = entry;
+  th->state = TH_READY;
+  th->t = at;
+  th->event = false;
+
+  getcontext(&th->ctx);
+  th->ctx.uc_stack.ss_sp = th->stack;
+  th->ctx.uc_stack.ss_size = SIM_STACK_SIZE;
+  th->ctx.uc_link = NULL;
+  makecontext(&th->ctx, trampoline, 0);
+}
+
+int sim_thread_current(void)
+{
+  return current;
+}
+
+static inline void yield(void)
+{
+  swapcontext(&thread[current].ctx, &sched_ctx);
+}
+
+void sim_sync(sim_time_t cost)
+{
+  if (current < 0)
+    return;
+
+  thread[current].t += cost;
+  yield();
+}
+
+void sim_sleep_until(sim_time_t t)
+{
+  if (current < 0)
+    return;
+
+  if (t > thread[current].t)
+    thread[current].t = t;
+  yield();
+}
+
+bool sim_wait(const void *object, sim_time_t timeout)
+{
+  sim_thread_t *th;
+
+  if (current < 0)
+    return false;
+
+  th = &thread[current];
+  th->state = TH_WAITING;
+  th->object = object;
+  th->timeout = timeout;
+  th->woken = false;
+  yield();
+
+  return th->woken;
+}
+
+void sim_notify(const void *object)
+{
+  int i;
+
+  for (i = 0; i < SIM_THREADS; i++)
+  {
+    sim_thread_t *th = &thread[i];
+
+    if ((th->state == TH_WAITING) && (th->object == object))
+    {
+      th->state = TH_READY;
+      th->t = sim_now + SIM_WAKE_CYCLES;
+      th->woken = true;
+      sim_woken = true;
+    }
+  }
+}
+
+void sim_event(int id)
+{
+  thread[id].event = true;
+  sim_notify(&thread[id].event);
+}
+
+//
+// sim_run - run everything up to 'end'
+//
+void sim_run(sim_time_t end)
+{
+  while (1)
+  {
+    sim_time_t best_t = SIM_NEVER;
+    int best = -1;
+    int i;
+
+    for (i = 0; i < SIM_THREADS; i++)
+    {
+      sim_time_t t = (thread[i].state == TH_READY) ? thread[i].t :
+                     (thread[i].state == TH_WAITING) ? thread[i].timeout : SIM_NEVER;
+
+      if (t < best_t)
+      {
+        best_t = t;
+        best = i;
+      }
+    }
+
+    // a thread may be woken (earlier) by what the PIO blocks do meanwhile
+    if (best_t > end)
+    {
+      sim_pio_run_until(end);
+      if (sim_now < end)
+        continue;
+      return;
+    }
+
+    if (best_t > sim_now)
+    {
+      sim_pio_run_until(best_t);
+      if (sim_now < best_t)
+        continue;
+    }
+
+    if (thread[best].state == TH_WAITING)
+    {
+      thread[best].state = TH_READY;
+      thread[best].t = best_t;
+    }
+
+    current = best;
+    swapcontext(&sched_ctx, &thread[best].ctx);
+    current = -1;
+  }
+}
+
+//--------------------------------------------------------------------+
+// pico/time.h, pico/platform.h, hardware/sync.h, pico/multicore.h
+//--------------------------------------------------------------------+
+
+uint64_t time_us_64(void)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return sim_now / SIM_CYCLES_PER_US;
+}
+
+uint32_t time_us_32(void)
+{
+  return (uint32_t)time_us_64();
+}
+
+absolute_time_t get_absolute_time(void)
+{
+  return time_us_64();
+}
+
+void sleep_us(uint64_t us)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  sim_sleep_until(sim_now + SIM_US(us));
+}
+
+void sleep_ms(uint32_t ms)
+{
+  sleep_us((uint64_t)ms * 1000);
+}
+
+uint get_core_num(void)
+{
+  return (current == SIM_CORE1) ? 1 : 0;
+}
+
+void __sev(void)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  sim_event(SIM_CORE0);
+  sim_event(SIM_CORE1);
+}
+
+void __wfe(void)
+{
+  sim_sync(SIM_CALL_CYCLES);
+
+  if (current < 0)
+    return;
+
+  if (!thread[current].event)
+    sim_wait(&thread[current].event, SIM_NEVER);
+  thread[current].event = false;
+}
+
+//
+// best_effort_wfe_or_timeout - as the SDK: sleep until an event, or the timeout
+//
+bool best_effort_wfe_or_timeout(absolute_time_t timeout)
+{
+  sim_sync(SIM_CALL_CYCLES);
+
+  if (current < 0)
+    return true;
+
+  if ((sim_now / SIM_CYCLES_PER_US) >= timeout)
+    return true;
+
+  if (!thread[current].event)
+    sim_wait(&thread[current].event, SIM_US(timeout));
+  thread[current].event = false;
+
+  return (sim_now / SIM_CYCLES_PER_US) >= timeout;
+}
+
+void multicore_launch_core1(void (*entry)(void))
+{
+  sim_sync(SIM_CALL_CYCLES);
+  sim_thread_start(SIM_CORE1, entry, sim_now + SIM_US(10));
+}
+
+//--------------------------------------------------------------------+
+// hardware/flash.h
+//--------------------------------------------------------------------+
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+void flash_range_erase(uint32_t flash_offs, size_t count)
+{
+  if ((flash_offs % FLASH_SECTOR_SIZE) || (count % FLASH_SECTOR_SIZE) ||
+      (flash_offs + count > PICO_FLASH_SIZE_BYTES))
+  {
+    fprintf(stderr, "sim: bad flash erase %lx+%lx\n", (unsigned long)flash_offs, (unsigned long)count);
+    abort();
+  }
+  memset(&sim_flash[flash_offs], 0xff, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count)
+{
+  size_t i;
+
+  if ((flash_offs % FLASH_PAGE_SIZE) || (count % FLASH_PAGE_SIZE) ||
+      (flash_offs + count > PICO_FLASH_SIZE_BYTES))
+  {
+    fprintf(stderr, "sim: bad flash program %lx+%lx\n", (unsigned long)flash_offs, (unsigned long)count);
+    abort();
+  }
+
+  // programming can only clear bits
+  for (i = 0; i < count; i++)
+    sim_flash[flash_offs + i] &= data[i];
+}
+
+//--------------------------------------------------------------------+
+// GPIO, stdio and board support
+//--------------------------------------------------------------------+
+
+bool gpio_get(uint gpio)
+{
+  sim_sync(SIM_CALL_CYCLES);
+  return sim_pin_input(gpio);
+}
+
+void gpio_init(uint gpio)               { (void)gpio; }
+void gpio_set_dir(uint gpio, bool out)  { (void)gpio; (void)out; }
+void gpio_put(uint gpio, bool value)    { (void)gpio; (void)value; }
+void gpio_pull_up(uint gpio)            { (void)gpio; }
+void gpio_pull_down(uint gpio)          { (void)gpio; }
+
+bool stdio_init_all(void)
+{
+  return true;
+}
+
+int getchar_timeout_us(uint32_t timeout_us)
+{
+  (void)timeout_us;
+
+  sim_sync(SIM_CALL_CYCLES);
+  return PICO_ERROR_TIMEOUT;
+}
+
+//
+// sim_printf - the firmware's printf (see the Makefile)
+//
+int sim_printf(const char *fmt, ...)
+{
+  va_list ap;
+  int n = 0;
+
+  if (sim_firmware_output)
+  {
+    va_start(ap, fmt);
+    n = vprintf(fmt, ap);
+    va_end(ap);
+  }
+  return n;
+}
+
+void board_init(void)
+{
+}
+
+uint32_t board_millis(void)
+{
+  return time_us_32() / 1000;
+}
+
+void board_led_write(bool state)
+{
+  (void)state;
+}
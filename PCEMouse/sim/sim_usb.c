@@ -0,0 +1,356 @@
+/*
+ * sim_usb.c - scripted USB mouse (or gamepad), and the TinyUSB host functions
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim.h"
+#include "tusb.h"
+
+//--------------------------------------------------------------------+
+// Script format (one command per line, '#' starts a comment):
+//
+//   rate <us>            report interval (default 1000, i.e. 1kHz)
+//   jitter <us>          each report arrives up to this much early or late
+//   seed <n>             for the jitter
+//   buttons <mask>       USB buttons held in the following reports
+//                        (1 = left, 2 = right, 4 = middle, 8 = back, 16 = forward)
+//   move <dx> <dy> <n>   n reports, each moving by dx, dy (-127..127)
+//   idle <ms>            no reports for this long
+//
+// The mouse is mounted as device 1, instance 0, with the boot protocol.
+//
+// With SIM_GAMEPAD, device 1 instance 0 is a gamepad instead (16 buttons,
+// then a signed 8-bit stick; see pad_desc): "buttons" are its buttons (1 =
+// button 1, 2 = button 2, 4 = button 3, ...), and "move" holds the stick at
+// dx, dy.  With PAD_EMULATION, a boot mouse, which reports before the gamepad
+// does, is mounted alongside it as instance 1 (it must not take the console
+// port).
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  sim_time_t t;                     // from the start of the script
+  uint16_t   buttons;
+  int8_t     x;
+  int8_t     y;
+} sim_report_t;
+
+#ifdef SIM_GAMEPAD
+static const uint8_t pad_desc[] =
+{
+  0x05, 0x01,         // Usage Page (Generic Desktop)
+  0x09, 0x05,         // Usage (Gamepad)
+  0xa1, 0x01,         // Collection (Application)
+  0x05, 0x09,         //   Usage Page (Button)
+  0x19, 0x01,         //   Usage Minimum (1)
+  0x29, 0x10,         //   Usage Maximum (16)
+  0x15, 0x00,         //   Logical Minimum (0)
+  0x25, 0x01,         //   Logical Maximum (1)
+  0x75, 0x01,         //   Report Size (1)
+  0x95, 0x10,         //   Report Count (16)
+  0x81, 0x02,         //   Input (Data, Variable, Absolute)
+  0x05, 0x01,         //   Usage Page (Generic Desktop)
+  0x09, 0x30,         //   Usage (X)
+  0x09, 0x31,         //   Usage (Y)
+  0x15, 0x81,         //   Logical Minimum (-127)
+  0x25, 0x7f,         //   Logical Maximum (127)
+  0x75, 0x08,         //   Report Size (8)
+  0x95, 0x02,         //   Report Count (2)
+  0x81, 0x02,         //   Input (Data, Variable, Absolute)
+  0xc0                // End Collection
+};
+#endif
+
+static sim_report_t *reports = NULL;
+static int           report_alloc = 0;
+static sim_time_t    duration = 0;
+static sim_time_t    start_at = 0;
+
+static volatile int  arrived = 0;   // reports sent by the mouse so far
+static int           delivered = 0; // reports handed to the firmware
+static bool          mounted = false;
+
+int       sim_report_count = 0;
+uint32_t  sim_report_rate_us = 1000;
+
+sim_post_t *sim_posts = NULL;
+int         sim_post_count = 0;
+static int  post_alloc = 0;
+
+
+static void add_report(sim_time_t t, uint16_t buttons, int x, int y)
+{
+  if (sim_report_count >= report_alloc)
+  {
+    report_alloc = report_alloc ? (report_alloc * 2) : 1024;
+    reports = realloc(reports, report_alloc * sizeof(sim_report_t));
+  }
+
+  reports[sim_report_count].t = t;
+  reports[sim_report_count].buttons = buttons;
+  reports[sim_report_count].x = x;
+  reports[sim_report_count].y = y;
+  sim_report_count++;
+}
+
+int sim_usb_load(const char *script)
+{
+  FILE *f = fopen(script, "r");
+  char buf[256];
+  sim_time_t t = 0;
+  uint32_t rate = 1000;
+  uint32_t jitter = 0;
+  uint32_t seed = 1;
+  uint16_t buttons = 0;
+  int line = 0;
+
+  if (f == NULL)
+  {
+    perror(script);
+    return -1;
+  }
+
+  while (fgets(buf, sizeof(buf), f))
+  {
+    char cmd[32];
+    int a = 0, b = 0, n = 0;
+    int args;
+    char *c;
+
+    line++;
+    if ((c = strchr(buf, '#')) != NULL)
+      *c = '\0';
+
+    args = sscanf(buf, "%31s %i %i %i", cmd, &a, &b, &n);
+    if (args <= 0)
+      continue;
+
+    if ((strcmp(cmd, "rate") == 0) && (args == 2) && (a > 0))
+      rate = a;
+    else if ((strcmp(cmd, "jitter") == 0) && (args == 2) && (a >= 0))
+      jitter = a;
+    else if ((strcmp(cmd, "seed") == 0) && (args == 2))
+      seed = a;
+    else if ((strcmp(cmd, "buttons") == 0) && (args == 2))
+      buttons = a;
+    else if ((strcmp(cmd, "idle") == 0) && (args == 2) && (a >= 0))
+      t += SIM_US((uint64_t)a * 1000);
+    else if ((strcmp(cmd, "move") == 0) && (args == 4) && (n >= 0) &&
+             (a >= -127) && (a <= 127) && (b >= -127) && (b <= 127))
+    {
+      while (n--)
+      {
+        int32_t j = 0;
+
+        t += SIM_US(rate);
+
+        // jitter never reorders reports
+        if (jitter && (jitter < rate / 2))
+        {
+          seed = seed * 1103515245 + 12345;
+          j = (int32_t)((seed >> 8) % (2 * jitter + 1)) - (int32_t)jitter;
+        }
+        add_report(t + (sim_time_t)((int64_t)j * SIM_CYCLES_PER_US), buttons, a, b);
+      }
+    }
+    else
+    {
+      fprintf(stderr, "%s:%d: bad command\n", script, line);
+      fclose(f);
+      return -1;
+    }
+  }
+
+  fclose(f);
+
+  sim_report_rate_us = rate;
+  duration = t + SIM_US(rate);
+  return 0;
+}
+
+sim_time_t sim_usb_duration(void)
+{
+  return duration;
+}
+
+//
+// mouse - sends each report at its time (the USB interrupt wakes core 0)
+//
+static void mouse(void)
+{
+  while (arrived < sim_report_count)
+  {
+    sim_sleep_until(start_at + reports[arrived].t);
+    arrived++;
+    sim_event(SIM_CORE0);
+  }
+}
+
+void sim_usb_start(sim_time_t at)
+{
+  start_at = at;
+  sim_thread_start(SIM_MOUSE, mouse, at);
+}
+
+//--------------------------------------------------------------------+
+// The truth: what the firmware was given, for console port 1
+// (hid_app.c's calls to post_globals() are redirected here; see the Makefile)
+//--------------------------------------------------------------------+
+
+void __real_post_globals(uint8_t port, uint8_t buttons, int16_t delta_x, int16_t delta_y);
+
+void __wrap_post_globals(uint8_t port, uint8_t buttons, int16_t delta_x, int16_t delta_y)
+{
+  if (port == 0)
+  {
+    sim_post_t *p;
+
+    if (sim_post_count >= post_alloc)
+    {
+      post_alloc = post_alloc ? (post_alloc * 2) : 1024;
+      sim_posts = realloc(sim_posts, post_alloc * sizeof(sim_post_t));
+    }
+
+    p = &sim_posts[sim_post_count];
+    p->t = sim_now;
+    p->cx = (sim_post_count ? sim_posts[sim_post_count - 1].cx : 0) + delta_x;
+    p->cy = (sim_post_count ? sim_posts[sim_post_count - 1].cy : 0) + delta_y;
+    p->buttons = buttons;
+    p->moved = (delta_x != 0) || (delta_y != 0);
+    p->reads_before = sim_reads_started;
+    sim_post_count++;
+  }
+
+  __real_post_globals(port, buttons, delta_x, delta_y);
+}
+
+//
+// The same for the joypad (SIM_GAMEPAD), from hid_app.c's calls to post_pad()
+//
+sim_pad_post_t *sim_pads = NULL;
+int             sim_pad_count = 0;
+static int      pad_alloc = 0;
+
+void __real_post_pad(uint8_t port, uint16_t pad);
+
+void __wrap_post_pad(uint8_t port, uint16_t pad)
+{
+  if (port == 0)
+  {
+    if (sim_pad_count >= pad_alloc)
+    {
+      pad_alloc = pad_alloc ? (pad_alloc * 2) : 256;
+      sim_pads = realloc(sim_pads, pad_alloc * sizeof(sim_pad_post_t));
+    }
+
+    sim_pads[sim_pad_count].t = sim_now;
+    sim_pads[sim_pad_count].pad = pad;
+    sim_pad_count++;
+  }
+
+  __real_post_pad(port, pad);
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB host
+//--------------------------------------------------------------------+
+
+bool tusb_init(void)
+{
+  return true;
+}
+
+void tuh_task(void)
+{
+  sim_sync(SIM_CALL_CYCLES);
+
+  if (!mounted)
+  {
+    mounted = true;
+#if defined(SIM_GAMEPAD) && defined(PAD_EMULATION)
+    hid_mouse_report_t report;
+
+    tuh_hid_mount_cb(1, 0, pad_desc, sizeof(pad_desc));
+    tuh_hid_mount_cb(1, 1, NULL, 0);
+
+    memset(&report, 0, sizeof(report));
+    report.x = 1;
+    tuh_hid_report_received_cb(1, 1, (uint8_t const *)&report, sizeof(report));
+#elif defined(SIM_GAMEPAD)
+    tuh_hid_mount_cb(1, 0, pad_desc, sizeof(pad_desc));
+#else
+    tuh_hid_mount_cb(1, 0, NULL, 0);
+#endif
+  }
+
+  while (delivered < arrived)
+  {
+    sim_report_t *r = &reports[delivered++];
+#ifdef SIM_GAMEPAD
+    uint8_t report[4];
+
+    report[0] = r->buttons & 0xff;
+    report[1] = r->buttons >> 8;
+    report[2] = (uint8_t)r->x;
+    report[3] = (uint8_t)r->y;
+
+    tuh_hid_report_received_cb(1, 0, report, sizeof(report));
+#else
+    hid_mouse_report_t report;
+
+    memset(&report, 0, sizeof(report));
+    report.buttons = r->buttons;
+    report.x = r->x;
+    report.y = r->y;
+
+    tuh_hid_report_received_cb(1, 0, (uint8_t const *)&report, sizeof(report));
+#endif
+  }
+}
+
+bool tuh_vid_pid_get(uint8_t dev_addr, uint16_t *vid, uint16_t *pid)
+{
+  (void)dev_addr;
+
+  *vid = 0;
+  *pid = 0;
+  return true;
+}
+
+uint8_t tuh_hid_interface_protocol(uint8_t dev_addr, uint8_t instance)
+{
+  (void)dev_addr;
+
+#ifdef SIM_GAMEPAD
+  if (instance == 0)
+    return HID_ITF_PROTOCOL_NONE;
+#else
+  (void)instance;
+#endif
+  return HID_ITF_PROTOCOL_MOUSE;
+}
+
+bool tuh_hid_receive_report(uint8_t dev_addr, uint8_t instance)
+{
+  (void)dev_addr;
+  (void)instance;
+
+  return true;
+}
+
+uint8_t tuh_hid_parse_report_descriptor(tuh_hid_report_info_t *report_info_arr, uint8_t arr_count,
+                                        uint8_t const *desc_report, uint16_t desc_len)
+{
+  (void)report_info_arr;
+  (void)arr_count;
+  (void)desc_report;
+  (void)desc_len;
+
+  return 0;
+}
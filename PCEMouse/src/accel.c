@@ -0,0 +1,92 @@
+/*
+ * accel.c - fixed-point acceleration (response) curves for PCEMouse
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include "accel.h"
+
+// Curve definitions
+// -----------------
+// The first four are flat (no acceleration); "slow", "normal" and "fast"
+// match the original 2/3, 3/3 and 5/3 sensitivity levels.
+//
+// "precise" slows small motions down for menu-driven games, while still
+// allowing the cursor to cross the screen with a quick flick.
+// "shooter" accelerates quick motions for games needing fast turns.
+// "trackball" (the default for trackballs) gives slow rolls a little more
+// reach, and a quick spin a lot more.
+//
+const accel_curve_t accel_curves[] =
+{
+  // name       gain_low  gain_high  speed_low  speed_high
+  { "precise",     128,      256,        4,        24 },
+  { "slow",        171,      171,        0,         0 },
+  { "normal",      256,      256,        0,         0 },
+  { "fast",        427,      427,        0,         0 },
+  { "shooter",     256,      768,        4,        24 },
+  { "trackball",   320,      896,        2,        16 },
+};
+
+#define ACCEL_CURVES  (sizeof(accel_curves) / sizeof(accel_curves[0]))
+
+const int accel_curve_count   = ACCEL_CURVES;
+const int accel_curve_default[ACCEL_KINDS] = { 2, 5 };
+
+// Tables are expanded into SRAM so that the lookup never goes to XIP flash
+//
+static uint16_t accel_tables[ACCEL_CURVES][ACCEL_TABLE_SIZE];
+static int accel_curve[ACCEL_KINDS] = { 2, 5 };
+
+const uint16_t *accel_active[ACCEL_KINDS] = { accel_tables[2], accel_tables[5] };
+
+
+static void accel_build(uint16_t *table, const accel_curve_t *curve)
+{
+int speed;
+int span = curve->speed_high - curve->speed_low;
+
+  for (speed = 0; speed < ACCEL_TABLE_SIZE; speed++)
+  {
+    if ((speed <= curve->speed_low) || (span <= 0))
+      table[speed] = curve->gain_low;
+    else if (speed >= curve->speed_high)
+      table[speed] = curve->gain_high;
+    else
+      table[speed] = curve->gain_low +
+                     (((curve->gain_high - curve->gain_low) * (speed - curve->speed_low)) / span);
+  }
+}
+
+//
+// accel_init - expand all curves into lookup tables (not on the hot path)
+//
+void accel_init(void)
+{
+int i;
+
+  for (i = 0; i < ACCEL_CURVES; i++)
+    accel_build(accel_tables[i], &accel_curves[i]);
+
+  for (i = 0; i < ACCEL_KINDS; i++)
+    accel_select(i, accel_curve_default[i]);
+}
+
+//
+// accel_select - switch curves; only a pointer changes, so this is safe
+//                to call from the report path (e.g. on scroll wheel)
+//
+void accel_select(accel_kind_t kind, int curve)
+{
+  if ((kind >= ACCEL_KINDS) || (curve < 0) || (curve >= ACCEL_CURVES))
+    return;
+
+  accel_curve[kind] = curve;
+  accel_active[kind] = accel_tables[curve];
+}
+
+int accel_selected(accel_kind_t kind)
+{
+  return accel_curve[kind];
+}
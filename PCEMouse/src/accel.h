@@ -0,0 +1,86 @@
+/*
+ * accel.h - fixed-point acceleration (response) curves for PCEMouse
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _ACCEL_H_
+#define _ACCEL_H_
+
+#include <stdint.h>
+
+//--------------------------------------------------------------------+
+// Each curve is expanded once (at init) into a lookup table of gains,
+// indexed by the speed of the current report (counts per report).
+// Gains are 8.8 fixed-point (256 = 1.0x), and the fractional part of
+// each scaled delta is carried forward per axis, so small motions are
+// never rounded away and no division is done per report.
+//--------------------------------------------------------------------+
+
+#define ACCEL_FRAC_BITS     8
+#define ACCEL_ONE           (1 << ACCEL_FRAC_BITS)
+#define ACCEL_TABLE_SIZE    64      // speeds at/above (size-1) use the last entry
+
+typedef struct
+{
+  const char *name;
+  uint16_t    gain_low;     // gain at or below speed_low (8.8 fixed-point)
+  uint16_t    gain_high;    // gain at or above speed_high (8.8 fixed-point)
+  uint8_t     speed_low;    // gain ramps linearly between these two speeds
+  uint8_t     speed_high;
+} accel_curve_t;
+
+// fractional carry (in 1/256ths of an output count), one per axis
+typedef struct
+{
+  int32_t carry_x;
+  int32_t carry_y;
+} accel_state_t;
+
+// Each kind of pointing device has its own curve selection
+// (a trackball moves far fewer counts per gesture than a mouse)
+//
+typedef enum
+{
+  ACCEL_MOUSE = 0,
+  ACCEL_TRACKBALL,
+  ACCEL_KINDS
+} accel_kind_t;
+
+extern const accel_curve_t accel_curves[];
+extern const int           accel_curve_count;
+extern const int           accel_curve_default[ACCEL_KINDS];
+
+// table for the currently-selected curve of each kind; read once per report
+extern const uint16_t     *accel_active[ACCEL_KINDS];
+
+void accel_init(void);
+void accel_select(accel_kind_t kind, int curve);
+int  accel_selected(accel_kind_t kind);
+
+//
+// accel_apply - scale one report's deltas through the kind's active curve
+//               speed is approximated as max + min/2 of the two axes
+//
+static inline void accel_apply(accel_state_t *st, accel_kind_t kind, int dx, int dy, int *out_x, int *out_y)
+{
+  int ax = (dx < 0) ? -dx : dx;
+  int ay = (dy < 0) ? -dy : dy;
+  int speed = (ax > ay) ? (ax + (ay >> 1)) : (ay + (ax >> 1));
+
+  if (speed > (ACCEL_TABLE_SIZE - 1))
+    speed = ACCEL_TABLE_SIZE - 1;
+
+  int32_t gain = accel_active[kind][speed];
+  int32_t scaled_x = (dx * gain) + st->carry_x;
+  int32_t scaled_y = (dy * gain) + st->carry_y;
+
+  *out_x = scaled_x >> ACCEL_FRAC_BITS;
+  *out_y = scaled_y >> ACCEL_FRAC_BITS;
+
+  st->carry_x = scaled_x - (*out_x * ACCEL_ONE);
+  st->carry_y = scaled_y - (*out_y * ACCEL_ONE);
+}
+
+#endif /* _ACCEL_H_ */
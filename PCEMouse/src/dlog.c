@@ -0,0 +1,79 @@
+/*
+ * dlog.c - deferred logging: record now, format later
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+
+#include "dlog.h"
+
+#ifdef DLOG_ENABLE
+
+volatile bool dlog_on = false;
+
+RING_DEFINE(dlog_core0, dlog_rec_t, 128);
+RING_DEFINE(dlog_core1, dlog_rec_t, 32);
+
+static uint32_t dlog_lost_reported = 0;
+
+//
+// dlog_task - print the oldest pending record (if any)
+//
+// At most one record is printed per call, and only when the UART's TX FIFO
+// is empty (see dlog_writable()), so printf never waits for the UART; if the
+// log is produced faster than the UART can send it, the records stay in the
+// ring until it fills, then the excess is dropped, and the number lost is
+// reported.
+//
+void dlog_task(void)
+{
+  dlog_rec_t rec;
+  ring_t *r;
+  uint32_t lost;
+
+  if (!dlog_writable())
+    return;
+
+  // (the note takes the FIFO to itself; the record goes next time)
+  lost = dlog_core0.dropped + dlog_core1.dropped;
+  if (lost != dlog_lost_reported)
+  {
+    printf("[log: %lu records lost]\r\n", (unsigned long)(lost - dlog_lost_reported));
+    dlog_lost_reported = lost;
+    return;
+  }
+
+  const dlog_rec_t *a = ring_peek(&dlog_core0);
+  const dlog_rec_t *b = ring_peek(&dlog_core1);
+
+  // take the older of the two cores' records
+  if (a && b)
+    r = ((int32_t)(a->t_us - b->t_us) <= 0) ? &dlog_core0 : &dlog_core1;
+  else if (a)
+    r = &dlog_core0;
+  else if (b)
+    r = &dlog_core1;
+  else
+    return;
+
+  if (!ring_get(r, &rec))
+    return;
+
+  printf(rec.fmt, rec.arg[0], rec.arg[1], rec.arg[2], rec.arg[3], rec.arg[4]);
+}
+
+//
+// dlog_command - console commands: 'l' switches logging on/off
+//
+void dlog_command(int c)
+{
+  if ((c == 'l') || (c == 'L'))
+  {
+    dlog_on = !dlog_on;
+    printf("\r\n[log %s]\r\n", dlog_on ? "on" : "off");
+  }
+}
+
+#endif
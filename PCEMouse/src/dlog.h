@@ -0,0 +1,101 @@
+/*
+ * dlog.h - deferred logging: record now, format later
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _DLOG_H_
+#define _DLOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "pico/stdlib.h"
+#include "pico/platform.h"
+#include "hardware/uart.h"
+#include "ring.h"
+
+// Comment out the following line to compile all logging out:
+#define DLOG_ENABLE  true
+
+//--------------------------------------------------------------------+
+// A log call stores a fixed-size record (timestamp, format string
+// pointer and up to DLOG_ARGS integer arguments) into the ring for the
+// calling core - no formatting and no stdio on the hot path. dlog_task()
+// runs in the idle part of the core 0 loop, and prints a record at a
+// time, oldest first across both cores, and only once the UART has room
+// for it: the log never holds up the loop, and what the UART can't keep
+// up with is dropped (and counted).
+//
+// The format string must be a literal (only its address is kept), and
+// each argument is passed to printf as an int.
+//
+// Logging is off at startup; it is switched on and off at runtime ('l' on
+// the console).
+//--------------------------------------------------------------------+
+
+#define DLOG_ARGS   5
+
+typedef struct
+{
+  uint32_t    t_us;
+  const char *fmt;
+  int         arg[DLOG_ARGS];
+} dlog_rec_t;
+
+#ifdef DLOG_ENABLE
+
+extern volatile bool dlog_on;
+extern ring_t dlog_core0;
+extern ring_t dlog_core1;
+
+void dlog_task(void);
+void dlog_command(int c);
+
+static inline void dlog5(const char *fmt, int a0, int a1, int a2, int a3, int a4)
+{
+  dlog_rec_t rec;
+
+  if (!dlog_on)
+    return;
+
+  rec.t_us = time_us_32();
+  rec.fmt = fmt;
+  rec.arg[0] = a0;
+  rec.arg[1] = a1;
+  rec.arg[2] = a2;
+  rec.arg[3] = a3;
+  rec.arg[4] = a4;
+
+  ring_put((get_core_num() == 0) ? &dlog_core0 : &dlog_core1, &rec);
+}
+
+static inline bool dlog_pending(void)
+{
+  return ((ring_count(&dlog_core0) != 0) || (ring_count(&dlog_core1) != 0));
+}
+
+// room for a record (of up to 32 characters) without waiting: the TX FIFO is empty
+//
+static inline bool dlog_writable(void)
+{
+  return (uart_get_hw(uart_default)->fr & UART_UARTFR_TXFE_BITS) != 0;
+}
+
+#else
+
+static inline void dlog_task(void) { }
+static inline void dlog_command(int c) { }
+static inline bool dlog_pending(void) { return false; }
+static inline bool dlog_writable(void) { return false; }
+static inline void dlog5(const char *fmt, int a0, int a1, int a2, int a3, int a4) { }
+
+#endif
+
+#define dlog(fmt)                 dlog5(fmt, 0, 0, 0, 0, 0)
+#define dlog1(fmt, a)             dlog5(fmt, (a), 0, 0, 0, 0)
+#define dlog2(fmt, a, b)          dlog5(fmt, (a), (b), 0, 0, 0)
+#define dlog3(fmt, a, b, c)       dlog5(fmt, (a), (b), (c), 0, 0)
+
+#endif /* _DLOG_H_ */
@@ -35,9 +35,18 @@
  *
  */
 
+#include <string.h>
+
 #include "bsp/board.h"
 #include "tusb.h"
 
+#include "accel.h"
+#include "dlog.h"
+
+#include "hid_layout.h"
+#include "pcemouse.h"
+#include "settings.h"
+
 //--------------------------------------------------------------------+
 // MACRO TYPEDEF CONSTANT ENUM DECLARATION
 //--------------------------------------------------------------------+
@@ -46,96 +55,338 @@
 // it can be use to simulate mouse cursor movement within terminal
 #define USE_ANSI_ESCAPE   0
 
-#define MAX_REPORT  4
+// Uncomment the following line to give each mouse its own console port (in order of
+// connection), rather than merging all mice into one cursor:
+// #define MULTI_MOUSE_ROUTED  true
 
-// Uncomment the following line if you desire button-swap when middle button is clicked:
-// #define MID_BUTTON_SWAPPABLE  true
 
-// Uncomment the following line if you desire adjustable sensitivity from scroll-wheel:
-#define SENSITIVITY_SCROLL  true
+// Button swap (middle button) and sensitivity (scroll wheel) are settings,
+// kept in flash; their defaults are in settings.c. The scroll wheel steps
+// through the curves defined in accel.c (one selection for mice, and one
+// for trackballs)
 
 
-
-// Button swap functionality
-// -------------------------
-#ifdef MID_BUTTON_SWAPPABLE
-const bool buttons_swappable = true;
+// Multiple mice
+// -------------
+#ifdef MULTI_MOUSE_ROUTED
+const bool mice_routed = true;
 #else
-const bool buttons_swappable = false;
+const bool mice_routed = false;
 #endif
 
-static bool buttons_swapped = false;
 
+// Other input devices
+// -------------------
+// Trackballs are recognised by their USB IDs, and use the trackball curve
+// selection (see accel.c); otherwise they are handled as mice
+//
+typedef struct
+{
+  uint16_t vid;
+  uint16_t pid;
+} usb_id_t;
+
+static const usb_id_t trackball_ids[] =
+{
+  { 0x046d, 0xc408 },     // Logitech Marble Mouse
+  { 0x047d, 0x1020 },     // Kensington Expert Mouse
+  { 0x047d, 0x2041 },     // Kensington SlimBlade
+  { 0x047d, 0x2048 },     // Kensington Orbit with scroll ring
+};
+
+// Tablets, pens, touch screens and absolute pointers are moved on as if they
+// were mice: the full width (or height) of the tablet is this many counts
+//
+#define TABLET_SPAN     1024
+
+// Gamepads and joysticks drive a console port as a joypad; which of their
+// buttons are I, II, Select and Run, then III, IV, V and VI (6-button pad)
+// is a setting (see settings.c)
+//
+static const uint16_t pad_bits[PAD_BUTTONS] =
+{
+  PAD_I, PAD_II, PAD_SEL, PAD_RUN, PAD_III, PAD_IV, PAD_V, PAD_VI
+};
+
+// The stick counts as a direction beyond this fraction of its travel
+// (1/4 = a quarter of the way from the centre to either end)
+//
+#define GAMEPAD_THRESHOLD_SHIFT   2
 
-// Sensitivity adjust (on scroll wheel) functionality
-// --------------------------------------------------
-#ifdef SENSITIVITY_SCROLL
-const bool sensitivity_adjustable = true;
-#else
-const bool sensitivity_adjustable = false;
-#endif
 
-int sensitivity_level = 1;
+// Largest motion taken from one report of a (non-boot) mouse
+//
+#define MOUSE_DELTA_MAX 4096
 
-const int sensitivity_multiplier[] = {2, 3, 5};
-const int sensitivity_divider = 3;
 
-int sens_remainder_x = 0;
-int sens_remainder_y = 0;
+// USB addresses run from 1 up to the number of devices plus hubs
+//
+#define HID_DEV_SLOTS   (CFG_TUH_DEVICE_MAX + CFG_TUH_HUB + 1)
+
+// State for each HID interface, keyed by (dev_addr, instance). Everything here
+// is touched only by the report path on core 0, so no locking is needed, and
+// a report only ever looks at its own entry (and its port's combined state).
+//
+// The decoder for the interface is chosen once, when it is mounted (from its
+// protocol, or from its report descriptor), so each report costs one call.
+//
+typedef struct input_dev_s input_dev_t;
+typedef void (*input_decode_t)(input_dev_t *dev, uint8_t const *report, uint16_t len);
+
+struct input_dev_s
+{
+  input_decode_t decode;        // what to do with each report
+  bool          active;         // reports seen, and given a port
+  bool          pointer;        // moves the mouse (or else, drives a joypad)
+  uint8_t       port;           // console port this device drives
+  uint8_t       usb_buttons;    // raw buttons from the previous report
+  uint8_t       buttons;        // PCE buttons, active-low
+  bool          swapped;        // buttons swapped (middle button)
+  accel_kind_t  accel_kind;     // which curve selection applies
+  accel_state_t accel;          // fractional motion carried between reports
+  hid_layout_t  layout;         // generic (report descriptor) devices
+
+  bool          tracking;       // tablets: pen in range / finger down
+  int32_t       tablet_x;       // position at the previous report, in counts
+  int32_t       tablet_y;
+  int32_t       scale_x;        // logical units to counts, 16.16 fixed-point
+  int32_t       scale_y;
+
+  int32_t       low_x;          // gamepads: stick thresholds
+  int32_t       high_x;
+  int32_t       low_y;
+  int32_t       high_y;
+  uint16_t      pad;            // joypad last posted (active-low)
+};
+
+static input_dev_t input_dev[HID_DEV_SLOTS][CFG_TUH_HID];
+
+// The mice on each port, combined: how many there are, and their buttons
+// (see port_update()); so that a report needn't look at the other devices
+//
+static uint8_t port_mice[MOUSE_PORTS];
+static uint8_t port_buttons[MOUSE_PORTS];
 
 
 // Core functionality
 // ------------------
 static uint8_t const keycode2ascii[128][2] =  { HID_KEYCODE_TO_ASCII };
 
-uint8_t buttons;
-uint8_t local_x;
-uint8_t local_y;
-
-// Each HID instance can has multiple reports
-static struct
-{
-  uint8_t report_count;
-  tuh_hid_report_info_t report_info[MAX_REPORT];
-}hid_info[CFG_TUH_HID];
+int     local_x;
+int     local_y;
 
 static void process_kbd_report(hid_keyboard_report_t const *report);
-static void process_mouse_report(hid_mouse_report_t const * report);
-static void process_generic_report(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len);
 
-extern void __not_in_flash_func(post_globals)(uint8_t buttons, uint8_t delta_x, uint8_t delta_y);
+static void decode_none(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_boot_keyboard(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_boot_mouse(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_keyboard(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_mouse(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_tablet(input_dev_t *dev, uint8_t const *report, uint16_t len);
+static void decode_gamepad(input_dev_t *dev, uint8_t const *report, uint16_t len);
 
 void hid_app_task(void)
 {
   // nothing to do
 }
 
+//--------------------------------------------------------------------+
+// Input devices and ports
+//--------------------------------------------------------------------+
+
+static inline input_dev_t *input_lookup(uint8_t dev_addr, uint8_t instance)
+{
+  if ((dev_addr >= HID_DEV_SLOTS) || (instance >= CFG_TUH_HID))
+    return NULL;
+
+  return &input_dev[dev_addr][instance];
+}
+
+//
+// assign_port - merged: every mouse drives port 0
+//               routed: each new mouse takes the lowest free port
+//                       (sharing port 0 once they are all taken)
+//             - a gamepad takes the lowest port nobody uses (with merged
+//               mice, not port 0), or none (-1)
+//             - with PAD_EMULATION there are no mice (see tuh_hid_mount_cb())
+//
+static int assign_port(bool pointer)
+{
+  bool used[MOUSE_PORTS] = { false };
+  int a, i;
+
+  if (pointer && !mice_routed)
+    return 0;
+
+  for (a = 0; a < HID_DEV_SLOTS; a++)
+    for (i = 0; i < CFG_TUH_HID; i++)
+      if (input_dev[a][i].active)
+        used[input_dev[a][i].port] = true;
+
+  for (i = (!pointer && !mice_routed && (MOUSE_PORTS > 1)) ? 1 : 0; i < MOUSE_PORTS; i++)
+    if (!used[i])
+      return i;
+
+  return pointer ? 0 : -1;
+}
+
+//
+// port_update - recount the mice on a port, and combine their buttons
+//               (active-low, so a button is down if it's down on any of them)
+//             - only when a mouse comes, goes, or changes its buttons
+//
+static void port_update(uint8_t port)
+{
+  uint8_t mice = 0;
+  uint8_t combined = 0x0f;
+  int a, i;
+
+  for (a = 0; a < HID_DEV_SLOTS; a++)
+    for (i = 0; i < CFG_TUH_HID; i++)
+      if (input_dev[a][i].active && input_dev[a][i].pointer && (input_dev[a][i].port == port))
+      {
+        mice++;
+        combined &= input_dev[a][i].buttons;
+      }
+
+  port_mice[port] = mice;
+  port_buttons[port] = combined;
+}
+
+//
+// is_trackball - in the list of known trackballs
+//
+static bool is_trackball(uint8_t dev_addr)
+{
+  uint16_t vid = 0;
+  uint16_t pid = 0;
+  unsigned i;
+
+  if (!tuh_vid_pid_get(dev_addr, &vid, &pid))
+    return false;
+
+  for (i = 0; i < count_of(trackball_ids); i++)
+    if ((trackball_ids[i].vid == vid) && (trackball_ids[i].pid == pid))
+      return true;
+
+  return false;
+}
+
+//
+// tablet_scale - logical units to counts (16.16), so the whole range spans TABLET_SPAN
+//
+static int32_t tablet_scale(hid_field_t const *f)
+{
+  int32_t range = f->lmax - f->lmin;
+
+  return (range > 0) ? (int32_t)(((int64_t)TABLET_SPAN << 16) / range) : 0;
+}
+
+//
+// gamepad_thresholds - where the stick counts as pushed, either side of the centre
+//
+static void gamepad_thresholds(hid_field_t const *f, int32_t *low, int32_t *high)
+{
+  int32_t centre = f->lmin + ((f->lmax - f->lmin) >> 1);
+  int32_t reach = (f->lmax - f->lmin) >> GAMEPAD_THRESHOLD_SHIFT;
+
+  *low = centre - reach;
+  *high = centre + reach;
+}
+
+//
+// choose_decoder - the one decision about how to read this device's reports
+//
+static input_decode_t choose_decoder(input_dev_t *dev, uint8_t dev_addr, uint8_t itf_protocol,
+                                     uint8_t const* desc_report, uint16_t desc_len)
+{
+  const char* kind_str[] = { "nothing usable", "mouse", "tablet", "gamepad", "keyboard" };
+  hid_layout_t *l = &dev->layout;
+
+  dev->accel_kind = is_trackball(dev_addr) ? ACCEL_TRACKBALL : ACCEL_MOUSE;
+
+  // By default the host stack activates the boot protocol on interfaces which support it
+  if (itf_protocol == HID_ITF_PROTOCOL_KEYBOARD)
+    return decode_boot_keyboard;
+
+  if (itf_protocol == HID_ITF_PROTOCOL_MOUSE)
+  {
+    dev->pointer = true;
+    return decode_boot_mouse;
+  }
+
+  // otherwise the report descriptor says what it is
+  hid_layout_parse(l, desc_report, desc_len);
+  printf("HID report descriptor: %s\r\n", kind_str[l->kind]);
+
+  switch (l->kind)
+  {
+    case HID_KIND_MOUSE:
+      dev->pointer = true;
+      return decode_mouse;
+
+    case HID_KIND_TABLET:
+      dev->pointer = true;
+      dev->scale_x = tablet_scale(&l->x);
+      dev->scale_y = tablet_scale(&l->y);
+      return decode_tablet;
+
+    case HID_KIND_GAMEPAD:
+      gamepad_thresholds(&l->x, &dev->low_x, &dev->high_x);
+      gamepad_thresholds(&l->y, &dev->low_y, &dev->high_y);
+      dev->pad = PAD_RELEASED;
+      return decode_gamepad;
+
+    case HID_KIND_KEYBOARD:
+      return decode_keyboard;
+
+    default:
+      return decode_none;
+  }
+}
+
 //--------------------------------------------------------------------+
 // TinyUSB Callbacks
 //--------------------------------------------------------------------+
 
 // Invoked when device with hid interface is mounted
-// Report descriptor is also available for use. tuh_hid_parse_report_descriptor()
-// can be used to parse common/simple enough descriptor.
+// Report descriptor is also available for use; it is parsed here (once) to
+// find the device's fields, unless the boot protocol is in use.
 // Note: if report descriptor length > CFG_TUH_ENUMERATION_BUFSIZE, it will be skipped
 // therefore report_desc = NULL, desc_len = 0
 void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len)
 {
+  input_dev_t *dev = input_lookup(dev_addr, instance);
+
   printf("HID device address = %d, instance = %d is mounted\r\n", dev_addr, instance);
 
+  if (dev == NULL)
+  {
+    printf("Error: no room for this device\r\n");
+    return;
+  }
+
+  // a device is only given a port by its first report
+  memset(dev, 0, sizeof(input_dev_t));
+
   // Interface protocol (hid_interface_protocol_enum_t)
   const char* protocol_str[] = { "None", "Keyboard", "Mouse" };
   uint8_t const itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
 
   printf("HID Interface Protocol = %s\r\n", protocol_str[itf_protocol]);
 
-  // By default host stack will use activate boot protocol on supported interface.
-  // Therefore for this simple example, we only need to parse generic report descriptor (with built-in parser)
-  if ( itf_protocol == HID_ITF_PROTOCOL_NONE )
+  dev->decode = choose_decoder(dev, dev_addr, itf_protocol, desc_report, desc_len);
+
+#ifdef PAD_EMULATION
+  // the only port is a joypad, which a pointing device can't drive; it mustn't
+  // take the port ahead of a gamepad either (e.g. a receiver's mouse interface)
+  if (dev->pointer)
   {
-    hid_info[instance].report_count = tuh_hid_parse_report_descriptor(hid_info[instance].report_info, MAX_REPORT, desc_report, desc_len);
-    printf("HID has %u reports \r\n", hid_info[instance].report_count);
+    printf("Pointing device ignored (joypad emulation)\r\n");
+    dev->pointer = false;
+    dev->decode = decode_none;
   }
+#endif
 
   // request to receive report
   // tuh_hid_report_received_cb() will be invoked when report is available
@@ -148,36 +399,48 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_re
 // Invoked when device with hid interface is un-mounted
 void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance)
 {
+  input_dev_t *dev = input_lookup(dev_addr, instance);
+
   printf("HID device address = %d, instance = %d is unmounted\r\n", dev_addr, instance);
+
+  if (dev == NULL)
+    return;
+
+  dev->decode = decode_none;
+
+  // release its buttons, and its port
+  if (dev->active)
+  {
+    dev->active = false;
+
+    if (!dev->pointer)
+    {
+      post_pad(dev->port, PAD_RELEASED);
+      port_release(dev->port);
+    }
+    else
+    {
+      port_update(dev->port);
+      if (port_mice[dev->port])
+        post_buttons(dev->port, port_buttons[dev->port]);
+      else
+        port_release(dev->port);
+    }
+  }
 }
 
 // Invoked when received report from device via interrupt endpoint
 void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
 {
-  uint8_t const itf_protocol = tuh_hid_interface_protocol(dev_addr, instance);
+  input_dev_t *dev = input_lookup(dev_addr, instance);
 
-  switch (itf_protocol)
-  {
-    case HID_ITF_PROTOCOL_KEYBOARD:
-      TU_LOG2("HID receive boot keyboard report\r\n");
-      process_kbd_report( (hid_keyboard_report_t const*) report );
-    break;
-
-    case HID_ITF_PROTOCOL_MOUSE:
-      TU_LOG2("HID receive boot mouse report\r\n");
-      process_mouse_report( (hid_mouse_report_t const*) report );
-    break;
-
-    default:
-      // Generic report requires matching ReportID and contents with previous parsed report info
-      process_generic_report(dev_addr, instance, report, len);
-    break;
-  }
+  if (dev && dev->decode)
+    dev->decode(dev, report, len);
 
   // continue to request to receive report
   if ( !tuh_hid_receive_report(dev_addr, instance) )
   {
-    printf("Error: cannot request to receive report\r\n");
+    dlog("Error: cannot request to receive report\r\n");
   }
 }
 
@@ -213,10 +476,8 @@ static void process_kbd_report(hid_keyboard_report_t const *report)
         // not existed in previous report means the current key is pressed
         bool const is_shift = report->modifier & (KEYBOARD_MODIFIER_LEFTSHIFT | KEYBOARD_MODIFIER_RIGHTSHIFT);
         uint8_t ch = keycode2ascii[report->keycode[i]][is_shift ? 1 : 0];
-        putchar(ch);
-        if ( ch == '\r' ) putchar('\n'); // added new line for enter key
-
-        fflush(stdout); // flush right away, else nanolib will wait for newline
+        dlog1("%c", ch);
+        if ( ch == '\r' ) dlog("\n"); // added new line for enter key
       }
     }
     // TODO example skips key released
@@ -225,6 +486,45 @@ static void process_kbd_report(hid_keyboard_report_t const *report)
   prev_report = *report;
 }
 
+//
+// report_data - skip the report ID (if the device uses them), and
+//               ignore reports other than the one with our fields
+//
+static inline bool report_data(hid_layout_t const *l, uint8_t const **report, uint16_t *len)
+{
+  if (l->report_id == 0)
+    return true;
+
+  if ((*len == 0) || ((*report)[0] != l->report_id))
+    return false;
+
+  (*report)++;
+  (*len)--;
+  return true;
+}
+
+static void decode_none(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  (void)dev;
+  (void)report;
+  (void)len;
+}
+
+static void decode_boot_keyboard(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  (void)dev;
+
+  if (len >= sizeof(hid_keyboard_report_t))
+    process_kbd_report( (hid_keyboard_report_t const*) report );
+}
+
+static void decode_keyboard(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  // Assume keyboard follow boot report layout
+  if (report_data(&dev->layout, &report, &len) && (len >= sizeof(hid_keyboard_report_t)))
+    process_kbd_report( (hid_keyboard_report_t const*) report );
+}
+
 //--------------------------------------------------------------------+
 // Mouse
 //--------------------------------------------------------------------+
@@ -238,168 +538,262 @@ uint8_t x1, y1;
   // Move X using ansi escape
   if ( x < 0)
   {
-    printf(ANSI_CURSOR_BACKWARD(%d), (-x)); // move left
+    dlog1(ANSI_CURSOR_BACKWARD(%d), (-x)); // move left
   }else if ( x > 0)
   {
-    printf(ANSI_CURSOR_FORWARD(%d), x); // move right
+    dlog1(ANSI_CURSOR_FORWARD(%d), x); // move right
   }
 
   // Move Y using ansi escape
   if ( y < 0)
   {
-    printf(ANSI_CURSOR_UP(%d), (-y)); // move up
+    dlog1(ANSI_CURSOR_UP(%d), (-y)); // move up
   }else if ( y > 0)
   {
-    printf(ANSI_CURSOR_DOWN(%d), y); // move down
+    dlog1(ANSI_CURSOR_DOWN(%d), y); // move down
   }
 
   // Scroll using ansi escape
   if (wheel < 0)
   {
-    printf(ANSI_SCROLL_UP(%d), (-wheel)); // scroll up
+    dlog1(ANSI_SCROLL_UP(%d), (-wheel)); // scroll up
   }else if (wheel > 0)
   {
-    printf(ANSI_SCROLL_DOWN(%d), wheel); // scroll down
+    dlog1(ANSI_SCROLL_DOWN(%d), wheel); // scroll down
   }
 
-  printf("\r\n");
+  dlog("\r\n");
 #else
-  printf("(%d %d %d)\r\n", x, y, wheel);
+  dlog3("(%d %d %d)\r\n", x, y, wheel);
 #endif
 }
 
-static void process_mouse_report(hid_mouse_report_t const * report)
+//
+// mouse_buttons - a pointing device's buttons, in PCE order (and takes its port)
+//
+static void mouse_buttons(input_dev_t *dev, uint8_t usb_buttons)
 {
-  static hid_mouse_report_t prev_report = { 0 };
-
-  static bool previous_middle_button = false;
+  bool joined = false;
+  uint8_t buttons;
 
-  int local_x_temp;
-  int local_y_temp;
+  if (!dev->active)
+  {
+    dev->port = assign_port(true);
+    dev->active = true;
+    dev->buttons = 0x0f;
+    joined = true;
+    dlog1("Mouse on port %d\r\n", dev->port + 1);
+  }
 
   //------------- button state  -------------//
-  uint8_t button_changed_mask = report->buttons ^ prev_report.buttons;
-  if ( button_changed_mask & report->buttons)
+  uint8_t button_changed_mask = usb_buttons ^ dev->usb_buttons;
+  if ( button_changed_mask & usb_buttons)
   {
-    printf(" %c%c%c%c%c ",
-       report->buttons & MOUSE_BUTTON_BACKWARD  ? 'R' : '-',
-       report->buttons & MOUSE_BUTTON_FORWARD   ? 'S' : '-',
-       report->buttons & MOUSE_BUTTON_LEFT      ? '2' : '-',
-       report->buttons & MOUSE_BUTTON_MIDDLE    ? 'M' : '-',
-       report->buttons & MOUSE_BUTTON_RIGHT     ? '1' : '-');
-
-    if (buttons_swappable && (report->buttons & MOUSE_BUTTON_MIDDLE) &&
-        (previous_middle_button == false))
-       buttons_swapped = (buttons_swapped ? false : true);
-
-    previous_middle_button = (report->buttons & MOUSE_BUTTON_MIDDLE);
+    dlog5(" %c%c%c%c%c ",
+       usb_buttons & MOUSE_BUTTON_BACKWARD  ? 'R' : '-',
+       usb_buttons & MOUSE_BUTTON_FORWARD   ? 'S' : '-',
+       usb_buttons & MOUSE_BUTTON_LEFT      ? '2' : '-',
+       usb_buttons & MOUSE_BUTTON_MIDDLE    ? 'M' : '-',
+       usb_buttons & MOUSE_BUTTON_RIGHT     ? '1' : '-');
+
+    if (settings_run->mid_swap && (button_changed_mask & usb_buttons & MOUSE_BUTTON_MIDDLE))
+       dev->swapped = (dev->swapped ? false : true);
   }
+  dev->usb_buttons = usb_buttons;
+
+  // one lookup, through the current profile's button map
+  buttons = settings_run->mouse_buttons[dev->swapped][usb_buttons & ((1 << SETTINGS_USB_BUTTONS) - 1)];
 
-  if (buttons_swapped)
+  if (joined || (buttons != dev->buttons))
   {
-     buttons = (((report->buttons & MOUSE_BUTTON_BACKWARD) ? 0x00 : 0x08) |
-                ((report->buttons & MOUSE_BUTTON_FORWARD ) ? 0x00 : 0x04) |
-                ((report->buttons & MOUSE_BUTTON_RIGHT)    ? 0x00 : 0x02) |
-                ((report->buttons & MOUSE_BUTTON_LEFT)     ? 0x00 : 0x01));
+    dev->buttons = buttons;
+    port_update(dev->port);
   }
-  else
+}
+
+//
+// mouse_motion - one report from a mouse or trackball (USB directions)
+//
+static void mouse_motion(input_dev_t *dev, uint8_t usb_buttons, int x, int y, int wheel)
+{
+  accel_kind_t kind = dev->accel_kind;
+
+  mouse_buttons(dev, usb_buttons);
+
+  if (wheel && settings_run->wheel_curve)
   {
-     buttons = (((report->buttons & MOUSE_BUTTON_BACKWARD) ? 0x00 : 0x08) |
-                ((report->buttons & MOUSE_BUTTON_FORWARD ) ? 0x00 : 0x04) |
-                ((report->buttons & MOUSE_BUTTON_LEFT)     ? 0x00 : 0x02) |
-                ((report->buttons & MOUSE_BUTTON_RIGHT)    ? 0x00 : 0x01));
+     if ((wheel < 0) && (accel_selected(kind) > 0))
+        settings_set_curve(kind, accel_selected(kind) - 1);
+     else if ((wheel > 0) && (accel_selected(kind) < (accel_curve_count - 1)))
+        settings_set_curve(kind, accel_selected(kind) + 1);
   }
 
-  if (sensitivity_adjustable)
+  // scale through the active curve (table lookup, no division)
+  accel_apply(&dev->accel, kind, (0 - x), (0 - y), &local_x, &local_y);
+
+
+  // add to the port's accumulator and post to the state machine
+  // if a scan from the host machine is ongoing, wait
+  post_globals(dev->port, port_buttons[dev->port], local_x, local_y);
+
+  //------------- cursor movement -------------//
+  cursor_movement(x, y, wheel);
+}
+
+static void decode_boot_mouse(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  hid_mouse_report_t const *r = (hid_mouse_report_t const *)report;
+
+  if (len < 3)
+    return;
+
+  mouse_motion(dev, r->buttons, r->x, r->y, (len > 3) ? r->wheel : 0);
+}
+
+//
+// decode_mouse - a mouse (or trackball) with its own report layout
+//                (often wider than the boot report's 8 bits per axis)
+//
+static void decode_mouse(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  hid_layout_t const *l = &dev->layout;
+  int32_t x, y;
+
+  if (!report_data(l, &report, &len))
+    return;
+
+  x = hid_field_get(&l->x, report, len);
+  y = hid_field_get(&l->y, report, len);
+
+  // bounded so that the scaled motion still fits post_globals()
+  x = (x > MOUSE_DELTA_MAX) ? MOUSE_DELTA_MAX : (x < -MOUSE_DELTA_MAX) ? -MOUSE_DELTA_MAX : x;
+  y = (y > MOUSE_DELTA_MAX) ? MOUSE_DELTA_MAX : (y < -MOUSE_DELTA_MAX) ? -MOUSE_DELTA_MAX : y;
+
+  mouse_motion(dev, hid_field_get(&l->buttons, report, len), x, y,
+               hid_field_get(&l->wheel, report, len));
+}
+
+//
+// decode_tablet - absolute positions become relative motion, one to one,
+//                 while the pen is in range (or the finger is down)
+//
+static void decode_tablet(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  hid_layout_t const *l = &dev->layout;
+  uint8_t usb_buttons;
+  int32_t ax, ay;
+  int32_t x, y;
+  bool tracking;
+
+  if (!report_data(l, &report, &len))
+    return;
+
+  usb_buttons = hid_field_get(&l->buttons, report, len);
+
+  if (l->in_range.size)
   {
-     if ((report->wheel < 0) && (sensitivity_level > 0))
-        sensitivity_level--;
-     else if ((report->wheel > 0) && (sensitivity_level < 2))
-        sensitivity_level++;
+    tracking = hid_field_get(&l->in_range, report, len);
+    if (hid_field_get(&l->tip, report, len))
+      usb_buttons |= MOUSE_BUTTON_LEFT;
+    if (hid_field_get(&l->barrel, report, len))
+      usb_buttons |= MOUSE_BUTTON_RIGHT;
   }
-     
-  local_x_temp = ((0 - report->x) * sensitivity_multiplier[sensitivity_level]) + sens_remainder_x;
-  local_y_temp = ((0 - report->y) * sensitivity_multiplier[sensitivity_level]) + sens_remainder_y;
+  else if (l->tip.size)
+    tracking = hid_field_get(&l->tip, report, len);
+  else
+    tracking = true;
 
-  local_x = local_x_temp / sensitivity_divider;
-  local_y = local_y_temp / sensitivity_divider;
+  ax = hid_field_get(&l->x, report, len);
+  ay = hid_field_get(&l->y, report, len);
+  ax = (ax < l->x.lmin) ? l->x.lmin : (ax > l->x.lmax) ? l->x.lmax : ax;
+  ay = (ay < l->y.lmin) ? l->y.lmin : (ay > l->y.lmax) ? l->y.lmax : ay;
 
-  sens_remainder_x = local_x_temp % sensitivity_divider;
-  sens_remainder_y = local_y_temp % sensitivity_divider;
+  // position in counts; differences of these never drift
+  x = ((ax - l->x.lmin) * dev->scale_x) >> 16;
+  y = ((ay - l->y.lmin) * dev->scale_y) >> 16;
 
+  mouse_buttons(dev, usb_buttons);
 
-  // add to accumulator and post to the state machine
-  // if a scan from the host machine is ongoing, wait
-  post_globals(buttons, local_x, local_y);
+  // no jump when the pen comes back into range somewhere else
+  // (and no report of motion at all while it's out of range)
+  if (tracking && dev->tracking)
+    post_globals(dev->port, port_buttons[dev->port], dev->tablet_x - x, dev->tablet_y - y);
+  else
+    post_buttons(dev->port, port_buttons[dev->port]);
 
-  //------------- cursor movement -------------//
-  cursor_movement(report->x, report->y, report->wheel);
+  dev->tracking = tracking;
+  dev->tablet_x = x;
+  dev->tablet_y = y;
 }
 
 //--------------------------------------------------------------------+
-// Generic Report
+// Gamepad
 //--------------------------------------------------------------------+
-static void process_generic_report(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
-{
-  (void) dev_addr;
 
-  uint8_t const rpt_count = hid_info[instance].report_count;
-  tuh_hid_report_info_t* rpt_info_arr = hid_info[instance].report_info;
-  tuh_hid_report_info_t* rpt_info = NULL;
+// Hat switch positions (0 = up, clockwise) as joypad directions
+//
+static const uint8_t hat_directions[8] =
+{
+  PAD_UP,  PAD_UP | PAD_RIGHT,  PAD_RIGHT,  PAD_DOWN | PAD_RIGHT,
+  PAD_DOWN, PAD_DOWN | PAD_LEFT, PAD_LEFT,  PAD_UP | PAD_LEFT
+};
+
+//
+// decode_gamepad - hat and stick to directions, and its buttons,
+//                  onto the port's joypad
+//
+static void decode_gamepad(input_dev_t *dev, uint8_t const *report, uint16_t len)
+{
+  hid_layout_t const *l = &dev->layout;
+  uint16_t pressed = 0;
+  uint32_t const *pad_mask = settings_run->pad_mask;
+  uint32_t buttons;
+  int32_t v;
+  int i;
+
+  if (!report_data(l, &report, &len))
+    return;
 
-  if ( rpt_count == 1 && rpt_info_arr[0].report_id == 0)
-  {
-    // Simple report without report ID as 1st byte
-    rpt_info = &rpt_info_arr[0];
-  }else
+  if (!dev->active)
   {
-    // Composite report, 1st byte is report ID, data starts from 2nd byte
-    uint8_t const rpt_id = report[0];
+    v = assign_port(false);
+    if (v < 0)
+      return;
 
-    // Find report id in the arrray
-    for(uint8_t i=0; i<rpt_count; i++)
-    {
-      if (rpt_id == rpt_info_arr[i].report_id )
-      {
-        rpt_info = &rpt_info_arr[i];
-        break;
-      }
-    }
+    dev->port = v;
+    dev->active = true;
+    dlog1("Gamepad on port %d\r\n", dev->port + 1);
+  }
 
-    report++;
-    len--;
+  // hat values outside of 8 positions mean "centred"
+  if (l->hat.size)
+  {
+    v = hid_field_get(&l->hat, report, len) - l->hat.lmin;
+    if ((v >= 0) && (v < 8))
+      pressed |= hat_directions[v];
   }
 
-  if (!rpt_info)
+  if (l->x.size)
   {
-    printf("Couldn't find the report info for this report !\r\n");
-    return;
+    v = hid_field_get(&l->x, report, len);
+    pressed |= (v < dev->low_x) ? PAD_LEFT : (v > dev->high_x) ? PAD_RIGHT : 0;
   }
 
-  // For complete list of Usage Page & Usage checkout src/class/hid/hid.h. For examples:
-  // - Keyboard                     : Desktop, Keyboard
-  // - Mouse                        : Desktop, Mouse
-  // - Gamepad                      : Desktop, Gamepad
-  // - Consumer Control (Media Key) : Consumer, Consumer Control
-  // - System Control (Power key)   : Desktop, System Control
-  // - Generic (vendor)             : 0xFFxx, xx
-  if ( rpt_info->usage_page == HID_USAGE_PAGE_DESKTOP )
+  if (l->y.size)
   {
-    switch (rpt_info->usage)
-    {
-      case HID_USAGE_DESKTOP_KEYBOARD:
-        TU_LOG1("HID receive keyboard report\r\n");
-        // Assume keyboard follow boot report layout
-        process_kbd_report( (hid_keyboard_report_t const*) report );
-      break;
-
-      case HID_USAGE_DESKTOP_MOUSE:
-        TU_LOG1("HID receive mouse report\r\n");
-        // Assume mouse follow boot report layout
-        process_mouse_report( (hid_mouse_report_t const*) report );
-      break;
-
-      default: break;
-    }
+    v = hid_field_get(&l->y, report, len);
+    pressed |= (v < dev->low_y) ? PAD_UP : (v > dev->high_y) ? PAD_DOWN : 0;
+  }
+
+  buttons = hid_field_get(&l->buttons, report, len);
+  for (i = 0; i < PAD_BUTTONS; i++)
+    if (buttons & pad_mask[i])
+      pressed |= pad_bits[i];
+
+  if ((uint16_t)~pressed != dev->pad)
+  {
+    dev->pad = ~pressed;
+    post_pad(dev->port, dev->pad);
+    dlog2("Gamepad %d: %03x\r\n", dev->port + 1, pressed);
   }
 }
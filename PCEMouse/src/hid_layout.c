@@ -0,0 +1,281 @@
+/*
+ * hid_layout.c - where the fields are in a HID device's reports, found
+ *                once from its report descriptor (at mount)
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <string.h>
+
+#include "hid_layout.h"
+
+// Usage pages and usages (HID Usage Tables)
+//
+#define PAGE_DESKTOP        0x01
+#define PAGE_BUTTON         0x09
+#define PAGE_DIGITIZER      0x0d
+
+#define DESKTOP_POINTER     0x01
+#define DESKTOP_MOUSE       0x02
+#define DESKTOP_JOYSTICK    0x04
+#define DESKTOP_GAMEPAD     0x05
+#define DESKTOP_KEYBOARD    0x06
+#define DESKTOP_X           0x30
+#define DESKTOP_Y           0x31
+#define DESKTOP_WHEEL       0x38
+#define DESKTOP_HAT         0x39
+
+#define DIGITIZER_DIGITIZER 0x01
+#define DIGITIZER_PEN       0x02
+#define DIGITIZER_TOUCH     0x04
+#define DIGITIZER_TOUCHPAD  0x05
+#define DIGITIZER_IN_RANGE  0x32
+#define DIGITIZER_TIP       0x42
+#define DIGITIZER_BARREL    0x44
+
+#define USAGE(page, id)     (((uint32_t)(page) << 16) | (id))
+
+// Main item flags
+//
+#define ITEM_CONSTANT       0x01
+#define ITEM_VARIABLE       0x02
+#define ITEM_RELATIVE       0x04
+
+#define MAX_USAGES          16
+#define MAX_GLOBAL_STACK    4
+
+typedef struct
+{
+  uint16_t page;
+  int32_t  lmin;
+  int32_t  lmax;
+  uint8_t  size;
+  uint8_t  count;
+  uint8_t  id;
+} globals_t;
+
+
+static uint8_t kind_of(uint32_t usage)
+{
+  switch (usage)
+  {
+    case USAGE(PAGE_DESKTOP, DESKTOP_POINTER):
+    case USAGE(PAGE_DESKTOP, DESKTOP_MOUSE):        return HID_KIND_MOUSE;
+    case USAGE(PAGE_DESKTOP, DESKTOP_JOYSTICK):
+    case USAGE(PAGE_DESKTOP, DESKTOP_GAMEPAD):      return HID_KIND_GAMEPAD;
+    case USAGE(PAGE_DESKTOP, DESKTOP_KEYBOARD):     return HID_KIND_KEYBOARD;
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_DIGITIZER):
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_PEN):
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_TOUCH):
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_TOUCHPAD): return HID_KIND_TABLET;
+    default:                                        return HID_KIND_NONE;
+  }
+}
+
+static void set_field(hid_field_t *f, uint16_t bit, globals_t const *g)
+{
+  if (f->size)
+    return;   // the first one wins (e.g. the first finger of a touch screen)
+
+  f->bit = bit;
+  f->size = (g->size > 32) ? 32 : g->size;
+  f->is_signed = (g->lmin < 0);
+  f->lmin = g->lmin;
+  f->lmax = g->lmax;
+}
+
+//
+// record - one field of an input item, if it's one we use
+//
+static void record(hid_layout_t *l, uint32_t usage, uint16_t bit, uint8_t flags, globals_t const *g)
+{
+  switch (usage)
+  {
+    case USAGE(PAGE_DESKTOP, DESKTOP_X):
+      if (l->x.size == 0)
+        l->relative = (flags & ITEM_RELATIVE) != 0;
+      set_field(&l->x, bit, g);
+      break;
+    case USAGE(PAGE_DESKTOP, DESKTOP_Y):        set_field(&l->y, bit, g);        break;
+    case USAGE(PAGE_DESKTOP, DESKTOP_WHEEL):    set_field(&l->wheel, bit, g);    break;
+    case USAGE(PAGE_DESKTOP, DESKTOP_HAT):      set_field(&l->hat, bit, g);      break;
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_TIP):  set_field(&l->tip, bit, g);      break;
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_IN_RANGE): set_field(&l->in_range, bit, g); break;
+    case USAGE(PAGE_DIGITIZER, DIGITIZER_BARREL):   set_field(&l->barrel, bit, g);   break;
+    default:
+      // buttons are taken as one field, as long as they are in sequence
+      if ((usage >> 16) == PAGE_BUTTON)
+      {
+        uint16_t n = usage & 0xffff;
+
+        if ((n == 1) && (l->buttons.size == 0) && (g->size == 1))
+        {
+          l->buttons.bit = bit;
+          l->buttons.size = 1;
+        }
+        else if ((n == l->buttons.size + 1) && (bit == l->buttons.bit + l->buttons.size) &&
+                 (l->buttons.size > 0) && (l->buttons.size < 32))
+          l->buttons.size++;
+      }
+      break;
+  }
+}
+
+//
+// hid_layout_parse - find the device kind, and its fields (not on the hot path)
+//
+void hid_layout_parse(hid_layout_t *layout, uint8_t const *desc, uint16_t desc_len)
+{
+  globals_t g;
+  globals_t stack[MAX_GLOBAL_STACK];
+  int       sp = 0;
+  uint32_t  usages[MAX_USAGES];
+  int       usage_count = 0;
+  uint32_t  usage_min = 0;
+  uint32_t  usage_max = 0;
+  uint16_t  bits[256];            // bit offset reached so far, per report ID
+  int       depth = 0;
+  bool      in_app = false;       // inside the chosen application collection
+  bool      id_known = false;
+
+  memset(layout, 0, sizeof(hid_layout_t));
+  memset(&g, 0, sizeof(g));
+  memset(bits, 0, sizeof(bits));
+
+  while (desc_len > 0)
+  {
+    uint8_t  prefix = *desc;
+    uint8_t  size = prefix & 3;
+    uint8_t  type = (prefix >> 2) & 3;
+    uint8_t  tag = prefix >> 4;
+    uint32_t data = 0;
+    int32_t  sdata;
+    int      i;
+
+    if (size == 3)
+      size = 4;
+
+    // long items carry nothing we need
+    if (prefix == 0xfe)
+    {
+      size = (desc_len > 1) ? (desc[1] + 2) : 0;
+      if (size + 1 > desc_len)
+        break;
+      desc += size + 1;
+      desc_len -= size + 1;
+      continue;
+    }
+
+    if (size + 1 > desc_len)
+      break;
+
+    for (i = size; i > 0; i--)
+      data = (data << 8) | desc[i];
+
+    sdata = (size == 1) ? (int8_t)data : (size == 2) ? (int16_t)data : (int32_t)data;
+
+    desc += size + 1;
+    desc_len -= size + 1;
+
+    if (type == 0)              // Main
+    {
+      switch (tag)
+      {
+        case 0x8:               // Input
+          if (in_app && (!id_known || (g.id == layout->report_id)))
+          {
+            for (i = 0; i < g.count; i++)
+            {
+              uint32_t usage;
+
+              if (usage_count > 0)
+                usage = usages[(i < usage_count) ? i : (usage_count - 1)];
+              else if (usage_max >= usage_min)
+                usage = ((usage_min + i) > usage_max) ? usage_max : (usage_min + i);
+              else
+                usage = 0;
+
+              if (!(data & ITEM_CONSTANT) && (data & ITEM_VARIABLE) && usage)
+              {
+                if (!id_known)
+                {
+                  layout->report_id = g.id;
+                  id_known = true;
+                }
+                record(layout, usage, bits[g.id] + (i * g.size), data, &g);
+              }
+            }
+          }
+          bits[g.id] += g.size * g.count;
+          break;
+
+        case 0xa:               // Collection
+          if ((depth == 0) && (data == 0x01) && (layout->kind == HID_KIND_NONE) && (usage_count > 0))
+          {
+            layout->kind = kind_of(usages[0]);
+            in_app = (layout->kind != HID_KIND_NONE);
+          }
+          depth++;
+          break;
+
+        case 0xc:               // End Collection
+          if (depth > 0)
+            depth--;
+          if (depth == 0)
+            in_app = false;
+          break;
+
+        default:
+          break;
+      }
+
+      usage_count = 0;
+      usage_min = 1;
+      usage_max = 0;
+    }
+    else if (type == 1)         // Global
+    {
+      switch (tag)
+      {
+        case 0x0: g.page = data; break;
+        case 0x1: g.lmin = sdata; break;
+        case 0x2: g.lmax = sdata; break;
+        case 0x7: g.size = data; break;
+        case 0x8: g.id = data; break;
+        case 0x9: g.count = data; break;
+        case 0xa: if (sp < MAX_GLOBAL_STACK) stack[sp++] = g; break;
+        case 0xb: if (sp > 0) g = stack[--sp]; break;
+        default: break;
+      }
+
+      // a maximum which only fits unsigned (e.g. 0..255 in one byte)
+      if ((tag == 0x2) && (g.lmax < g.lmin))
+        g.lmax = data;
+    }
+    else if (type == 2)         // Local
+    {
+      uint32_t usage = (size == 4) ? data : USAGE(g.page, data);
+
+      switch (tag)
+      {
+        case 0x0:
+          if (usage_count < MAX_USAGES)
+            usages[usage_count++] = usage;
+          break;
+        case 0x1: usage_min = usage; break;
+        case 0x2: usage_max = usage; break;
+        default: break;
+      }
+    }
+  }
+
+  // a pointer without relative X/Y is a tablet (e.g. an absolute pointer)
+  if ((layout->kind == HID_KIND_MOUSE) && layout->x.size && !layout->relative)
+    layout->kind = HID_KIND_TABLET;
+
+  // nothing usable was found
+  if ((layout->kind == HID_KIND_MOUSE || layout->kind == HID_KIND_TABLET) &&
+      ((layout->x.size == 0) || (layout->y.size == 0)))
+    layout->kind = HID_KIND_NONE;
+}
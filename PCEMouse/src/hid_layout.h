@@ -0,0 +1,82 @@
+/*
+ * hid_layout.h - where the fields are in a HID device's reports, found
+ *                once from its report descriptor (at mount)
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _HID_LAYOUT_H_
+#define _HID_LAYOUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//--------------------------------------------------------------------+
+// The report descriptor is walked once, when the device is mounted;
+// the first application collection which we know how to use (mouse,
+// tablet/digitizer, gamepad/joystick, keyboard) decides the kind of
+// device, and the position of each field we need is recorded. After
+// that, getting a value out of a report is just a shift and a mask.
+//--------------------------------------------------------------------+
+
+enum
+{
+  HID_KIND_NONE = 0,
+  HID_KIND_MOUSE,             // relative X/Y (mice, trackballs)
+  HID_KIND_TABLET,            // absolute X/Y (tablets, pens, touch, absolute pointers)
+  HID_KIND_GAMEPAD,           // gamepads and joysticks
+  HID_KIND_KEYBOARD
+};
+
+typedef struct
+{
+  uint16_t bit;               // offset from the start of the report's data
+  uint8_t  size;              // in bits (0 = not present)
+  bool     is_signed;
+  int32_t  lmin;              // logical range
+  int32_t  lmax;
+} hid_field_t;
+
+typedef struct
+{
+  uint8_t     kind;
+  uint8_t     report_id;      // 0 = reports have no ID byte
+  bool        relative;       // X/Y are relative
+  hid_field_t x;
+  hid_field_t y;
+  hid_field_t wheel;
+  hid_field_t hat;
+  hid_field_t buttons;        // button 1 upwards, one bit each (size = count)
+  hid_field_t tip;            // digitizers
+  hid_field_t in_range;
+  hid_field_t barrel;
+} hid_layout_t;
+
+void hid_layout_parse(hid_layout_t *layout, uint8_t const *desc, uint16_t desc_len);
+
+//
+// hid_field_get - one field's value from a report (0 if absent, or beyond the report)
+//
+static inline int32_t hid_field_get(hid_field_t const *f, uint8_t const *data, uint16_t len)
+{
+  uint32_t first = f->bit >> 3;
+  uint32_t last = (f->bit + f->size - 1) >> 3;
+  uint64_t v = 0;
+  uint32_t i;
+
+  if ((f->size == 0) || (last >= len))
+    return 0;
+
+  for (i = last + 1; i > first; i--)
+    v = (v << 8) | data[i - 1];
+
+  v = (v >> (f->bit & 7)) & ((1ull << f->size) - 1);
+
+  if (f->is_signed && (v & (1ull << (f->size - 1))))
+    return (int32_t)(v - (1ull << f->size));
+
+  return (int32_t)v;
+}
+
+#endif /* _HID_LAYOUT_H_ */
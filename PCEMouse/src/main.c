@@ -46,8 +46,18 @@
 #include "pico/time.h"
 #include "pico/multicore.h"
 #include "hardware/pio.h"
+#include "hardware/sync.h"
 #include "plex.pio.h"
 #include "clock.pio.h"
+#include "tap.pio.h"
+#include "pad.pio.h"
+
+#include "accel.h"
+#include "scansync.h"
+#include "settings.h"
+#include "telemetry.h"
+#include "dlog.h"
+#include "pcemouse.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
@@ -96,20 +106,61 @@
 #endif
 #endif
 
+// Uncomment the following line to latch just ahead of the console's (learned)
+// scan time, rather than as each report arrives.  By itself this gains nothing
+// (each report is sent as soon as it arrives either way), and a read which comes
+// earlier than predicted gets the packet from the previous frame:
+// #define FRAME_SYNC_LATCH  true
+
+// Uncomment the following line to extrapolate motion up to the predicted scan
+// (only for the part of a report interval between the last report and the scan;
+// implies FRAME_SYNC_LATCH):
+// #define FRAME_SYNC_EXTRAPOLATE  true
+
 void print_greeting(void);
 void led_blinking_task(void);
+void console_task(void);
 
 extern void cdc_task(void);
 extern void hid_app_task(void);
 
-int16_t  global_x = 0;
-int16_t  global_y = 0;
-uint8_t  global_buttons = 0x0F;
+// Limit on how much motion may be carried forward; beyond this (e.g. the
+// PCE isn't scanning at all), motion is dropped rather than replayed late
+//
+#define MOTION_CARRY_LIMIT  2048
+
+uint32_t motion_clipped = 0;    // scans where pending motion exceeded one scan's range
+uint32_t motion_dropped = 0;    // reports where the carry limit was exceeded
+
+
+// Frame-aligned latching
+// ----------------------
+#if defined(FRAME_SYNC_LATCH) || defined(FRAME_SYNC_EXTRAPOLATE)
+bool frame_sync = true;
+#else
+bool frame_sync = false;
+#endif
+
+#ifdef FRAME_SYNC_EXTRAPOLATE
+bool frame_extrapolate = true;
+#else
+bool frame_extrapolate = false;
+#endif
+
+#define REPORT_INTERVAL_MAX  20000         // longest gap counted as continuous motion
+
+static bool     frame_latched = false;      // the pre-scan latch for this frame has been done
 
 // When PCE reads, set interlock to ensure atomic update
 //
 volatile bool  output_exclude = false;
 
+#if !defined(PAD_EMULATION)
+// Set by core 0 after a flash write; core 1 starts again from the top of a scan
+//
+static volatile bool scan_restart = false;
+#endif
+
 
 // output_word -> is the word sent to the state machine for output
 //
@@ -122,21 +173,78 @@ volatile bool  output_exclude = false;
 //  - x = mouse 'x' movement; left is {1 - 0x7F} ; right is {0xFF - 0x80 }
 //  - y = mouse 'y' movement;  up  is {1 - 0x7F} ; down  is {0xFF - 0x80 }
 //
-uint32_t output_word = 0;
-
-int16_t  output_x = 0;
-int16_t  output_y = 0;
-uint8_t  output_buttons = 0x0F;
+// With MULTITAP_EMULATION, each port's output_word is reduced to one byte
+// (the nybble for its current state, and its buttons), and the bytes for
+// all ports are sent together to the tap program (see tap.pio).
+//
+#define OUTPUT_STATE_SHIFT  20
+#define OUTPUT_STATE_MASK   (3 << OUTPUT_STATE_SHIFT)
 
-int state = 3;          // countdown sequence for shift-register position
+// State for each emulated port
+//
+// Motion is kept as running totals, each written by only one core:
+//  - global_x/y   : all motion posted from USB reports (core 0)
+//  - consumed_x/y : all motion actually delivered to the PCE (core 1)
+// The difference is the motion still pending, so anything which doesn't
+// fit into one scan (including the low bit lost to the >>1 encoding)
+// is carried forward into later scans rather than being dropped.
+//
+typedef struct
+{
+  uint32_t global_x;
+  uint32_t global_y;
+  uint8_t  global_buttons;
+
+  volatile uint32_t consumed_x;
+  volatile uint32_t consumed_y;
+
+  uint32_t output_word;
+  int16_t  output_x;                        // always even, and within the range of one scan
+  int16_t  output_y;
+  uint8_t  output_buttons;
+
+  bool     mouse;                           // a mouse is connected; otherwise a joypad
+  bool     gamepad;                         // a gamepad is connected (see post_pad())
+  uint16_t pad;                             // joypad nybbles (see post_pad(); active-low)
+
+  int16_t  output_extra_x;                  // extrapolated motion in output_x/y
+  int16_t  output_extra_y;
+  uint32_t output_consumed_x;               // consumed_x/y when output_word was latched
+  uint32_t output_consumed_y;
+  int16_t  predicted_x;                     // extrapolated motion already sent, which
+  int16_t  predicted_y;                     // no report has backed yet
+
+  uint32_t last_report_us;                  // arrival of the newest report
+  uint32_t report_interval_us;              // running average between reports
+  int16_t  last_delta_x;
+  int16_t  last_delta_y;
+  uint32_t pending_since_us;                // arrival of the oldest motion not yet sent
+
+  volatile uint32_t output_data_us;         // arrival of the newest report in output_word
+  volatile uint32_t output_oldest_us;       // arrival of the oldest motion in output_word
+
+  volatile int      state;                  // countdown sequence for shift-register position
+  volatile uint32_t scan_us;                // when this port last moved on (scan timeout)
+  uint32_t          scan_word;              // the packet being sent during a scan (core 1)
+} mouse_port_t;
+
+mouse_port_t ports[MOUSE_PORTS];
+
+// The scan exclude flag is reset once no scan has happened for a while; the
+// console's timing is learned, so this is scansync.reset_us (600us by default)
+
+// Core 0 sleeps (WFE) whenever it has nothing to do; it is woken by any interrupt
+// (USB), by core 1 at each CLR edge (SEV), or by a timer at its next deadline.
+// With nothing else pending, it still wakes this often for the LED and console.
+//
+#define IDLE_WAIT_MAX_US  20000
+#define DLOG_RETRY_US     1000        // (the UART sends 32 characters in 2.8ms)
 
-static absolute_time_t init_time;
-static absolute_time_t current_time;
-static absolute_time_t loop_time;
-static const int64_t reset_period = 600;  // at 600us, reset the scan exclude flag
+static uint32_t pushed_word = 0;          // last word put into the output FIFO by core 0
 
-PIO pio;
-uint sm1, sm2;   // sm1 = plex; sm2 = clock
+PIO pio;         // clock (and plex)
+PIO out_pio;     // plex, or tap with MULTITAP_EMULATION
+uint sm1, sm2;   // sm1 = plex/tap (on out_pio); sm2 = clock
 
 /*------------- MAIN -------------*/
 
@@ -144,31 +252,376 @@ uint sm1, sm2;   // sm1 = plex; sm2 = clock
 // and "pinned" in SRAM - not paged in/out from XIP flash
 //
 
+//
+// pack_output_word - format a port's state/buttons/motion for the state machine
+//
+static inline uint32_t pack_output_word(mouse_port_t *p)
+{
+  return (p->state << OUTPUT_STATE_SHIFT) | ((p->output_buttons & 0x0f) << 16) |
+         (((p->output_x >> 1) & 0xff) << 8) | ((p->output_y >> 1) & 0xff);
+}
+
+#ifdef MULTITAP_EMULATION
+//
+// tap_byte - a port's two nybbles for the multitap: the one shown while
+//            SEL is high (mouse data for its state, or joypad directions)
+//            in the low half, and the one shown while SEL is low (buttons)
+//
+static inline uint32_t tap_byte(const mouse_port_t *p, uint32_t word)
+{
+  uint32_t nybble = (word >> OUTPUT_STATE_SHIFT) & 3;
+
+  if (!p->mouse)
+    return p->pad & 0xff;
+
+  return ((word >> (nybble << 2)) & 0x0f) | (((word >> 16) & 0x0f) << 4);
+}
+
+//
+// pack_tap_word - all ports, one byte each, inverted (see tap.pio);
+//                 either the packets waiting to be sent, or (during
+//                 a scan) the snapshots being sent, at each port's state
+//
+static uint32_t __not_in_flash_func(pack_tap_word)(bool scanning)
+{
+  uint32_t word = 0;
+  int i;
+
+  for (i = 0; i < MOUSE_PORTS; i++)
+  {
+    mouse_port_t *p = &ports[i];
+    uint32_t w = scanning ? ((p->scan_word & ~OUTPUT_STATE_MASK) | (p->state << OUTPUT_STATE_SHIFT))
+                          : p->output_word;
+
+    word |= tap_byte(p, w) << (i * 8);
+  }
+  return ~word;
+}
+#endif
+
+#ifdef PAD_EMULATION
+//
+// pad_word - both banks of the joypad, for the pad program (see pad.pio);
+//            a 6-button pad's second bank shows all four directions pressed
+//
+static inline uint32_t pad_word(uint16_t pad)
+{
+  uint32_t bank1 = pad & 0xff;
+#ifdef PAD_SIX_BUTTON
+  uint32_t bank2 = ((pad >> 8) & 0x0f) << 4;
+#else
+  uint32_t bank2 = bank1;
+#endif
+
+  return bank1 | (bank2 << 8);
+}
+#endif
+
+#if !defined(MULTITAP_EMULATION) && !defined(PAD_EMULATION)
+//
+// plex_word - what the plex program is given for the port: its mouse packet,
+//             or with a gamepad and no mouse, the joypad (the directions in
+//             all four nybbles, so that every state shows them; the buttons
+//             as a mouse's). With neither, it's a mouse which hasn't moved.
+//
+static inline uint32_t plex_word(const mouse_port_t *p, uint32_t word)
+{
+  if (p->mouse || !p->gamepad)
+    return word;
+
+  return (word & OUTPUT_STATE_MASK) | (((p->pad >> 4) & 0x0f) << 16) | ((p->pad & 0x0f) * 0x1111);
+}
+#endif
+
+//
+// output_fifo_word - what core 0 sends to the output state machine between scans
+//
+static inline uint32_t output_fifo_word(void)
+{
+#if defined(MULTITAP_EMULATION)
+  return pack_tap_word(false);
+#elif defined(PAD_EMULATION)
+  return pad_word(ports[0].pad);
+#else
+  return plex_word(&ports[0], ports[0].output_word);
+#endif
+}
+
+#ifdef MULTITAP_EMULATION
+//
+// The tap program takes the newest word at each reset (CLR high), and reports
+// which one it took (see tap.pio); the last few words pushed are kept with
+// each port's packet, so that core 1 can snapshot the packet the console is
+// actually being shown, even if core 0 pushed a newer one during the reset
+//
+#define TAP_PUSHES  4
+
+typedef struct
+{
+  uint32_t word;                        // as pushed (see pack_tap_word)
+  uint32_t output_word[MOUSE_PORTS];    // each port's packet in it
+} tap_push_t;
+
+static tap_push_t        tap_pushes[TAP_PUSHES];
+static volatile uint32_t tap_newest = 0;
+
+//
+// tap_packet - a port's packet in the word the tap program took (core 1):
+//              its output_word, if that still shows the same, or else
+//              the newest push which does
+//
+static uint32_t __not_in_flash_func(tap_packet)(int i, uint32_t taken)
+{
+  uint32_t byte = (~taken >> (i * 8)) & 0xff;
+  uint32_t n = tap_newest;
+  int k;
+
+  if (tap_byte(&ports[i], ports[i].output_word) == byte)
+    return ports[i].output_word;
+
+  for (k = 0; k < TAP_PUSHES; k++, n = (n + TAP_PUSHES - 1) % TAP_PUSHES)
+  {
+    if (((~tap_pushes[n].word >> (i * 8)) & 0xff) == byte)
+      return tap_pushes[n].output_word[i];
+  }
+  return ports[i].output_word;
+}
+#endif
+
+//
+// push_output - send a word to the output state machine (core 0)
+//
+static void __not_in_flash_func(push_output)(uint32_t word)
+{
+#ifdef MULTITAP_EMULATION
+  uint32_t n = (tap_newest + 1) % TAP_PUSHES;
+  int i;
+
+  tap_pushes[n].word = word;
+  for (i = 0; i < MOUSE_PORTS; i++)
+    tap_pushes[n].output_word[i] = ports[i].output_word;
+
+  __dmb();                // recorded before core 1 can see the word
+  tap_newest = n;
+#endif
+
+  pushed_word = word;
+  pio_sm_put(out_pio, sm1, word);
+}
+
+//
+// scan_budget - the part of the pending motion which can be sent in one scan
+//               (signed 8 bits after the >>1 encoding); the rest is carried
+//
+static inline int16_t scan_budget(int32_t pending)
+{
+  int32_t counts = pending >> 1;
+
+  if (counts > 127)
+    counts = 127;
+  else if (counts < -128)
+    counts = -128;
+
+  return (int16_t)(counts << 1);
+}
+
+//
+// latch_output - take the next scan's worth of pending motion into output_word
+//                (only while the PCE is not in the middle of a scan)
+//              - extra_x/y is extrapolated motion, added on top of the reported motion
+//
+// Motion which was sent ahead of the reports (predicted_x/y) is part of consumed_x/y,
+// so it is not sent again; once a report arrives, whatever it differs by is simply
+// pending motion.  If no report arrives for two report intervals, the mouse has
+// stopped, and the prediction is taken back.  Nothing is written off, so the total
+// sent always matches the total reported.
+//
+static void __not_in_flash_func(latch_output)(mouse_port_t *p, int16_t extra_x, int16_t extra_y)
+{
+  int32_t pending_x;
+  int32_t pending_y;
+
+  if ((p->predicted_x || p->predicted_y) &&
+      ((time_us_32() - p->last_report_us) >= (2 * p->report_interval_us)))
+  {
+    p->predicted_x = 0;
+    p->predicted_y = 0;
+  }
+
+  pending_x = (int32_t)(p->global_x - p->consumed_x) + p->predicted_x;
+  pending_y = (int32_t)(p->global_y - p->consumed_y) + p->predicted_y;
+
+  p->output_x = scan_budget(pending_x + extra_x);
+  p->output_y = scan_budget(pending_y + extra_y);
+  p->output_buttons = p->global_buttons;
+  p->output_data_us = p->last_report_us;
+  p->output_oldest_us = p->pending_since_us;
+
+  p->output_extra_x = p->output_x - scan_budget(pending_x);
+  p->output_extra_y = p->output_y - scan_budget(pending_y);
+  p->output_consumed_x = p->consumed_x;
+  p->output_consumed_y = p->consumed_y;
+
+  p->output_word = pack_output_word(p);
+}
+
+//
+// predict_sent - after a scan, note the extrapolated motion it sent, if it took
+//                output_word and no report arrived in the meantime (which backs it)
+//
+static inline void predict_sent(mouse_port_t *p)
+{
+  if (((p->consumed_x != p->output_consumed_x) || (p->consumed_y != p->output_consumed_y)) &&
+      (p->last_report_us == p->output_data_us))
+  {
+    p->predicted_x += p->output_extra_x;
+    p->predicted_y += p->output_extra_y;
+  }
+}
+
+//
+// frame_sync_active - latch timing follows the console only once it has been learned
+//
+static inline bool frame_sync_active(void)
+{
+  return (frame_sync && scansync.locked);
+}
+
+//
+// latch_for_scan - latch for the predicted scan, extrapolating the motion
+//                  from the newest report up to that point if enabled
+//
+static void __not_in_flash_func(latch_for_scan)(mouse_port_t *p, uint32_t scan_us)
+{
+  uint32_t ahead = scan_us - p->last_report_us;
+  int16_t extra_x = 0;
+  int16_t extra_y = 0;
+
+  // only extrapolate within one report interval; beyond that the mouse has probably stopped
+  if (frame_extrapolate && (p->report_interval_us != 0) && (ahead < p->report_interval_us))
+  {
+    extra_x = (p->last_delta_x * (int32_t)ahead) / (int32_t)p->report_interval_us - p->predicted_x;
+    extra_y = (p->last_delta_y * (int32_t)ahead) / (int32_t)p->report_interval_us - p->predicted_y;
+  }
+
+  latch_output(p, extra_x, extra_y);
+}
+
+//
+// relatch - after a port's values changed: when following the console's scan
+//           timing, reports are only accumulated until the pre-scan latch;
+//           after that, each change refreshes the latched packet
+//
+static inline void relatch(mouse_port_t *p, uint32_t now)
+{
+  if (!output_exclude)
+  {
+     if (!frame_sync_active())
+        latch_output(p, 0, 0);
+     else if (frame_latched)
+        latch_for_scan(p, scansync_next_scan(now));
+  }
+}
+
 //
 // post_globals - accumulate the many intermediate mouse scans (~1ms)
 //                into an accumulator which will be reported back to PCE
 //
-void __not_in_flash_func(post_globals)(uint8_t buttons, uint8_t delta_x, uint8_t delta_y)
+void __not_in_flash_func(post_globals)(uint8_t port, uint8_t buttons, int16_t delta_x, int16_t delta_y)
 {
-  if (delta_x >= 128) 
-    global_x = global_x - (256-delta_x);
-  else
-    global_x = global_x + delta_x;
+  mouse_port_t *p;
+  int32_t pending;
+  uint32_t now = time_us_32();
+  uint32_t interval;
 
-  if (delta_y >= 128) 
-    global_y = global_y - (256-delta_y);
-  else
-    global_y = global_y + delta_y;
+  if (port >= MOUSE_PORTS)
+    return;
 
-  global_buttons = buttons;
+  p = &ports[port];
+  p->mouse = true;
 
-  if (!output_exclude)
+  // track the report rate, for extrapolation (gaps mean the mouse was idle)
+  interval = now - p->last_report_us;
+  if (interval < REPORT_INTERVAL_MAX)
+    p->report_interval_us = p->report_interval_us + (((int32_t)interval - (int32_t)p->report_interval_us) >> 3);
+
+  p->last_report_us = now;
+  p->last_delta_x = delta_x;
+  p->last_delta_y = delta_y;
+
+  // this report backs whatever was sent ahead of it
+  p->predicted_x = 0;
+  p->predicted_y = 0;
+
+  if (port == 0)
+    telemetry_report(now, delta_x, delta_y);
+
+  // if nothing is waiting to be sent (other than the odd count which
+  // can't be encoded), this report's motion is now the oldest
+  if (((uint32_t)((int32_t)(p->global_x - p->consumed_x) + 1) <= 2) &&
+      ((uint32_t)((int32_t)(p->global_y - p->consumed_y) + 1) <= 2))
+    p->pending_since_us = now;
+
+  p->global_x = p->global_x + delta_x;
+  p->global_y = p->global_y + delta_y;
+
+  // bound the carried-forward motion
+  pending = (int32_t)(p->global_x - p->consumed_x);
+  if ((pending > MOTION_CARRY_LIMIT) || (pending < -MOTION_CARRY_LIMIT))
   {
-     output_x = global_x;
-     output_y = global_y;
-     output_buttons = global_buttons;
+    p->global_x = p->consumed_x + ((pending > 0) ? MOTION_CARRY_LIMIT : -MOTION_CARRY_LIMIT);
+    motion_dropped++;
+  }
 
-     output_word = (state << 20) | ((output_buttons & 0x0f) << 16) | (((output_x>>1) & 0xff) << 8) | ((output_y>>1) & 0xff);
+  pending = (int32_t)(p->global_y - p->consumed_y);
+  if ((pending > MOTION_CARRY_LIMIT) || (pending < -MOTION_CARRY_LIMIT))
+  {
+    p->global_y = p->consumed_y + ((pending > 0) ? MOTION_CARRY_LIMIT : -MOTION_CARRY_LIMIT);
+    motion_dropped++;
+  }
+
+  p->global_buttons = buttons;
+
+  relatch(p, now);
+}
+
+//
+// post_buttons - set a port's buttons, without a report of motion
+//
+void __not_in_flash_func(post_buttons)(uint8_t port, uint8_t buttons)
+{
+  if (port >= MOUSE_PORTS)
+    return;
+
+  ports[port].global_buttons = buttons;
+
+  relatch(&ports[port], time_us_32());
+}
+
+//
+// post_pad - set the joypad nybbles shown on a port which has no mouse
+//            (low nybble = directions, high nybble = buttons; active-low)
+//
+void __not_in_flash_func(post_pad)(uint8_t port, uint16_t pad)
+{
+  if (port < MOUSE_PORTS)
+  {
+    ports[port].pad = pad;
+    ports[port].gamepad = true;
+  }
+}
+
+//
+// port_release - the last mouse (or the gamepad) on a port has gone; show it
+//                as a joypad again
+//
+void port_release(uint8_t port)
+{
+  if (port < MOUSE_PORTS)
+  {
+    ports[port].mouse = false;
+    ports[port].gamepad = false;
+    ports[port].global_buttons = 0x0f;
   }
 }
 
@@ -179,10 +632,120 @@ void __not_in_flash_func(post_globals)(uint8_t buttons, uint8_t delta_x, uint8_t
 //
 void __not_in_flash_func(post_to_output)(void)
 {
+  uint32_t word;
+  int i;
+
   if (!output_exclude) {
-     output_word = (state << 20) | ((output_buttons & 0x0f) << 16) | (((output_x>>1) & 0xff) << 8) | ((output_y>>1) & 0xff);
-     pio_sm_put(pio, sm1, output_word);
+     for (i = 0; i < MOUSE_PORTS; i++)
+        ports[i].output_word = pack_output_word(&ports[i]);
+
+     word = output_fifo_word();
+
+     // the state machine holds on to the last word it was given,
+     // so it only needs to be sent again when something changed
+     if (word != pushed_word)
+        push_output(word);
+  }
+}
+
+//
+// output_pause - core 1 is about to be paused, so any reads meanwhile won't be
+//                accounted for: the console is shown no motion until it resumes
+//                (what is pending stays pending)
+//
+void output_pause(void)
+{
+  int i;
+
+  for (i = 0; i < MOUSE_PORTS; i++)
+  {
+    ports[i].output_x = 0;
+    ports[i].output_y = 0;
+    ports[i].output_word = pack_output_word(&ports[i]);
+    ports[i].scan_word = ports[i].scan_word & ~0xffff;
   }
+
+  push_output(output_fifo_word());
+}
+
+//
+// output_resume - (core 1 still paused) the CLR edges queued in the clock program
+//                 during the pause are stale; replaying them would walk the states
+//                 down and book motion which was never sent, so they are dropped.
+//                 Core 1 may have been paused anywhere in a scan, so it is left
+//                 to start every port again at state 3 itself (see restart_scan())
+//
+void output_resume(void)
+{
+  int i;
+
+#if !defined(PAD_EMULATION)
+  pio_sm_clear_fifos(pio, sm2);
+  scan_restart = true;
+#endif
+  pio_sm_clear_fifos(out_pio, sm1);
+
+  for (i = 0; i < MOUSE_PORTS; i++)
+    latch_output(&ports[i], 0, 0);
+
+  push_output(output_fifo_word());
+  frame_latched = false;
+  output_exclude = false;
+}
+
+//
+// scan_time_left - time until every port's scan timeout has expired
+//                  (each port times out from its own last step)
+//
+static int32_t __not_in_flash_func(scan_time_left)(uint32_t now)
+{
+  int32_t left = 0;
+  int32_t t;
+  int i;
+
+  for (i = 0; i < MOUSE_PORTS; i++)
+  {
+    t = scansync.reset_us - (int32_t)(now - ports[i].scan_us);
+    if (t > left)
+      left = t;
+  }
+  return left;
+}
+
+//
+// wait_for_event - sleep until there may be something to do: an interrupt,
+//                  a CLR edge (signalled by core 1), or the next deadline
+//                  (end of a scan, or the pre-scan latch)
+//
+static void __not_in_flash_func(wait_for_event)(void)
+{
+  absolute_time_t now = get_absolute_time();
+  uint32_t now_us = time_us_32();
+  int64_t wait = IDLE_WAIT_MAX_US;
+  int64_t until;
+
+  // (a record waiting for the UART: look again once some of it has gone)
+  if (dlog_pending()) {
+    if (dlog_writable())
+      return;
+    wait = DLOG_RETRY_US;
+  }
+
+  if (output_exclude) {
+    until = scan_time_left(now_us) + 1;
+    if (until < wait)
+      wait = until;
+  }
+  else if (frame_sync_active() && !frame_latched) {
+    until = (int32_t)(scansync_next_scan(now_us) - now_us) - SCANSYNC_LEAD_US;
+    if (until < wait)
+      wait = until;
+  }
+
+  if (wait <= 0)
+    return;
+
+  best_effort_wfe_or_timeout(delayed_by_us(now, wait));
 }
 
 
@@ -191,9 +754,12 @@ void __not_in_flash_func(post_to_output)(void)
 //                   - USB polling
 //                   - event processing
 //                   - detection of when a PCE scan is no longer in process (reset period)
+//                   - sleeping until the next event
 //
 static void __not_in_flash_func(process_signals)(void)
 {
+  int i;
+
   while (1)
   {
     // tinyusb host task
@@ -206,24 +772,125 @@ static void __not_in_flash_func(process_signals)(void)
 // check time offset in order to detect when a PCE scan is no longer
 // in process (so that fresh values can be sent to the state machine)
 //
-    current_time = get_absolute_time();
-
-    if (absolute_time_diff_us(init_time, current_time) > reset_period) {
-      state = 3;
-      output_word = (state << 20) | ((output_buttons & 0x0f) << 16) | (((output_x>>1) & 0xff) << 8) | ((output_y>>1) & 0xff);
-      pio_sm_put(pio, sm1, output_word);
+    if (output_exclude && (scan_time_left(time_us_32()) <= 0)) {
+      for (i = 0; i < MOUSE_PORTS; i++) {
+        predict_sent(&ports[i]);
+        ports[i].state = 3;
+        latch_output(&ports[i], 0, 0);   // includes any motion carried over from the last scan
+      }
+      push_output(output_fifo_word());
+      frame_latched = false;
       output_exclude = false;
-      init_time = get_absolute_time();
+    }
+
+//
+// when the console's scan timing is known, refresh the packet
+// just before the next scan is expected
+//
+    if (frame_sync_active() && !frame_latched && !output_exclude) {
+      uint32_t now = time_us_32();
+      uint32_t next_scan = scansync_next_scan(now);
+
+      if ((int32_t)(next_scan - now) <= SCANSYNC_LEAD_US) {
+        for (i = 0; i < MOUSE_PORTS; i++)
+          latch_for_scan(&ports[i], next_scan);
+        frame_latched = true;
+      }
     }
 
 #if CFG_TUH_HID
     hid_app_task();
 #endif
 
+    telemetry_task();
+    dlog_task();
+    console_task();
+
+    // writing the flash pauses core 1, so only between scans
+    if (!output_exclude)
+      settings_task();
+
     post_to_output();
+
+    wait_for_event();
+  }
+}
+
+#ifndef PAD_EMULATION
+//
+// scan_started - bookkeeping at the first CLR edge of a scan (core 1)
+//
+static void __not_in_flash_func(scan_started)(uint32_t now)
+{
+  mouse_port_t *p = &ports[0];
+
+  scansync_scan_start(now);
+  if (p->scan_word & 0xffff)
+     scansync_data_age(now, p->output_data_us);
+
+  telemetry_scan(now, p->output_data_us, p->output_oldest_us,
+                 (int8_t)((p->scan_word >> 8) & 0xff) * 2, (int8_t)(p->scan_word & 0xff) * 2);
+}
+
+//
+// scan_clipped - a scan sent all that one scan can (see scan_budget), and
+//                still left motion pending in the same direction
+//
+static inline bool scan_clipped(int32_t pending, int32_t sent)
+{
+  return ((sent == (127 * 2)) && (pending - sent >= 2)) ||
+         ((sent == (-128 * 2)) && (pending - sent <= -2));
+}
+
+//
+// scan_complete - the last nybble of a port's packet has been sent (core 1)
+//
+static void __not_in_flash_func(scan_complete)(mouse_port_t *p)
+{
+  // account for exactly what was sent; anything left over
+  // stays pending in the globals for the next scan
+  if (p->scan_word & 0xffff)
+  {
+     if (scan_clipped((int32_t)(p->global_x - p->consumed_x), (int8_t)((p->scan_word >> 8) & 0xff) * 2) ||
+         scan_clipped((int32_t)(p->global_y - p->consumed_y), (int8_t)(p->scan_word & 0xff) * 2))
+        motion_clipped++;
+
+     p->consumed_x = p->consumed_x + ((int8_t)((p->scan_word >> 8) & 0xff) * 2);
+     p->consumed_y = p->consumed_y + ((int8_t)(p->scan_word & 0xff) * 2);
+  }
+
+  p->scan_word = p->scan_word & ~0xffff;  // any further reads in this scan see no motion
+
+  p->output_x = 0;
+  p->output_y = 0;
+  p->output_buttons = p->global_buttons;
+
+  p->output_word = pack_output_word(p);
+}
+
+//
+// restart_scan - the first CLR edge since the flash was written (core 1): the
+//                pause may have caught the last scan anywhere, so every port
+//                starts again at state 3 (without scan_complete())
+//
+static void __not_in_flash_func(restart_scan)(uint32_t now)
+{
+  int i;
+
+  for (i = 0; i < MOUSE_PORTS; i++)
+  {
+    ports[i].state = 3;
+    ports[i].scan_us = now;
   }
+
+  scan_restart = false;
 }
+#endif
 
+#if defined(PAD_EMULATION)
+// (core 1 has nothing to do: the pad program answers the console by itself)
+
+#elif !defined(MULTITAP_EMULATION)
 //
 // core1_entry - inner-loop for the second core
 //             - when the "CLR" line is de-asserted, set lock flag
@@ -232,18 +899,38 @@ static void __not_in_flash_func(process_signals)(void)
 static void __not_in_flash_func(core1_entry)(void)
 {
 static bool rx_bit = 0;
+mouse_port_t *p = &ports[0];
+uint32_t loop_us;
+int32_t escape_us;
+
+  // core 0 pauses this core while it writes the settings to flash
+  multicore_lockout_victim_init();
 
   while (1)
   {
      // wait for (and sync with) negedge of CLR signal; rx_data is throwaway
      rx_bit = pio_sm_get_blocking(pio, sm2);
+     loop_us = time_us_32();
+
+     if (scan_restart)
+        restart_scan(loop_us);
 
      // Now we are in an update-sequence; set a lock
      // to prevent update during output transaction
      output_exclude = true;
 
-     // assume data is already formatted in output_word and push it to the state machine
-     pio_sm_put(pio, sm1, output_word);
+     scansync_edge(loop_us);
+
+     // The whole scan is sent from one snapshot of output_word, so all
+     // four nybbles (and the amount consumed) come from the same values
+     if (p->state == 3)
+     {
+        p->scan_word = p->output_word;
+        scan_started(loop_us);
+     }
+
+     // push it to the state machine, showing the current nybble
+     pio_sm_put(out_pio, sm1, plex_word(p, (p->scan_word & ~OUTPUT_STATE_MASK) | (p->state << OUTPUT_STATE_SHIFT)));
 
      // Sequence from state 3 down through state 0 (show different nybbles to PCE)
      //
@@ -252,45 +939,109 @@ static bool rx_bit = 0;
      //
 
      // Also note that staying in 'scan' (CLK = low, SEL = high), is not expected
-     // last more than about a half of a millisecond
+     // last long; the limit is learned from the console (550us by default)
      //
-     loop_time = get_absolute_time();
+     escape_us = scansync.escape_us;
      while ((gpio_get(CLKIN_PIN) == 0) && (gpio_get(DATAIN_PIN) == 1))
      {
-        if (absolute_time_diff_us(loop_time, get_absolute_time()) > 550) {
-           state = 0;
+        if ((int32_t)(time_us_32() - loop_us) > escape_us) {
+           p->state = 0;
            break;
         }
      }
 
-     if (state != 0)
+     // (a read which ran into the limit is measured too, so the limit can grow)
+     scansync_hold(time_us_32() - loop_us);
+
+     if (p->state != 0)
      {
-        state--;
-        output_word = (state << 20) | ((output_buttons & 0x0f) << 16) | (((output_x>>1) & 0xff) << 8) | ((output_y>>1) & 0xff);
+        p->state--;
 
         // renew countdown timeframe
-        init_time = get_absolute_time();
+        p->scan_us = time_us_32();
      }
      else
      {
-        // decrement outputs from globals
-        global_x = (global_x - output_x); 
-        global_y = (global_y - output_y); 
-
-        output_x = 0;
-        output_y = 0;
-        output_buttons = global_buttons;
+        scan_complete(p);
 
         output_exclude = true;            // continue to lock the output values (which are now zero)
+     }
+
+     // wake core 0, so that it re-times the end of the scan
+     __sev();
+  }
+}
+
+#else
+//
+// core1_entry - inner-loop for the second core (multitap emulation)
+//             - the tap state machine walks the ports by itself, so core 1
+//               only has to move each port on at every scan (CLR edge), and
+//               have the next scan's word waiting before the next reset
+//
+static void __not_in_flash_func(core1_entry)(void)
+{
+static bool rx_bit = 0;
+uint32_t now;
+uint32_t taken = ~0u;
+int i;
 
-        output_word = (state << 20) | ((output_buttons & 0x0f) << 16) | (((output_x>>1) & 0xff) << 8) | ((output_y>>1) & 0xff);
+  multicore_lockout_victim_init();
 
+  while (1)
+  {
+     // wait for (and sync with) negedge of CLR signal; by now, the tap
+     // program has already taken this scan's word, and reported it
+     rx_bit = pio_sm_get_blocking(pio, sm2);
+     now = time_us_32();
+
+     if (scan_restart)
+        restart_scan(now);
+
+     output_exclude = true;
+
+     while (!pio_sm_is_rx_fifo_empty(out_pio, sm1))
+        taken = pio_sm_get(out_pio, sm1);
+
+     scansync_edge(now);
+
+     // The whole burst of scans is sent from one snapshot per port: the
+     // packet whose first nybble the console is already being shown
+     if (ports[0].state == 3)
+     {
+        for (i = 0; i < MOUSE_PORTS; i++)
+           ports[i].scan_word = tap_packet(i, taken);
+
+        scan_started(now);
+     }
+
+     // each port's current nybble is on its way; move each one on
+     for (i = 0; i < MOUSE_PORTS; i++)
+     {
+        if (ports[i].state != 0)
+        {
+           ports[i].state--;
+           ports[i].scan_us = now;
+        }
+        else
+        {
+           scan_complete(&ports[i]);
+        }
      }
+
+     // stage the word for the next scan
+     pio_sm_put(out_pio, sm1, pack_tap_word(true));
+
+     // wake core 0, so that it re-times the end of the scan
+     __sev();
   }
 }
+#endif
 
 int main(void)
 {
+  int i;
+
   board_init();
 
   // Pause briefly for stability before starting activity
@@ -300,30 +1051,62 @@ int main(void)
 
   tusb_init();
 
-  global_x = 0;
-  global_y = 0;
-  global_buttons = 0x0f;
+  accel_init();
+  scansync_init();
+  settings_init();
+  telemetry_init();
 
-  output_x = 0;
-  output_y = 0;
-  output_buttons = 0x0f;
-  state = 3;
+  for (i = 0; i < MOUSE_PORTS; i++)
+  {
+    mouse_port_t *p = &ports[i];
 
-  output_word = 0x00003F0000;  // state = 3, no buttons pushed, x=0, y=0
+    memset(p, 0, sizeof(mouse_port_t));
 
-  init_time = get_absolute_time();
+    p->global_buttons = 0x0f;
+    p->output_buttons = 0x0f;
+    p->pad = PAD_RELEASED;
+    p->state = 3;
+    p->scan_us = time_us_32();
 
-  // Both state machines can run on the same PIO processor
+    p->output_word = 0x00003F0000;  // state = 3, no buttons pushed, x=0, y=0
+  }
+
+  // The clock program runs on the first PIO processor
   pio = pio0;
 
+#if defined(PAD_EMULATION)
+  // The pad program answers the console by itself, with no help from the CPU,
+  // so neither the clock program nor core 1 is needed
+  out_pio = pio0;
+
+  uint offset1 = pio_add_program(out_pio, &pad_program);
+  sm1 = pio_claim_unused_sm(out_pio, true);
+  pad_program_init(out_pio, sm1, offset1, DATAIN_PIN, CLKIN_PIN, OUTD0_PIN);
+
+  push_output(output_fifo_word());
+#elif !defined(MULTITAP_EMULATION)
+  // Both state machines can run on the same PIO processor
+  out_pio = pio0;
+
   // Load the plex (multiplex output) program, and configure a free state machine
   // to run the program.
 
-  uint offset1 = pio_add_program(pio, &plex_program);
-  sm1 = pio_claim_unused_sm(pio, true);
-  plex_program_init(pio, sm1, offset1, DATAIN_PIN, OUTD0_PIN);
+  uint offset1 = pio_add_program(out_pio, &plex_program);
+  sm1 = pio_claim_unused_sm(out_pio, true);
+  plex_program_init(out_pio, sm1, offset1, DATAIN_PIN, OUTD0_PIN);
+#else
+  // The multitap walker runs on the second PIO processor
+  out_pio = pio1;
+
+  uint offset1 = pio_add_program(out_pio, &tap_program);
+  sm1 = pio_claim_unused_sm(out_pio, true);
+  tap_program_init(out_pio, sm1, offset1, DATAIN_PIN, CLKIN_PIN, OUTD0_PIN);
+
+  push_output(output_fifo_word());
+#endif
 
 
+#ifndef PAD_EMULATION
   // Load the clock (synchronizing input) program, and configure a free state machine
   // to run the program.
 
@@ -332,6 +1115,7 @@ int main(void)
   clock_program_init(pio, sm2, offset2, CLKIN_PIN);
 
   multicore_launch_core1(core1_entry);
+#endif
 
   process_signals();
 
@@ -360,3 +1144,24 @@ void led_blinking_task(void)
   board_led_write(led_state);
   led_state = 1 - led_state; // toggle
 }
+
+//--------------------------------------------------------------------+
+// Console (UART) commands
+//--------------------------------------------------------------------+
+void console_task(void)
+{
+  const uint32_t interval_us = 20000;
+  static uint32_t start_us = 0;
+  int c;
+
+  // Poll every interval us
+  if (time_us_32() - start_us < interval_us) return; // not enough time
+  start_us = time_us_32();
+
+  c = getchar_timeout_us(0);
+  if (c == PICO_ERROR_TIMEOUT) return;
+
+  telemetry_command(c);
+  dlog_command(c);
+  settings_command(c);
+}
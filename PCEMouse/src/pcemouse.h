@@ -0,0 +1,89 @@
+/*
+ * pcemouse.h - declarations shared between the USB side and the console side
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _PCEMOUSE_H_
+#define _PCEMOUSE_H_
+
+#include <stdint.h>
+
+#include "pico/stdlib.h"
+
+// Uncomment the following line to emulate a multitap with several devices on it
+// (each port shows a mouse, or a joypad when no mouse is assigned to it),
+// instead of a single mouse:
+// #define MULTITAP_EMULATION  true
+
+// Number of console ports emulated
+//
+#ifdef MULTITAP_EMULATION
+#define MOUSE_PORTS     4       // one byte per port in the tap word (see tap.pio)
+#else
+#define MOUSE_PORTS     1
+#endif
+
+// Uncomment the following line to emulate a PC Engine joypad instead of a mouse
+// (driven by a USB gamepad; the console is answered by pad.pio alone):
+// #define PAD_EMULATION  true
+
+// ... and this one to make it a 6-button pad (Avenue Pad 6) rather than a 2-button one:
+// #define PAD_SIX_BUTTON  true
+
+#if defined(PAD_EMULATION) && defined(MULTITAP_EMULATION)
+#error "PAD_EMULATION and MULTITAP_EMULATION can't be used together"
+#endif
+
+// post_globals - add one report's motion to a port's accumulator, and set that
+//                port's buttons (PCE order Run/Sel/II/I, active-low)
+//              - only ever called from core 0 (the USB report path)
+//
+void __not_in_flash_func(post_globals)(uint8_t port, uint8_t buttons, int16_t delta_x, int16_t delta_y);
+
+// post_buttons - set a port's buttons, when there is no report of motion
+//                (e.g. one of several mice on the port went away); unlike
+//                post_globals(), this isn't counted as a report
+//
+void __not_in_flash_func(post_buttons)(uint8_t port, uint8_t buttons);
+
+// post_pad - set the joypad shown on a port without a mouse (any port with
+//            multitap emulation; otherwise the console port, from now until
+//            port_release()), or the joypad itself (pad emulation)
+//            (low nybble = Left/Down/Right/Up, next = Run/Sel/II/I,
+//             then VI/V/IV/III for a 6-button pad; active-low)
+//
+void __not_in_flash_func(post_pad)(uint8_t port, uint16_t pad);
+
+#define PAD_RELEASED    0xffff
+
+#define PAD_UP          0x01
+#define PAD_RIGHT       0x02
+#define PAD_DOWN        0x04
+#define PAD_LEFT        0x08
+#define PAD_I           0x10
+#define PAD_II          0x20
+#define PAD_SEL         0x40
+#define PAD_RUN         0x80
+#define PAD_III         0x100
+#define PAD_IV          0x200
+#define PAD_V           0x400
+#define PAD_VI          0x800
+
+#define PAD_BUTTONS     8       // I, II, Select, Run, III, IV, V, VI
+
+// port_release - no mouse (or gamepad) is left on this port
+//
+void port_release(uint8_t port);
+
+// output_pause  - before core 1 is paused (to write the flash): show no motion,
+//                 as reads can't be accounted for meanwhile
+// output_resume - after the write, while core 1 is still paused: drop the CLR
+//                 edges which piled up; core 1 starts again from the top of a
+//                 scan at the next edge
+//
+void output_pause(void);
+void output_resume(void);
+
+#endif /* _PCEMOUSE_H_ */
@@ -0,0 +1,110 @@
+/*
+ * ring.h - lock-free single-producer/single-consumer ring of fixed-size records
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _RING_H_
+#define _RING_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "hardware/sync.h"
+
+//--------------------------------------------------------------------+
+// One core (or context) puts, one gets; head is only written by the
+// producer and tail only by the consumer, so no lock is needed, even
+// between the two cores. The memory barriers make sure the record is
+// complete before the producer publishes it, and has been read before
+// the consumer releases its slot.
+//
+// Records are a whole number of 32-bit words and are copied inline,
+// so putting a record never calls out to (flash-resident) library code.
+// When the ring is full, new records are dropped (and counted), so the
+// producer never waits.
+//--------------------------------------------------------------------+
+
+// A word of a record: it may alias the record's own fields, so the copy
+// can't be moved ahead of the stores which filled the record in
+//
+typedef uint32_t __attribute__((__may_alias__)) ring_word_t;
+
+typedef struct
+{
+  volatile uint32_t head;       // next slot to write (producer only)
+  volatile uint32_t tail;       // next slot to read (consumer only)
+  uint32_t          mask;       // number of records - 1 (power of 2)
+  uint32_t          words;      // words per record
+  uint32_t         *buf;
+  volatile uint32_t dropped;    // records lost to a full ring (producer only)
+} ring_t;
+
+// RING_DEFINE - static storage for a ring of 'count' (power of 2) records of 'type'
+//
+#define RING_DEFINE(name, type, count)                                         \
+  static uint32_t name##_buf[(count) * ((sizeof(type) + 3) / 4)];              \
+  ring_t name = { 0, 0, (count) - 1, (sizeof(type) + 3) / 4, name##_buf, 0 }
+
+static inline bool ring_put(ring_t *r, const void *rec)
+{
+  uint32_t head = r->head;
+  const ring_word_t *src = (const ring_word_t *)rec;
+  uint32_t *dst;
+  uint32_t i;
+
+  if ((head - r->tail) > r->mask)
+  {
+    r->dropped++;
+    return false;
+  }
+
+  dst = r->buf + ((head & r->mask) * r->words);
+  for (i = 0; i < r->words; i++)
+    dst[i] = src[i];
+
+  __dmb();                      // record contents before the new head
+  r->head = head + 1;
+  return true;
+}
+
+static inline bool ring_get(ring_t *r, void *rec)
+{
+  uint32_t tail = r->tail;
+  ring_word_t *dst = (ring_word_t *)rec;
+  const uint32_t *src;
+  uint32_t i;
+
+  if (tail == r->head)
+    return false;
+
+  __dmb();                      // head before the record contents
+
+  src = r->buf + ((tail & r->mask) * r->words);
+  for (i = 0; i < r->words; i++)
+    dst[i] = src[i];
+
+  __dmb();                      // finish reading before releasing the slot
+  r->tail = tail + 1;
+  return true;
+}
+
+// ring_peek - the oldest record, left in place (NULL if empty)
+static inline const void *ring_peek(const ring_t *r)
+{
+  uint32_t tail = r->tail;
+
+  if (tail == r->head)
+    return 0;
+
+  __dmb();                      // head before the record contents
+  return (r->buf + ((tail & r->mask) * r->words));
+}
+
+static inline uint32_t ring_count(const ring_t *r)
+{
+  return (r->head - r->tail);
+}
+
+#endif /* _RING_H_ */
@@ -0,0 +1,238 @@
+/*
+ * scansync.c - model of the PC Engine's scan timing, learned from CLR edges
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include "scansync.h"
+
+scansync_t scansync;
+
+
+void scansync_init(void)
+{
+  scansync.last_scan_us = 0;
+  scansync.period_us = 16683;       // NTSC frame, until we learn better
+  scansync.locked = false;
+  scansync.good = 0;
+  scansync.bad = 0;
+  scansync.scans = 0;
+
+  scansync.last_edge_us = 0;
+  scansync.edge_seen = false;
+  scansync.burst_gap_us = 0;
+  scansync.burst_hold_us = 0;
+  scansync.gap_us = 0;
+  scansync.hold_us = 0;
+  scansync.bursts = 0;
+  scansync.reset_us = SCANSYNC_RESET_DEFAULT;
+  scansync.escape_us = SCANSYNC_ESCAPE_DEFAULT;
+  scansync.fixed = false;
+
+  scansync.age_last_us = 0;
+  scansync.age_avg_us = 0;
+  scansync.age_max_us = 0;
+}
+
+//
+// scansync_calibrate - fold the burst which just ended into the learned
+//                      timing, and derive the timeouts from it
+//
+static void scansync_calibrate(void)
+{
+  uint32_t gap  = scansync.burst_gap_us;
+  uint32_t hold = scansync.burst_hold_us;
+  int32_t reset, escape;
+
+  scansync.burst_gap_us = 0;
+  scansync.burst_hold_us = 0;
+
+  // a burst of one scan (e.g. a joypad read) says nothing about the spacing
+  if (gap == 0)
+    return;
+
+  // while calibrating, keep the worst case; afterwards, follow increases
+  // at once (so a slow host is never cut off twice), and decreases slowly
+  if ((scansync.bursts < SCANSYNC_CALIB_BURSTS) || (gap > scansync.gap_us))
+    scansync.gap_us = (gap > scansync.gap_us) ? gap : scansync.gap_us;
+  else
+    scansync.gap_us = scansync.gap_us - ((scansync.gap_us - gap) >> 4);
+
+  if ((scansync.bursts < SCANSYNC_CALIB_BURSTS) || (hold > scansync.hold_us))
+    scansync.hold_us = (hold > scansync.hold_us) ? hold : scansync.hold_us;
+  else
+    scansync.hold_us = scansync.hold_us - ((scansync.hold_us - hold) >> 4);
+
+  if (scansync.bursts < SCANSYNC_CALIB_BURSTS)
+  {
+    scansync.bursts++;
+    if (scansync.bursts < SCANSYNC_CALIB_BURSTS)
+      return;
+  }
+
+  // the timing is still measured, but the timeouts stay as they were set
+  if (scansync.fixed)
+    return;
+
+  // end of burst: half as long again as the longest gap seen, plus a margin;
+  // never so long that it runs into the next frame's scan
+  reset = scansync.gap_us + (scansync.gap_us >> 1) + 100;
+  if (reset < SCANSYNC_RESET_MIN)
+    reset = SCANSYNC_RESET_MIN;
+  if (reset > SCANSYNC_RESET_MAX)
+    reset = SCANSYNC_RESET_MAX;
+  if (reset > (int32_t)(scansync.period_us >> 2))
+    reset = scansync.period_us >> 2;
+
+  // one read: twice the longest seen, plus a margin, and no shorter than the
+  // default; always inside the reset period
+  escape = (scansync.hold_us << 1) + 200;
+  if (escape < SCANSYNC_ESCAPE_DEFAULT)
+    escape = SCANSYNC_ESCAPE_DEFAULT;
+  if (escape > reset - 50)
+    escape = reset - 50;
+  if (escape < SCANSYNC_ESCAPE_MIN)
+    escape = SCANSYNC_ESCAPE_MIN;
+
+  scansync.reset_us = reset;
+  scansync.escape_us = escape;
+}
+
+//
+// scansync_edge - called (from core 1) at every CLR edge, to measure
+//                 the spacing of the scans within a burst
+//
+void scansync_edge(uint32_t now_us)
+{
+  uint32_t gap = now_us - scansync.last_edge_us;
+
+  scansync.last_edge_us = now_us;
+
+  if (!scansync.edge_seen)
+  {
+    scansync.edge_seen = true;
+    return;
+  }
+
+  if ((gap < SCANSYNC_BURST_GAP_MAX) && (gap > scansync.burst_gap_us))
+    scansync.burst_gap_us = gap;
+}
+
+//
+// scansync_hold - called (from core 1) with the time one read took
+//                 (CLR low, SEL high), including reads cut off by escape_us
+//
+void scansync_hold(uint32_t hold_us)
+{
+  if (hold_us > scansync.burst_hold_us)
+    scansync.burst_hold_us = hold_us;
+}
+
+//
+// scansync_scan_start - called (from core 1) at the first CLR edge of a scan
+//
+void scansync_scan_start(uint32_t now_us)
+{
+  int32_t interval = (int32_t)(now_us - scansync.last_scan_us);
+  int32_t error    = interval - (int32_t)scansync.period_us;
+  int32_t window   = scansync.period_us >> 2;     // +/- 25%
+
+  scansync_calibrate();
+
+  if (scansync.scans == 0)
+  {
+    // first scan; nothing to compare against
+  }
+  else if ((interval >= SCANSYNC_MIN_PERIOD) && (interval <= SCANSYNC_MAX_PERIOD) &&
+           (!scansync.locked || ((error > -window) && (error < window))))
+  {
+    // track slowly once locked; converge quickly while learning
+    if (scansync.locked)
+      scansync.period_us = scansync.period_us + (error >> 3);
+    else
+      scansync.period_us = scansync.period_us + (error >> 1);
+
+    scansync.bad = 0;
+    if (scansync.good < SCANSYNC_LOCK_COUNT)
+      scansync.good++;
+    else
+      scansync.locked = true;
+  }
+  else
+  {
+    scansync.good = 0;
+    if (scansync.bad < SCANSYNC_LOCK_COUNT)
+      scansync.bad++;
+    else
+      scansync.locked = false;
+  }
+
+  scansync.last_scan_us = now_us;
+  scansync.scans++;
+}
+
+//
+// scansync_data_age - record how old the newest USB data was when the
+//                     console started to read it (only for packets
+//                     carrying motion; an idle mouse has no meaningful age)
+//
+void scansync_data_age(uint32_t now_us, uint32_t data_us)
+{
+  scansync.age_last_us = now_us - data_us;
+  if (scansync.age_last_us > SCANSYNC_MAX_PERIOD)
+    scansync.age_last_us = SCANSYNC_MAX_PERIOD;
+
+  scansync.age_avg_us = scansync.age_avg_us +
+                        (((int32_t)scansync.age_last_us - (int32_t)scansync.age_avg_us) >> 4);
+
+  if (scansync.age_last_us > scansync.age_max_us)
+    scansync.age_max_us = scansync.age_last_us;
+}
+
+//
+// scansync_next_scan - predicted start time of the next scan
+//                      (skipping over any scans which evidently didn't happen)
+//
+uint32_t scansync_next_scan(uint32_t now_us)
+{
+  uint32_t period = scansync.period_us;
+  uint32_t next   = scansync.last_scan_us + period;
+  int i;
+
+  for (i = 0; (i < 8) && ((int32_t)(now_us - next) > (int32_t)(period >> 2)); i++)
+    next = next + period;
+
+  return next;
+}
+
+//
+// scansync_fix - use these timeouts rather than deriving them (0 = go back
+//                to deriving them; the defaults apply until that has been done)
+//
+void scansync_fix(int32_t reset_us, int32_t escape_us)
+{
+  if (reset_us == 0)
+  {
+    scansync.fixed = false;
+    if (scansync.bursts < SCANSYNC_CALIB_BURSTS)
+    {
+      scansync.reset_us = SCANSYNC_RESET_DEFAULT;
+      scansync.escape_us = SCANSYNC_ESCAPE_DEFAULT;
+    }
+    return;
+  }
+
+  if (reset_us < SCANSYNC_RESET_MIN)
+    reset_us = SCANSYNC_RESET_MIN;
+  if (reset_us > SCANSYNC_RESET_MAX)
+    reset_us = SCANSYNC_RESET_MAX;
+  if (escape_us > reset_us - 50)
+    escape_us = reset_us - 50;
+  if (escape_us < SCANSYNC_ESCAPE_MIN)
+    escape_us = SCANSYNC_ESCAPE_MIN;
+
+  scansync.reset_us = reset_us;
+  scansync.escape_us = escape_us;
+  scansync.fixed = true;
+}
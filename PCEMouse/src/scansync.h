@@ -0,0 +1,79 @@
+/*
+ * scansync.h - model of the PC Engine's scan timing, learned from CLR edges
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SCANSYNC_H_
+#define _SCANSYNC_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//--------------------------------------------------------------------+
+// The PCE normally reads the mouse once per frame. By timestamping the
+// start of each scan, we learn the period and phase of those reads and
+// can predict when the next one will happen, so that the packet can be
+// latched (and optionally extrapolated) just before it is read.
+//
+// All times are in microseconds from time_us_32(); differences are
+// taken as signed 32-bit values, so wrap-around is harmless.
+//--------------------------------------------------------------------+
+
+#define SCANSYNC_MIN_PERIOD   4000    // plausible range of scan periods
+#define SCANSYNC_MAX_PERIOD   50000
+#define SCANSYNC_LOCK_COUNT   4       // consistent intervals needed to lock
+#define SCANSYNC_LEAD_US      300     // latch this far ahead of the predicted scan
+
+// A mouse packet is read as a burst of scans (one per nybble). The console's
+// timing within a burst is learned too, to time out the end of a burst, and a
+// read which never finishes; until enough bursts have been seen (or if the
+// console never reads a whole packet), these defaults are used.
+//
+#define SCANSYNC_RESET_DEFAULT   600     // end of burst: time since the last scan
+#define SCANSYNC_ESCAPE_DEFAULT  550     // longest wait for one read to finish
+#define SCANSYNC_RESET_MIN       300
+#define SCANSYNC_RESET_MAX       2000
+#define SCANSYNC_ESCAPE_MIN      100
+#define SCANSYNC_BURST_GAP_MAX   2000    // longer gaps between scans are between bursts
+#define SCANSYNC_CALIB_BURSTS    8       // bursts measured before the learned values are used
+
+typedef struct
+{
+  volatile uint32_t last_scan_us;   // start of the most recent scan
+  volatile uint32_t period_us;      // learned scan period
+  volatile bool     locked;         // period/phase are trustworthy
+  uint8_t           good;           // consecutive intervals matching the period
+  uint8_t           bad;            // consecutive intervals which did not
+  uint32_t          scans;          // total scans seen
+
+  // timing within a burst of scans
+  uint32_t          last_edge_us;   // most recent CLR edge
+  bool              edge_seen;      // last_edge_us is valid
+  uint32_t          burst_gap_us;   // longest gap between scans, this burst
+  uint32_t          burst_hold_us;  // longest read, this burst
+  uint32_t          gap_us;         // learned longest gap between scans of a burst
+  uint32_t          hold_us;        // learned longest read
+  uint8_t           bursts;         // bursts measured (up to SCANSYNC_CALIB_BURSTS)
+  volatile int32_t  reset_us;       // derived end-of-burst timeout
+  volatile int32_t  escape_us;      // derived timeout for one read
+  bool              fixed;          // timeouts set by the user (see settings.c), not derived
+
+  // age of the newest USB data in each packet, at the moment the scan starts
+  uint32_t          age_last_us;
+  uint32_t          age_avg_us;     // running average (1/16 weight)
+  uint32_t          age_max_us;
+} scansync_t;
+
+extern scansync_t scansync;
+
+void     scansync_init(void);
+void     scansync_scan_start(uint32_t now_us);
+void     scansync_edge(uint32_t now_us);
+void     scansync_hold(uint32_t hold_us);
+void     scansync_data_age(uint32_t now_us, uint32_t data_us);
+uint32_t scansync_next_scan(uint32_t now_us);
+void     scansync_fix(int32_t reset_us, int32_t escape_us);
+
+#endif /* _SCANSYNC_H_ */
@@ -0,0 +1,424 @@
+/*
+ * settings.c - settings kept in flash across power cycles, and the
+ *              tables derived from them for the report path
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "pcemouse.h"
+#include "scansync.h"
+#include "settings.h"
+
+// Defaults
+// --------
+// These apply until the settings are changed (and saved), or after 'r'
+//
+
+// Uncomment the following line if you desire button-swap when middle button is clicked:
+// #define MID_BUTTON_SWAPPABLE  true
+
+// Uncomment the following line if you desire adjustable sensitivity from scroll-wheel:
+#define SENSITIVITY_SCROLL  true
+
+#ifdef MID_BUTTON_SWAPPABLE
+#define DEFAULT_MID_SWAP      SETTINGS_MID_SWAP
+#else
+#define DEFAULT_MID_SWAP      0
+#endif
+
+#ifdef SENSITIVITY_SCROLL
+#define DEFAULT_WHEEL_CURVE   SETTINGS_WHEEL_CURVE
+#else
+#define DEFAULT_WHEEL_CURVE   0
+#endif
+
+// USB mouse buttons for I, II, Select and Run
+//
+static const uint8_t default_mouse_map[4] =
+{
+  SETTINGS_USB_RIGHT, SETTINGS_USB_LEFT, SETTINGS_USB_FORWARD, SETTINGS_USB_BACKWARD
+};
+
+// HID gamepad buttons for I, II, Select and Run, then III, IV, V and VI
+// (6-button pad). Pads differ in how they number their buttons; this suits
+// most generic USB pads.
+//
+static const uint8_t default_pad_map[PAD_BUTTONS] = { 2, 1, 9, 10, 3, 4, 5, 6 };
+
+#define PAD_MAP_MAX           32      // HID buttons beyond this are not read (see hid_layout.c)
+
+
+// Flash log
+// ---------
+// The last two sectors of the flash hold a log of records, one per page.
+// The newest valid record wins; a sector is only erased when the log
+// wraps around into it, and by then the newest record is in the other one.
+//
+#define SETTINGS_SECTORS      2
+#define SETTINGS_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - (SETTINGS_SECTORS * FLASH_SECTOR_SIZE))
+#define SLOTS_PER_SECTOR      (FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE)
+#define SETTINGS_SLOTS        (SETTINGS_SECTORS * SLOTS_PER_SECTOR)
+
+#define SETTINGS_MAGIC        0x53454350      // "PCES"
+#define SETTINGS_VERSION      1
+
+// Changes are saved once they have settled for this long (the scroll wheel
+// can step through several curves in a row)
+//
+#define SETTINGS_SAVE_DELAY_US  5000000
+
+typedef struct
+{
+  uint32_t   magic;
+  uint32_t   seq;             // higher is newer
+  uint16_t   version;
+  uint16_t   size;
+  uint32_t   check;
+  settings_t data;
+} settings_record_t;
+
+_Static_assert(sizeof(settings_record_t) <= FLASH_PAGE_SIZE, "settings must fit in one flash page");
+
+settings_t settings;
+
+// The report path reads through this pointer; the tables are built into
+// the one not in use, then the pointer is switched
+//
+static settings_run_t run_tables[2];
+const settings_run_t *settings_run = &run_tables[0];
+
+static int      log_slot = -1;        // slot of the newest record (-1 = none)
+static uint32_t log_seq = 0;
+static bool     dirty = false;        // changed since the last save
+static uint32_t changed_us;
+
+
+static uint32_t settings_check(const settings_t *s)
+{
+  const uint8_t *b = (const uint8_t *)s;
+  uint32_t h = 2166136261u;           // FNV-1a
+  unsigned i;
+
+  for (i = 0; i < sizeof(settings_t); i++)
+    h = (h ^ b[i]) * 16777619u;
+
+  return h;
+}
+
+static inline const uint8_t *slot_address(int slot)
+{
+  return (const uint8_t *)(XIP_BASE + SETTINGS_FLASH_OFFSET + (slot * FLASH_PAGE_SIZE));
+}
+
+static bool slot_blank(int slot)
+{
+  const uint8_t *b = slot_address(slot);
+  int i;
+
+  for (i = 0; i < FLASH_PAGE_SIZE; i++)
+    if (b[i] != 0xff)
+      return false;
+
+  return true;
+}
+
+static bool slot_valid(const settings_record_t *r)
+{
+  return (r->magic == SETTINGS_MAGIC) && (r->version == SETTINGS_VERSION) &&
+         (r->size == sizeof(settings_t)) && (r->check == settings_check(&r->data));
+}
+
+static void settings_defaults(void)
+{
+  int i;
+
+  memset(&settings, 0, sizeof(settings));
+
+  for (i = 0; i < SETTINGS_PROFILES; i++)
+  {
+    settings_profile_t *p = &settings.profiles[i];
+    int k;
+
+    for (k = 0; k < ACCEL_KINDS; k++)
+      p->curve[k] = accel_curve_default[k];
+    p->flags = DEFAULT_MID_SWAP | DEFAULT_WHEEL_CURVE;
+    memcpy(p->mouse_map, default_mouse_map, sizeof(p->mouse_map));
+    memcpy(p->pad_map, default_pad_map, sizeof(p->pad_map));
+  }
+}
+
+//
+// settings_sanitize - anything out of range (e.g. curves since removed) goes back to its default
+//
+static void settings_sanitize(void)
+{
+  int i, j;
+
+  if (settings.profile >= SETTINGS_PROFILES)
+    settings.profile = 0;
+
+  for (i = 0; i < SETTINGS_PROFILES; i++)
+  {
+    settings_profile_t *p = &settings.profiles[i];
+
+    for (j = 0; j < ACCEL_KINDS; j++)
+      if (p->curve[j] >= accel_curve_count)
+        p->curve[j] = accel_curve_default[j];
+
+    for (j = 0; j < 4; j++)
+      if (p->mouse_map[j] >= SETTINGS_USB_BUTTONS)
+        p->mouse_map[j] = default_mouse_map[j];
+
+    for (j = 0; j < PAD_BUTTONS; j++)
+      if ((p->pad_map[j] == 0) || (p->pad_map[j] > PAD_MAP_MAX))
+        p->pad_map[j] = default_pad_map[j];
+  }
+}
+
+//
+// settings_apply - rebuild the report path's tables from the current profile
+//                  (not on the hot path)
+//
+static void settings_apply(void)
+{
+  const settings_profile_t *p = &settings.profiles[settings.profile];
+  settings_run_t *run = (settings_run == &run_tables[0]) ? &run_tables[1] : &run_tables[0];
+  int swapped, usb, i;
+
+  for (swapped = 0; swapped < 2; swapped++)
+  {
+    for (usb = 0; usb < (1 << SETTINGS_USB_BUTTONS); usb++)
+    {
+      uint8_t buttons = 0x0f;
+
+      // swapped: I and II trade places
+      for (i = 0; i < 4; i++)
+        if (usb & (1 << p->mouse_map[(swapped && (i < 2)) ? (i ^ 1) : i]))
+          buttons &= ~(1 << i);
+
+      run->mouse_buttons[swapped][usb] = buttons;
+    }
+  }
+
+  for (i = 0; i < PAD_BUTTONS; i++)
+    run->pad_mask[i] = 1ul << (p->pad_map[i] - 1);
+
+  run->mid_swap = (p->flags & SETTINGS_MID_SWAP) != 0;
+  run->wheel_curve = (p->flags & SETTINGS_WHEEL_CURVE) != 0;
+
+  settings_run = run;
+
+  for (i = 0; i < ACCEL_KINDS; i++)
+    accel_select(i, p->curve[i]);
+
+  scansync_fix(settings.reset_us, settings.escape_us);
+}
+
+static void settings_changed(void)
+{
+  dirty = true;
+  changed_us = time_us_32();
+}
+
+//
+// flash_write - program one page, erasing its sector first if asked;
+//               core 1 is paused meanwhile, as the flash can't be read
+//               (for up to ~45ms with an erase, so the output is paused too)
+//
+static void flash_write(int slot, const uint8_t *page, bool erase)
+{
+  uint32_t offset = SETTINGS_FLASH_OFFSET + (slot * FLASH_PAGE_SIZE);
+  bool pause = multicore_lockout_victim_is_initialized(1);
+  uint32_t ints;
+
+  if (pause)
+  {
+    output_pause();
+    multicore_lockout_start_blocking();
+  }
+
+  ints = save_and_disable_interrupts();
+
+  if (erase)
+    flash_range_erase(offset & ~(FLASH_SECTOR_SIZE - 1), FLASH_SECTOR_SIZE);
+  flash_range_program(offset, page, FLASH_PAGE_SIZE);
+
+  restore_interrupts(ints);
+
+  if (pause)
+  {
+    output_resume();
+    multicore_lockout_end_blocking();
+  }
+}
+
+//
+// settings_save - append a record to the log
+//
+static void settings_save(void)
+{
+  static uint8_t page[FLASH_PAGE_SIZE] __attribute__((aligned(4)));
+  settings_record_t *r = (settings_record_t *)page;
+  int slot = (log_slot + 1) % SETTINGS_SLOTS;
+  bool erase = ((slot % SLOTS_PER_SECTOR) == 0);
+
+  // something unexpected in the way; start afresh in the other sector
+  if (!erase && !slot_blank(slot))
+  {
+    slot = (((slot / SLOTS_PER_SECTOR) + 1) % SETTINGS_SECTORS) * SLOTS_PER_SECTOR;
+    erase = true;
+  }
+
+  memset(page, 0xff, sizeof(page));
+  r->magic = SETTINGS_MAGIC;
+  r->seq = log_seq + 1;
+  r->version = SETTINGS_VERSION;
+  r->size = sizeof(settings_t);
+  r->data = settings;
+  r->check = settings_check(&r->data);
+
+  flash_write(slot, page, erase);
+
+  log_slot = slot;
+  log_seq = r->seq;
+  printf("Settings saved (%d)\r\n", slot);
+}
+
+//
+// settings_init - the newest saved settings, or the defaults (not on the hot path;
+//                 after accel_init() and scansync_init())
+//
+void settings_init(void)
+{
+  int slot;
+
+  settings_defaults();
+
+  for (slot = 0; slot < SETTINGS_SLOTS; slot++)
+  {
+    const settings_record_t *r = (const settings_record_t *)slot_address(slot);
+
+    if (slot_valid(r) && ((log_slot < 0) || ((int32_t)(r->seq - log_seq) > 0)))
+    {
+      log_slot = slot;
+      log_seq = r->seq;
+    }
+  }
+
+  if (log_slot >= 0)
+    memcpy(&settings, &((const settings_record_t *)slot_address(log_slot))->data, sizeof(settings));
+
+  settings_sanitize();
+  settings_apply();
+}
+
+//
+// settings_task - save the settings once they have settled; called from the
+//                 core 0 loop, between scans
+//
+void settings_task(void)
+{
+  if (!dirty || ((time_us_32() - changed_us) < SETTINGS_SAVE_DELAY_US))
+    return;
+
+  dirty = false;
+  settings_save();
+}
+
+//
+// settings_set_curve - the scroll wheel changed a curve (report path: only a
+//                      pointer changes, and the save happens later)
+//
+void settings_set_curve(accel_kind_t kind, int curve)
+{
+  if ((kind >= ACCEL_KINDS) || (curve < 0) || (curve >= accel_curve_count))
+    return;
+
+  accel_select(kind, curve);
+  settings.profiles[settings.profile].curve[kind] = curve;
+  settings_changed();
+}
+
+static void settings_print(void)
+{
+  const settings_profile_t *p = &settings.profiles[settings.profile];
+  int i;
+
+  printf("profile %d of %d:", settings.profile + 1, SETTINGS_PROFILES);
+  for (i = 0; i < ACCEL_KINDS; i++)
+    printf(" %s", accel_curves[p->curve[i]].name);
+  printf("%s%s\r\n", (p->flags & SETTINGS_MID_SWAP) ? ", middle button swaps" : "",
+         (p->flags & SETTINGS_WHEEL_CURVE) ? ", wheel sets curve" : "");
+
+  printf("mouse buttons (I II Sel Run): %d %d %d %d; pad buttons:",
+         p->mouse_map[0] + 1, p->mouse_map[1] + 1, p->mouse_map[2] + 1, p->mouse_map[3] + 1);
+  for (i = 0; i < PAD_BUTTONS; i++)
+    printf(" %d", p->pad_map[i]);
+  printf("\r\n");
+
+  if (settings.reset_us)
+    printf("scan timeouts: reset=%uus escape=%uus (fixed)\r\n", settings.reset_us, settings.escape_us);
+  else
+    printf("scan timeouts: learned\r\n");
+}
+
+//
+// settings_command - console commands:
+//     's' shows the settings
+//     'p' moves on to the next profile
+//     'b' swaps I and II (mouse)
+//     'm' turns the middle-button swap on or off
+//     'w' turns curve selection by the scroll wheel on or off
+//     'f' fixes the scan timeouts at the values learned so far (or goes back to learning them)
+//     'r' restores the defaults
+//
+void settings_command(int c)
+{
+  settings_profile_t *p = &settings.profiles[settings.profile];
+  uint8_t m;
+
+  switch (c)
+  {
+    case 's':
+      break;
+    case 'p':
+      settings.profile = (settings.profile + 1) % SETTINGS_PROFILES;
+      break;
+    case 'b':
+      m = p->mouse_map[0];
+      p->mouse_map[0] = p->mouse_map[1];
+      p->mouse_map[1] = m;
+      break;
+    case 'm':
+      p->flags ^= SETTINGS_MID_SWAP;
+      break;
+    case 'w':
+      p->flags ^= SETTINGS_WHEEL_CURVE;
+      break;
+    case 'f':
+      settings.reset_us = settings.reset_us ? 0 : scansync.reset_us;
+      settings.escape_us = settings.reset_us ? scansync.escape_us : 0;
+      break;
+    case 'r':
+      settings_defaults();
+      break;
+    default:
+      return;
+  }
+
+  if (c != 's')
+  {
+    settings_apply();
+    settings_changed();
+  }
+  settings_print();
+}
@@ -0,0 +1,80 @@
+/*
+ * settings.h - settings kept in flash across power cycles, and the
+ *              tables derived from them for the report path
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SETTINGS_H_
+#define _SETTINGS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "accel.h"
+#include "pcemouse.h"
+
+//--------------------------------------------------------------------+
+// The settings are read from flash once at startup (or the defaults
+// are used), and are then only changed from the idle part of the core 0
+// loop (console commands), or by the scroll wheel. Each change rebuilds
+// the tables used by the report path, and switches one pointer to them,
+// so a report never has to look at the settings themselves.
+//
+// Changes are written back to flash a few seconds after the last one,
+// each time into the next page of a small log, so that the flash is
+// erased only once every several saves.
+//--------------------------------------------------------------------+
+
+#define SETTINGS_PROFILES     4
+
+// Profile flags
+//
+#define SETTINGS_MID_SWAP     0x01    // the middle button swaps I and II
+#define SETTINGS_WHEEL_CURVE  0x02    // the scroll wheel steps through the curves
+
+// Mouse buttons, in USB bit order (for the button map)
+//
+#define SETTINGS_USB_LEFT     0
+#define SETTINGS_USB_RIGHT    1
+#define SETTINGS_USB_MIDDLE   2
+#define SETTINGS_USB_BACKWARD 3
+#define SETTINGS_USB_FORWARD  4
+#define SETTINGS_USB_BUTTONS  5
+
+typedef struct __attribute__((packed))
+{
+  uint8_t curve[ACCEL_KINDS];         // curve selection, per kind of pointing device
+  uint8_t flags;
+  uint8_t mouse_map[4];               // USB mouse button for I, II, Select, Run
+  uint8_t pad_map[PAD_BUTTONS];       // HID gamepad button for I, II, Select, Run, III..VI
+} settings_profile_t;
+
+typedef struct __attribute__((packed))
+{
+  uint8_t            profile;         // the one in use
+  uint16_t           reset_us;        // scan timeouts (0 = learned from the console)
+  uint16_t           escape_us;
+  settings_profile_t profiles[SETTINGS_PROFILES];
+} settings_t;
+
+// What the report path reads, once per report
+//
+typedef struct
+{
+  uint8_t  mouse_buttons[2][1 << SETTINGS_USB_BUTTONS];   // [swapped][USB buttons] -> PCE buttons
+  uint32_t pad_mask[PAD_BUTTONS];     // HID button bits for I, II, Select, Run...
+  bool     mid_swap;
+  bool     wheel_curve;
+} settings_run_t;
+
+extern settings_t settings;
+extern const settings_run_t *settings_run;
+
+void settings_init(void);
+void settings_task(void);
+void settings_command(int c);
+void settings_set_curve(accel_kind_t kind, int curve);
+
+#endif /* _SETTINGS_H_ */
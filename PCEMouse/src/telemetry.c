@@ -0,0 +1,298 @@
+/*
+ * telemetry.c - latency and motion-loss measurement for PCEMouse
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+
+#include "telemetry.h"
+#include "scansync.h"
+
+#ifdef TELEMETRY
+
+extern uint32_t motion_clipped;
+extern uint32_t motion_dropped;
+
+RING_DEFINE(telem_core0, telem_event_t, 256);   // reports; up to 1000/sec
+RING_DEFINE(telem_core1, telem_event_t, 64);    // scans; ~60/sec
+
+#define TELEM_DRAIN_MAX      32         // events folded in per call (bounds the time taken)
+#define TELEM_IDLE_US        20000      // report gaps longer than this are idle, not jitter
+
+typedef struct
+{
+  uint32_t bucket[TELEM_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t sum_us;
+} telem_hist_t;
+
+// latency from a report's arrival until the console reads it:
+//   newest = the most recent report in the packet (best case)
+//   oldest = the earliest motion still waiting in the packet (worst case)
+//
+static telem_hist_t hist_newest;
+static telem_hist_t hist_oldest;
+
+static uint32_t reports;
+static uint32_t report_prev_us;
+static uint32_t interval_prev;
+static uint32_t interval_min;
+static uint32_t interval_max;
+static uint64_t interval_sum;
+static uint64_t jitter_sum;         // sum of |interval - previous interval|
+static uint32_t intervals;
+static uint32_t idle_gaps;
+
+static uint32_t scans;
+static uint32_t scans_with_motion;
+static uint32_t second_start_us;
+static uint32_t second_scans;
+static uint32_t sps_last;
+static uint32_t sps_min;
+static uint32_t sps_max;
+static bool     second_started;
+
+static uint32_t clipped_base;        // counters owned elsewhere are reported
+static uint32_t dropped_base;        // relative to when the statistics were cleared
+static uint32_t lost0_base;
+static uint32_t lost1_base;
+
+
+static void telem_hist_add(telem_hist_t *h, uint32_t us)
+{
+  uint32_t i = us / TELEM_HIST_STEP_US;
+
+  if (i >= TELEM_HIST_BUCKETS)
+    i = TELEM_HIST_BUCKETS - 1;
+
+  h->bucket[i]++;
+  h->count++;
+  h->sum_us += us;
+  if (us > h->max_us)
+    h->max_us = us;
+}
+
+// the bucket holding the given percentile
+static int telem_hist_percentile(const telem_hist_t *h, uint32_t percent)
+{
+  uint32_t target = (uint32_t)(((uint64_t)h->count * percent + 99) / 100);
+  uint32_t seen = 0;
+  int i;
+
+  for (i = 0; i < TELEM_HIST_BUCKETS; i++)
+  {
+    seen += h->bucket[i];
+    if (seen >= target)
+      break;
+  }
+  return i;
+}
+
+// a percentile is below the upper edge of its bucket, except in the last
+// bucket (which has no upper edge), where it is only known to be above the lower edge
+static void telem_print_percentile(const telem_hist_t *h, uint32_t percent)
+{
+  int i = telem_hist_percentile(h, percent);
+
+  if (i >= TELEM_HIST_BUCKETS - 1)
+    printf(" p%lu>=%luus", (unsigned long)percent, (unsigned long)((TELEM_HIST_BUCKETS - 1) * TELEM_HIST_STEP_US));
+  else
+    printf(" p%lu<%luus", (unsigned long)percent, (unsigned long)((i + 1) * TELEM_HIST_STEP_US));
+}
+
+void telemetry_init(void)
+{
+  int i;
+
+  for (i = 0; i < TELEM_HIST_BUCKETS; i++)
+  {
+    hist_newest.bucket[i] = 0;
+    hist_oldest.bucket[i] = 0;
+  }
+  hist_newest.count = hist_oldest.count = 0;
+  hist_newest.max_us = hist_oldest.max_us = 0;
+  hist_newest.sum_us = hist_oldest.sum_us = 0;
+
+  reports = 0;
+  interval_prev = 0;
+  interval_min = 0xffffffff;
+  interval_max = 0;
+  interval_sum = 0;
+  jitter_sum = 0;
+  intervals = 0;
+  idle_gaps = 0;
+
+  scans = 0;
+  scans_with_motion = 0;
+  second_started = false;
+  second_scans = 0;
+  sps_last = 0;
+  sps_min = 0xffffffff;
+  sps_max = 0;
+
+  clipped_base = motion_clipped;
+  dropped_base = motion_dropped;
+
+  lost0_base = telem_core0.dropped;
+  lost1_base = telem_core1.dropped;
+}
+
+static void telem_fold_report(const telem_event_t *ev)
+{
+  uint32_t interval = ev->t_us - report_prev_us;
+
+  report_prev_us = ev->t_us;
+
+  if (reports++ == 0)
+    return;
+
+  if (interval > TELEM_IDLE_US)
+  {
+    idle_gaps++;
+    interval_prev = 0;
+    return;
+  }
+
+  if (interval < interval_min)
+    interval_min = interval;
+  if (interval > interval_max)
+    interval_max = interval;
+
+  interval_sum += interval;
+  if (interval_prev != 0)
+  {
+    jitter_sum += (interval > interval_prev) ? (interval - interval_prev) : (interval_prev - interval);
+    intervals++;
+  }
+  interval_prev = interval;
+}
+
+static void telem_fold_scan(const telem_event_t *ev)
+{
+  // scans per second, in whole one-second windows
+  if (!second_started)
+  {
+    second_started = true;
+    second_start_us = ev->t_us;
+    second_scans = 0;
+  }
+  else if ((ev->t_us - second_start_us) >= 1000000)
+  {
+    sps_last = second_scans;
+    if (sps_last < sps_min)
+      sps_min = sps_last;
+    if (sps_last > sps_max)
+      sps_max = sps_last;
+
+    second_start_us = ((ev->t_us - second_start_us) < 2000000) ? (second_start_us + 1000000) : ev->t_us;
+    second_scans = 0;
+  }
+  second_scans++;
+  scans++;
+
+  if (ev->dx || ev->dy)
+  {
+    scans_with_motion++;
+    telem_hist_add(&hist_newest, ev->t_us - ev->newest_us);
+    telem_hist_add(&hist_oldest, ev->t_us - ev->oldest_us);
+  }
+}
+
+static void telem_print_hist(const char *name, const telem_hist_t *h)
+{
+  int i;
+
+  if (h->count == 0)
+  {
+    printf("%s: no samples\r\n", name);
+    return;
+  }
+
+  printf("%s: n=%lu avg=%luus", name,
+         (unsigned long)h->count, (unsigned long)(h->sum_us / h->count));
+  telem_print_percentile(h, 50);
+  telem_print_percentile(h, 99);
+  printf(" max=%luus\r\n", (unsigned long)h->max_us);
+
+  for (i = 0; i < TELEM_HIST_BUCKETS; i++)
+  {
+    if (h->bucket[i] == 0)
+      continue;
+    printf("  %5u-%5uus%s %lu\r\n", i * TELEM_HIST_STEP_US, (i + 1) * TELEM_HIST_STEP_US,
+           (i == TELEM_HIST_BUCKETS - 1) ? "+" : " ", (unsigned long)h->bucket[i]);
+  }
+}
+
+static void telem_print(void)
+{
+  printf("\r\n--- telemetry ---\r\n");
+
+  printf("scans: %lu (%lu with motion); per second: last=%lu min=%lu max=%lu\r\n",
+         (unsigned long)scans, (unsigned long)scans_with_motion, (unsigned long)sps_last,
+         (unsigned long)((sps_min == 0xffffffff) ? 0 : sps_min), (unsigned long)sps_max);
+
+  printf("scan sync: %s, period=%luus\r\n", scansync.locked ? "locked" : "unlocked",
+         (unsigned long)scansync.period_us);
+
+  printf("scan timing: gap=%luus read=%luus -> reset=%ldus escape=%ldus%s\r\n",
+         (unsigned long)scansync.gap_us, (unsigned long)scansync.hold_us,
+         (long)scansync.reset_us, (long)scansync.escape_us,
+         (scansync.bursts < SCANSYNC_CALIB_BURSTS) ? " (calibrating)" : "");
+
+  telem_print_hist("latency (newest)", &hist_newest);
+  telem_print_hist("latency (oldest)", &hist_oldest);
+
+  if (reports > 1)
+  {
+    printf("reports: %lu; interval min=%luus avg=%luus max=%luus jitter=%luus; idle gaps=%lu\r\n",
+           (unsigned long)reports,
+           (unsigned long)((interval_min == 0xffffffff) ? 0 : interval_min),
+           (unsigned long)((reports - idle_gaps > 1) ? (interval_sum / (reports - idle_gaps - 1)) : 0),
+           (unsigned long)interval_max,
+           (unsigned long)(intervals ? (jitter_sum / intervals) : 0),
+           (unsigned long)idle_gaps);
+  }
+  else
+  {
+    printf("reports: %lu\r\n", (unsigned long)reports);
+  }
+
+  printf("motion: clipped scans=%lu, dropped reports=%lu\r\n",
+         (unsigned long)(motion_clipped - clipped_base), (unsigned long)(motion_dropped - dropped_base));
+
+  printf("events lost: core0=%lu core1=%lu\r\n",
+         (unsigned long)(telem_core0.dropped - lost0_base),
+         (unsigned long)(telem_core1.dropped - lost1_base));
+}
+
+//
+// telemetry_task - fold queued events into the statistics;
+//                  called from the core 0 main loop
+//
+void telemetry_task(void)
+{
+  telem_event_t ev;
+  int n;
+
+  for (n = 0; (n < TELEM_DRAIN_MAX) && ring_get(&telem_core0, &ev); n++)
+    telem_fold_report(&ev);
+
+  for (n = 0; (n < TELEM_DRAIN_MAX) && ring_get(&telem_core1, &ev); n++)
+    telem_fold_scan(&ev);
+}
+
+//
+// telemetry_command - console commands: 't' prints, 'c' clears
+//
+void telemetry_command(int c)
+{
+  if ((c == 't') || (c == 'T'))
+    telem_print();
+  else if ((c == 'c') || (c == 'C'))
+    telemetry_init();
+}
+
+#endif
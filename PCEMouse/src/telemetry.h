@@ -0,0 +1,75 @@
+/*
+ * telemetry.h - latency and motion-loss measurement for PCEMouse
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ring.h"
+
+// Comment out the following line to compile the telemetry out entirely:
+#define TELEMETRY  true
+
+//--------------------------------------------------------------------+
+// Hot-path code only timestamps an event and puts it into a ring (one
+// ring per core, so each has a single producer): core 0 records each USB
+// report as it is posted, and core 1 records the start of each scan.
+//
+// telemetry_task() runs in the idle part of the core 0 loop, folds the
+// events into statistics, and prints them when asked to over the UART
+// console ('t' = print, 'c' = clear). The USB port is in host mode, so
+// there is no CDC channel.
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  uint32_t t_us;
+  uint32_t newest_us;   // scan: arrival of the newest report in the packet
+  uint32_t oldest_us;   // scan: arrival of the oldest motion in the packet
+  int16_t  dx;          // report: scaled deltas; scan: motion sent
+  int16_t  dy;
+} telem_event_t;
+
+#define TELEM_HIST_BUCKETS   64
+#define TELEM_HIST_STEP_US   250     // last bucket also holds anything longer
+
+#ifdef TELEMETRY
+
+extern ring_t telem_core0;
+extern ring_t telem_core1;
+
+void telemetry_init(void);
+void telemetry_task(void);
+void telemetry_command(int c);
+
+static inline void telemetry_report(uint32_t now_us, int16_t dx, int16_t dy)
+{
+  telem_event_t ev = { now_us, 0, 0, dx, dy };
+  ring_put(&telem_core0, &ev);
+}
+
+static inline void telemetry_scan(uint32_t now_us, uint32_t newest_us, uint32_t oldest_us,
+                                  int16_t dx, int16_t dy)
+{
+  telem_event_t ev = { now_us, newest_us, oldest_us, dx, dy };
+  ring_put(&telem_core1, &ev);
+}
+
+#else
+
+static inline void telemetry_init(void) { }
+static inline void telemetry_task(void) { }
+static inline void telemetry_command(int c) { }
+static inline void telemetry_report(uint32_t now_us, int16_t dx, int16_t dy) { }
+static inline void telemetry_scan(uint32_t now_us, uint32_t newest_us, uint32_t oldest_us,
+                                  int16_t dx, int16_t dy) { }
+
+#endif
+
+#endif /* _TELEMETRY_H_ */
@@ -0,0 +1,24 @@
+/*
+ * hardware/clocks.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_CLOCKS_H_
+#define _SIM_HARDWARE_CLOCKS_H_
+
+#include "pico/types.h"
+
+// The simulator runs at SIM_CLOCK_HZ only; asking for any other clock
+// fails, as an impossible one would on the board
+//
+enum clock_index
+{
+  clk_sys = 5,
+};
+
+uint32_t clock_get_hz(enum clock_index clk_index);
+bool     set_sys_clock_khz(uint32_t freq_khz, bool required);
+
+#endif /* _SIM_HARDWARE_CLOCKS_H_ */
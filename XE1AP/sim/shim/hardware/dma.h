@@ -0,0 +1,103 @@
+/*
+ * hardware/dma.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_DMA_H_
+#define _SIM_HARDWARE_DMA_H_
+
+#include <stdint.h>
+
+#include "pico/types.h"
+
+//--------------------------------------------------------------------+
+// DMA channels are stepped with the PIO blocks, one transfer per cycle
+// (see sim_dma.c). Only the registers which the firmware touches are
+// here; the address registers are pointer-sized, as a host pointer does
+// not fit in 32 bits (so a channel writing into one of them moves a whole
+// pointer, where the RP2040 moves a word).
+//--------------------------------------------------------------------+
+
+#define NUM_DMA_CHANNELS    12
+
+#define DREQ_FORCE          0x3f
+
+enum dma_channel_transfer_size
+{
+  DMA_SIZE_8 = 0,
+  DMA_SIZE_16 = 1,
+  DMA_SIZE_32 = 2
+};
+
+typedef struct
+{
+  volatile uintptr_t read_addr;
+  volatile uintptr_t write_addr;
+  volatile uint32_t  transfer_count;
+  volatile uintptr_t al3_read_addr_trig;
+} dma_channel_hw_t;
+
+typedef struct
+{
+  dma_channel_hw_t  ch[NUM_DMA_CHANNELS];
+  volatile uint32_t ints0;              // write 1s to clear
+} dma_hw_t;
+
+extern dma_hw_t sim_dma_hw;
+
+#define dma_hw  (&sim_dma_hw)
+
+typedef struct
+{
+  uint8_t data_size;
+  bool    read_increment;
+  bool    write_increment;
+  uint8_t dreq;
+  uint8_t chain_to;           // itself: no chaining
+  bool    enable;
+} dma_channel_config;
+
+dma_channel_config dma_channel_get_default_config(uint channel);
+
+static inline void channel_config_set_transfer_data_size(dma_channel_config *c, enum dma_channel_transfer_size size)
+{
+  c->data_size = size;
+}
+
+static inline void channel_config_set_read_increment(dma_channel_config *c, bool incr)
+{
+  c->read_increment = incr;
+}
+
+static inline void channel_config_set_write_increment(dma_channel_config *c, bool incr)
+{
+  c->write_increment = incr;
+}
+
+static inline void channel_config_set_dreq(dma_channel_config *c, uint dreq)
+{
+  c->dreq = dreq;
+}
+
+static inline void channel_config_set_chain_to(dma_channel_config *c, uint chain_to)
+{
+  c->chain_to = chain_to;
+}
+
+static inline void channel_config_set_enable(dma_channel_config *c, bool enable)
+{
+  c->enable = enable;
+}
+
+int  dma_claim_unused_channel(bool required);
+void dma_channel_unclaim(uint channel);
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger);
+void dma_channel_set_irq0_enabled(uint channel, bool enabled);
+void dma_channel_start(uint channel);
+void dma_channel_abort(uint channel);
+bool dma_channel_is_busy(uint channel);
+
+#endif /* _SIM_HARDWARE_DMA_H_ */
@@ -0,0 +1,24 @@
+/*
+ * hardware/irq.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_IRQ_H_
+#define _SIM_HARDWARE_IRQ_H_
+
+#include "pico/types.h"
+
+// A handler runs as soon as its interrupt is raised, and takes no time
+// (see sim_dma.c)
+//
+#define DMA_IRQ_0   11
+#define DMA_IRQ_1   12
+
+typedef void (*irq_handler_t)(void);
+
+void irq_set_exclusive_handler(uint num, irq_handler_t handler);
+void irq_set_enabled(uint num, bool enabled);
+
+#endif /* _SIM_HARDWARE_IRQ_H_ */
@@ -0,0 +1,26 @@
+/*
+ * hardware/vreg.h - simulator stand-in for the Pico SDK header of the same name
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_HARDWARE_VREG_H_
+#define _SIM_HARDWARE_VREG_H_
+
+enum vreg_voltage
+{
+  VREG_VOLTAGE_1_05 = 0b1010,
+  VREG_VOLTAGE_1_10 = 0b1011,
+  VREG_VOLTAGE_1_15 = 0b1100,
+  VREG_VOLTAGE_1_20 = 0b1101,
+  VREG_VOLTAGE_1_25 = 0b1110,
+  VREG_VOLTAGE_1_30 = 0b1111,
+};
+
+static inline void vreg_set_voltage(enum vreg_voltage voltage)
+{
+  (void)voltage;
+}
+
+#endif /* _SIM_HARDWARE_VREG_H_ */
@@ -0,0 +1,57 @@
+/*
+ * tusb.h - simulator stand-in for the TinyUSB host API used by the XE1AP
+ *          firmware
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_TUSB_H_
+#define _SIM_TUSB_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//--------------------------------------------------------------------+
+// The controller is simulated (see sim_usb.c): tuh_task() mounts it and
+// delivers its reports through the same callbacks which TinyUSB would
+// invoke. This stands in for the TinyUSB of Pico-SDK 1.5.0, so the
+// XInput driver is left out, as it is on the board (see xinput.h).
+//--------------------------------------------------------------------+
+
+#define TUSB_VERSION_MAJOR    0
+#define TUSB_VERSION_MINOR    15
+#define TUSB_VERSION_REVISION 0
+
+#define OPT_MCU_LPC18XX       6
+#define OPT_MCU_LPC43XX       7
+#define OPT_MCU_MIMXRT10XX    11
+#define OPT_MCU_RP2040        1100
+#define CFG_TUSB_MCU          OPT_MCU_RP2040
+
+#define OPT_OS_NONE           1
+#define OPT_MODE_HOST         0x0002
+#define OPT_MODE_HIGH_SPEED   0x0400
+
+#include "tusb_config.h"
+
+#define TU_ATTR_PACKED        __attribute__((packed))
+#define TU_ATTR_WEAK          __attribute__((weak))
+
+#define TU_LOG1(...)
+#define TU_LOG2(...)
+
+bool    tusb_init(void);
+void    tuh_task(void);
+
+bool    tuh_vid_pid_get(uint8_t dev_addr, uint16_t *vid, uint16_t *pid);
+bool    tuh_hid_receive_report(uint8_t dev_addr, uint8_t instance);
+
+// implemented by the firmware
+void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *desc_report, uint16_t desc_len);
+void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance);
+void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const *report, uint16_t len);
+
+#endif /* _SIM_TUSB_H_ */
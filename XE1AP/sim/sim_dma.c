@@ -0,0 +1,354 @@
+/*
+ * sim_dma.c - DMA channels and interrupts, and the clock functions, for the
+ *             XE1AP simulator
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_xe1ap.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/pio.h"
+
+//--------------------------------------------------------------------+
+// A channel, once triggered, makes one transfer per cycle while its DREQ
+// allows (only one channel transfers in any cycle, taking turns), and
+// on its last transfer raises its interrupt and triggers its chain_to
+// channel, which starts transferring in the next cycle. Reads from a PIO
+// RX FIFO and writes to a TX FIFO go to the state machine; writes to a
+// channel's registers set them (and a trigger register starts it).
+//
+// This is quicker than the RP2040's DMA by a few cycles per transfer,
+// which shows only as a shorter delay from CLR to the first phase.
+//--------------------------------------------------------------------+
+
+#define INTS_MARKER     0x80000000u     // (no channel has this bit; see raise())
+
+typedef struct
+{
+  bool               claimed;
+  dma_channel_config cfg;
+  uint32_t           reload;            // transfer count at each trigger
+  bool               irq0;
+} sim_dma_ch_t;
+
+dma_hw_t sim_dma_hw;
+
+static sim_dma_ch_t  chan[NUM_DMA_CHANNELS];
+static uint          turn = 0;          // next channel to look at first
+
+static irq_handler_t handler[32];
+static bool          irq_enabled[32];
+static uint32_t      ints0;             // raised and not yet cleared
+
+static uint32_t      unacknowledged = 0;
+
+
+//--------------------------------------------------------------------+
+// Addresses
+//--------------------------------------------------------------------+
+
+static bool pio_fifo(uintptr_t addr, bool tx, PIO *pio, uint *sm)
+{
+  static PIO const pios[NUM_PIOS] = { pio0, pio1 };
+  int p, i;
+
+  for (p = 0; p < NUM_PIOS; p++)
+    for (i = 0; i < NUM_PIO_STATE_MACHINES; i++)
+      if (addr == (uintptr_t)(tx ? &pios[p]->txf[i] : &pios[p]->rxf[i]))
+      {
+        *pio = pios[p];
+        *sm = i;
+        return true;
+      }
+
+  return false;
+}
+
+static bool dma_register(uintptr_t addr)
+{
+  return (addr >= (uintptr_t)&sim_dma_hw.ch[0]) && (addr < (uintptr_t)&sim_dma_hw.ch[NUM_DMA_CHANNELS]);
+}
+
+static bool dreq_ready(uint dreq)
+{
+  PIO pio = (dreq & 8) ? pio1 : pio0;
+  uint sm = dreq & 3;
+
+  if (dreq == DREQ_FORCE)
+    return true;
+  if (dreq >= 16)
+    return false;                       // (nothing else is simulated)
+
+  return (dreq & 4) ? !pio_sm_is_rx_fifo_empty(pio, sm) : !pio_sm_is_tx_fifo_full(pio, sm);
+}
+
+//--------------------------------------------------------------------+
+// Channels
+//--------------------------------------------------------------------+
+
+static void trigger(uint ch)
+{
+  sim_dma_hw.ch[ch].transfer_count = chan[ch].reload;
+}
+
+static inline bool busy(uint ch)
+{
+  return chan[ch].cfg.enable && (sim_dma_hw.ch[ch].transfer_count > 0);
+}
+
+static void register_write(uintptr_t addr, uintptr_t v)
+{
+  uint ch = (addr - (uintptr_t)&sim_dma_hw.ch[0]) / sizeof(dma_channel_hw_t);
+  dma_channel_hw_t *hw = &sim_dma_hw.ch[ch];
+
+  if (addr == (uintptr_t)&hw->read_addr)
+    hw->read_addr = v;
+  else if (addr == (uintptr_t)&hw->write_addr)
+    hw->write_addr = v;
+  else if (addr == (uintptr_t)&hw->transfer_count)
+    chan[ch].reload = (uint32_t)v;
+  else if (addr == (uintptr_t)&hw->al3_read_addr_trig)
+  {
+    hw->read_addr = v;
+    trigger(ch);
+  }
+}
+
+//
+// raise - a channel's interrupt: the handler runs at once; it must clear
+//         the channel's bit in ints0 (the marker shows whether it wrote)
+//
+static void raise(uint ch)
+{
+  uint32_t written;
+
+  ints0 |= 1u << ch;
+
+  if (!irq_enabled[DMA_IRQ_0] || (handler[DMA_IRQ_0] == NULL))
+    return;
+
+  sim_dma_hw.ints0 = ints0 | INTS_MARKER;
+  handler[DMA_IRQ_0]();
+
+  written = (sim_dma_hw.ints0 & INTS_MARKER) ? 0 : sim_dma_hw.ints0;
+  ints0 &= ~written;
+
+  // (on the board, the handler would be entered again and again)
+  if (ints0 != 0)
+  {
+    unacknowledged++;
+    ints0 = 0;
+  }
+  sim_dma_hw.ints0 = ints0;
+}
+
+static void transfer(uint ch)
+{
+  dma_channel_hw_t *hw = &sim_dma_hw.ch[ch];
+  dma_channel_config *c = &chan[ch].cfg;
+  uint size = 1u << c->data_size;
+  uintptr_t v = 0;
+  PIO pio;
+  uint sm;
+
+  // (a pointer, into a channel's registers; see hardware/dma.h)
+  if (dma_register(hw->write_addr))
+    size = sizeof(uintptr_t);
+
+  if (pio_fifo(hw->read_addr, false, &pio, &sm))
+    v = pio_sm_get(pio, sm);
+  else
+    memcpy(&v, (const void *)hw->read_addr, size);
+
+  if (pio_fifo(hw->write_addr, true, &pio, &sm))
+    pio_sm_put(pio, sm, (uint32_t)v);
+  else if (dma_register(hw->write_addr))
+    register_write(hw->write_addr, v);
+  else
+    memcpy((void *)hw->write_addr, &v, size);
+
+  if (c->read_increment)
+    hw->read_addr += size;
+  if (c->write_increment)
+    hw->write_addr += size;
+
+  if (--hw->transfer_count > 0)
+    return;
+
+  if (chan[ch].irq0)
+    raise(ch);
+
+  if (c->chain_to != ch)
+    trigger(c->chain_to);
+}
+
+//
+// sim_dma_cycle - one cycle of the DMA: true while a channel can still
+//                 transfer (or might, in the next cycle)
+//
+bool sim_dma_cycle(void)
+{
+  uint i, ch;
+
+  for (i = 0; i < NUM_DMA_CHANNELS; i++)
+  {
+    ch = (turn + i) % NUM_DMA_CHANNELS;
+
+    if (busy(ch) && dreq_ready(chan[ch].cfg.dreq))
+    {
+      transfer(ch);
+      turn = ch + 1;
+      break;
+    }
+  }
+
+  for (ch = 0; ch < NUM_DMA_CHANNELS; ch++)
+    if (busy(ch) && dreq_ready(chan[ch].cfg.dreq))
+      return true;
+
+  return false;
+}
+
+uint32_t sim_dma_unacknowledged(void)
+{
+  return unacknowledged;
+}
+
+//--------------------------------------------------------------------+
+// SDK functions
+//--------------------------------------------------------------------+
+
+static sim_dma_ch_t *get_ch(uint ch)
+{
+  if (ch >= NUM_DMA_CHANNELS)
+  {
+    fprintf(stderr, "sim: bad DMA channel %u\n", ch);
+    exit(1);
+  }
+  return &chan[ch];
+}
+
+int dma_claim_unused_channel(bool required)
+{
+  int i;
+
+  for (i = 0; i < NUM_DMA_CHANNELS; i++)
+    if (!chan[i].claimed)
+    {
+      chan[i].claimed = true;
+      return i;
+    }
+
+  if (required)
+  {
+    fprintf(stderr, "sim: no free DMA channel\n");
+    exit(1);
+  }
+  return -1;
+}
+
+void dma_channel_unclaim(uint channel)
+{
+  get_ch(channel)->claimed = false;
+}
+
+dma_channel_config dma_channel_get_default_config(uint channel)
+{
+  dma_channel_config c;
+
+  memset(&c, 0, sizeof(c));
+  c.data_size = DMA_SIZE_32;
+  c.read_increment = true;
+  c.write_increment = false;
+  c.dreq = DREQ_FORCE;
+  c.chain_to = channel;
+  c.enable = true;
+  return c;
+}
+
+void dma_channel_configure(uint channel, const dma_channel_config *config, volatile void *write_addr,
+                           const volatile void *read_addr, uint transfer_count, bool trigger_now)
+{
+  sim_dma_ch_t *c = get_ch(channel);
+
+  sim_sync(SIM_CALL_CYCLES);
+
+  c->cfg = *config;
+  c->reload = transfer_count;
+  sim_dma_hw.ch[channel].write_addr = (uintptr_t)write_addr;
+  sim_dma_hw.ch[channel].read_addr = (uintptr_t)read_addr;
+
+  if (trigger_now)
+    dma_channel_start(channel);
+}
+
+void dma_channel_set_irq0_enabled(uint channel, bool enabled)
+{
+  get_ch(channel)->irq0 = enabled;
+}
+
+void dma_channel_start(uint channel)
+{
+  get_ch(channel);
+
+  sim_sync(SIM_CALL_CYCLES);
+  sim_pio_disturb();                    // (the DMA has something to do)
+  trigger(channel);
+}
+
+void dma_channel_abort(uint channel)
+{
+  get_ch(channel);
+
+  sim_sync(SIM_CALL_CYCLES);
+  sim_dma_hw.ch[channel].transfer_count = 0;
+}
+
+bool dma_channel_is_busy(uint channel)
+{
+  get_ch(channel);
+
+  sim_sync(SIM_CALL_CYCLES);
+  return busy(channel);
+}
+
+void irq_set_exclusive_handler(uint num, irq_handler_t h)
+{
+  handler[num & 31] = h;
+}
+
+void irq_set_enabled(uint num, bool enabled)
+{
+  irq_enabled[num & 31] = enabled;
+}
+
+//--------------------------------------------------------------------+
+// hardware/clocks.h
+//--------------------------------------------------------------------+
+
+uint32_t clock_get_hz(enum clock_index clk_index)
+{
+  (void)clk_index;
+
+  return SIM_CLOCK_HZ;
+}
+
+bool set_sys_clock_khz(uint32_t freq_khz, bool required)
+{
+  if ((uint64_t)freq_khz * 1000 == SIM_CLOCK_HZ)
+    return true;
+
+  if (required)
+  {
+    fprintf(stderr, "sim: only %d kHz is simulated\n", SIM_CLOCK_HZ / 1000);
+    exit(1);
+  }
+  return false;
+}
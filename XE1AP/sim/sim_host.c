@@ -0,0 +1,753 @@
+/*
+ * sim_host.c - the console side: starts a frame now and then, and either
+ *              records the pins for the whole frame or reads it as a game
+ *              would; each frame is checked against the reference model
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_xe1ap.h"
+
+//--------------------------------------------------------------------+
+// Each frame starts with a pulse on CLR (the frame starts as it rises)
+// or, on the MSX board, on REQ (as it falls). The frames take turns at:
+//
+// - scope: the pins are recorded for the whole frame with SEL held low
+//   (TRG1/TRG2 and Run/Select) or high (the data). Every change must be
+//   one of the reference model's, in order, and none may be missing; the
+//   edges may all come late by the same delay (the DMA chain's, up to
+//   START_MAX) but each one must land within EDGE_TOL of the model's
+//   time for it, after that delay.
+//
+// - read: TRG1/TRG2 are polled (at random intervals, up to poll_ns apart)
+//   until they show each nybble ready; then SEL is raised, the data read
+//   after sel_delay_ns, and SEL dropped again. The data must settle within
+//   SEL_MAX of each SEL change.
+//
+// The MSX board has no SEL, so both are done with everything visible.
+//
+// - scan (PC Engine; every 4th run of pad_frames frames): read as a game
+//   reads a joypad: CLR, which then idles low, is pulsed high; the
+//   directions are read with SEL high, then the buttons with SEL low. The
+//   firmware must have switched to digital mode for this, and back again
+//   after; the first frame read either way after a change may be lost (it
+//   is the one the firmware sees the change by), but no other.
+//
+// Each frame must be the one from the newest report which the firmware
+// had published at the start of the frame, or one published just after
+// it (while the DMA chain was picking up the frame).
+//--------------------------------------------------------------------+
+
+#define START_MAX       SIM_US(1)               // frame start to the first change
+#define EDGE_TOL        ((SIM_CYCLES_PER_US * 100) / 1000 + 1)  // 100ns, as frame.c
+#define SEL_MAX         ((SIM_CYCLES_PER_US * 150) / 1000)      // SEL change to the data settled
+#define READ_TIMEOUT    SIM_US(600)             // frame start to the last nybble read
+#define SCOPE_TAIL      SIM_US(20)              // recorded beyond the last phase
+
+#define WAVE_MAX        1024
+#define TRACE_ERRORS    10
+
+enum
+{
+  MODE_SCOPE_LOW = 0,               // (MSX: everything)
+  MODE_SCOPE_HIGH,
+  MODE_READ,
+};
+
+#if XE1AP_HOST_MSX
+#define WAVE_MASK       0xF3        // TRG1/TRG2, and the data in bits 4-7
+static const int modes[] = { MODE_SCOPE_LOW, MODE_READ };
+#else
+#define WAVE_MASK       0x0F        // D0-D3 (SEL is bit 4)
+static const int modes[] = { MODE_SCOPE_LOW, MODE_SCOPE_HIGH, MODE_READ };
+#endif
+
+#define MODES           (sizeof(modes) / sizeof(modes[0]))
+
+typedef struct
+{
+  sim_time_t t;
+  uint8_t    v;
+} sim_wave_t;
+
+sim_host_cfg_t sim_host_cfg =
+{
+  .frames       = 120,
+  .frame_us     = 16683,
+  .pulse_ns     = 2000,
+  .poll_ns      = 2000,
+  .sel_delay_ns = 1000,
+  .pad_frames   = 10,
+  .scan_pulse_ns = 1000,
+  .trace        = false,
+};
+
+static sim_time_t host_t;
+static bool       done = false;
+
+static sim_ref_phase_t phases[REF_PHASES_MAX];
+static int             phase_count;
+
+static sim_wave_t wave[WAVE_MAX];
+static int        wave_count;
+static bool       wave_on = false;
+static bool       wave_overflow = false;
+
+// results
+static uint32_t scoped = 0;
+static uint32_t scoped_bad = 0;
+static uint32_t reads = 0;
+static uint32_t reads_bad = 0;
+static uint32_t reads_timeout = 0;
+#if !XE1AP_HOST_MSX
+static uint32_t scans = 0;
+#endif
+static uint32_t scans_bad = 0;
+static uint32_t raced = 0;          // frames from the report published just after the edge
+static uint32_t errors = 0;
+static uint32_t switches = 0;       // between reading the XE-1AP protocol and a joypad
+static uint32_t lost = 0;           // frames lost at a switch (at most one each)
+
+static bool     at_switch = false;  // this frame is the first since a switch
+
+static sim_time_t delay_min = SIM_NEVER;
+static sim_time_t delay_max = 0;
+static sim_time_t spread_max = 0;
+static sim_time_t sel_max = 0;
+
+
+//--------------------------------------------------------------------+
+// Pins
+//--------------------------------------------------------------------+
+
+static uint8_t pins_now(void)
+{
+  uint8_t v = 0;
+  int i;
+
+#if XE1AP_HOST_MSX
+  v = sim_pin_level(TRG1_PIN) | (sim_pin_level(TRG1_PIN + 1) << 1);
+  for (i = 0; i < 4; i++)
+    v |= sim_pin_level(DATA0_PIN + i) << (4 + i);
+#else
+  for (i = 0; i < 4; i++)
+    v |= sim_pin_level(OUTD0_PIN + i) << i;
+  v |= sim_pin_level(SEL_PIN) << 4;
+#endif
+
+  return v;
+}
+
+void sim_wave_cycle(void)
+{
+  uint8_t v;
+
+  if (!wave_on)
+    return;
+
+  v = pins_now();
+  if (v == wave[wave_count - 1].v)
+    return;
+
+  if (wave_count == WAVE_MAX)
+  {
+    wave_overflow = true;
+    return;
+  }
+
+  // (the hook runs at the end of the cycle)
+  wave[wave_count].t = sim_now + 1;
+  wave[wave_count].v = v;
+  wave_count++;
+}
+
+static void wave_start(void)
+{
+  wave[0].t = sim_now;
+  wave[0].v = pins_now();
+  wave_count = 1;
+  wave_on = true;
+}
+
+//--------------------------------------------------------------------+
+// Console timing
+//--------------------------------------------------------------------+
+
+static void host_wait(sim_time_t cycles)
+{
+  host_t += cycles;
+  sim_sleep_until(host_t);
+}
+
+static inline sim_time_t ns(uint32_t n)
+{
+  return ((sim_time_t)n * SIM_CYCLES_PER_US + 999) / 1000;
+}
+
+static inline double us(sim_time_t cycles)
+{
+  return cycles / (double)SIM_CYCLES_PER_US;
+}
+
+// returns the time the frame starts
+//
+static sim_time_t pulse(void)
+{
+  sim_time_t t0;
+
+#if XE1AP_HOST_MSX
+  sim_pin_drive(REQ_PIN, false);
+  t0 = host_t;
+  host_wait(ns(sim_host_cfg.pulse_ns));
+  sim_pin_drive(REQ_PIN, true);
+#else
+  sim_pin_drive(CLR_PIN, false);
+  host_wait(ns(sim_host_cfg.pulse_ns));
+  sim_pin_drive(CLR_PIN, true);
+  t0 = host_t;
+#endif
+
+  return t0;
+}
+
+//--------------------------------------------------------------------+
+// Checks
+//--------------------------------------------------------------------+
+
+// what the recorded pins should show during a phase
+//
+static uint8_t expected_pins(const sim_ref_phase_t *ph, const uint8_t nyb[], uint8_t rs, int mode)
+{
+#if XE1AP_HOST_MSX
+  (void)rs;
+  (void)mode;
+  return ph->trg | (sim_ref_pins(nyb[ph->nybble]) << 4);
+#else
+  return (mode == MODE_SCOPE_HIGH) ? sim_ref_pins(nyb[ph->nybble]) : (ph->trg | rs);
+#endif
+}
+
+//
+// check_scope - the recorded frame against the model's (false, and why, if
+//               it is not the same); the delay and spread of its edges
+//
+static bool check_scope(sim_time_t t0, int mode, const uint8_t nyb[], uint8_t rs, char *why, size_t len,
+                        sim_time_t *delay, sim_time_t *spread)
+{
+  sim_wave_t seg[REF_PHASES_MAX];
+  int64_t err, err_min = INT64_MAX, err_max = INT64_MIN;
+  uint8_t v, prev;
+  bool lead_in;
+  int segs = 0;
+  int i, j;
+
+  // the model's changes, less the ones which don't show
+  for (i = 0; i < phase_count; i++)
+  {
+    v = expected_pins(&phases[i], nyb, rs, mode);
+    if ((segs == 0) || (v != seg[segs - 1].v))
+    {
+      seg[segs].t = phases[i].start;
+      seg[segs].v = v;
+      segs++;
+    }
+  }
+
+  prev = wave[0].v & WAVE_MASK;
+  lead_in = (prev == seg[0].v);
+  j = 1;
+
+  for (i = 1; i < wave_count; i++)
+  {
+    v = wave[i].v & WAVE_MASK;
+    if (v == prev)
+      continue;
+    prev = v;
+
+    if (wave[i].t < t0)
+    {
+      snprintf(why, len, "changed to %02x before the frame started", v);
+      return false;
+    }
+
+    // the frame starting (what was held is replaced by the lead-in)
+    if ((j == 1) && (v == seg[0].v) && (wave[i].t - t0 < seg[1].t / 2))
+    {
+      if (wave[i].t - t0 > START_MAX)
+      {
+        snprintf(why, len, "lead-in shown %.3fus after the start", us(wave[i].t - t0));
+        return false;
+      }
+      lead_in = true;
+      continue;
+    }
+
+    if (!lead_in)
+      break;
+
+    if (j >= segs)
+    {
+      snprintf(why, len, "extra change to %02x at %.3fus", v, us(wave[i].t - t0));
+      return false;
+    }
+    if (v != seg[j].v)
+    {
+      snprintf(why, len, "%02x at %.3fus, but %02x from %.3fus", v, us(wave[i].t - t0),
+               seg[j].v, us(seg[j].t));
+      return false;
+    }
+
+    err = (int64_t)(wave[i].t - t0) - (int64_t)seg[j].t;
+    if (err < err_min)
+      err_min = err;
+    if (err > err_max)
+      err_max = err;
+    j++;
+  }
+
+  if (!lead_in)
+  {
+    snprintf(why, len, "no lead-in (%02x)", seg[0].v);
+    return false;
+  }
+
+  if (j < segs)
+  {
+    snprintf(why, len, "no change to %02x at %.3fus (stayed at %02x)", seg[j].v, us(seg[j].t), prev);
+    return false;
+  }
+
+  if ((err_min < 0) || (err_max > (int64_t)(START_MAX + EDGE_TOL)) ||
+      (err_max - err_min > 2 * EDGE_TOL))
+  {
+    snprintf(why, len, "edges %+.3fus to %+.3fus from the model's",
+             err_min / (double)SIM_CYCLES_PER_US, err_max / (double)SIM_CYCLES_PER_US);
+    return false;
+  }
+
+  *delay = (err_min + err_max) / 2;
+  *spread = err_max - err_min;
+  return true;
+}
+
+//
+// expected - the frames which may have been sent at t0 (one, or two if a
+//            report was published just as the frame started)
+//
+static int expected(sim_time_t t0, sim_pad_t pad[2])
+{
+  bool race;
+
+  if (!sim_usb_expected(t0, &pad[0], &pad[1], &race))
+    return 0;
+
+  return race ? 2 : 1;
+}
+
+static void note_error(uint32_t f, sim_time_t t0, const char *what, const char *why)
+{
+  errors++;
+  if (errors <= TRACE_ERRORS)
+    printf("  frame %lu at %.3fms: %s: %s\n", (unsigned long)f, t0 / (double)SIM_US(1000), what, why);
+}
+
+//
+// lost_at_switch - true (and counted) if a bad frame is the first one since
+//                  a switch, which is allowed to be lost
+//
+static bool lost_at_switch(uint32_t f, sim_time_t t0, const char *what, const char *why)
+{
+  if (!at_switch)
+    return false;
+
+  lost++;
+  if (sim_host_cfg.trace)
+    printf("  frame %lu at %.3fms: %s: %s (lost at the switch)\n",
+           (unsigned long)f, t0 / (double)SIM_US(1000), what, why);
+  return true;
+}
+
+static void scope_frame(uint32_t f, int mode)
+{
+  sim_time_t t0, delay = 0, spread = 0;
+  sim_pad_t pad[2];
+  uint8_t nyb[REF_NYBBLES];
+  char why[128] = "no frame published yet";
+  int n, k;
+
+#if !XE1AP_HOST_MSX
+  sim_pin_drive(SEL_PIN, mode == MODE_SCOPE_HIGH);
+  host_wait(ns(sim_host_cfg.sel_delay_ns));
+#endif
+
+  wave_start();
+  t0 = pulse();
+
+  host_t = t0 + phases[phase_count - 1].start + SCOPE_TAIL;
+  sim_sleep_until(host_t);
+  wave_on = false;
+
+#if !XE1AP_HOST_MSX
+  sim_pin_drive(SEL_PIN, false);
+#endif
+
+  scoped++;
+  n = expected(t0, pad);
+
+  for (k = 0; k < n; k++)
+  {
+    sim_ref_encode(&pad[k], nyb);
+    if (check_scope(t0, mode, nyb, sim_ref_run_select(&pad[k]), why, sizeof(why), &delay, &spread))
+      break;
+  }
+
+  if (wave_overflow)
+  {
+    snprintf(why, sizeof(why), "too many changes to record");
+    k = n;
+  }
+
+  if (k == n)
+  {
+    if (!lost_at_switch(f, t0, (mode == MODE_SCOPE_HIGH) ? "scope (SEL high)" : "scope", why))
+    {
+      scoped_bad++;
+      note_error(f, t0, (mode == MODE_SCOPE_HIGH) ? "scope (SEL high)" : "scope", why);
+    }
+    return;
+  }
+
+  raced += (k > 0);
+  if (delay < delay_min)
+    delay_min = delay;
+  if (delay > delay_max)
+    delay_max = delay;
+  if (spread > spread_max)
+    spread_max = spread;
+
+  if (sim_host_cfg.trace)
+    printf("  frame %lu at %.3fms: scope%s ok, delay %.3fus, spread %.3fus%s\n",
+           (unsigned long)f, t0 / (double)SIM_US(1000), (mode == MODE_SCOPE_HIGH) ? " (SEL high)" : "",
+           us(delay), us(spread), k ? " (report published at the edge)" : "");
+}
+
+// random wait before the next poll
+//
+static void poll_wait(void)
+{
+  host_wait(1 + sim_random(ns(sim_host_cfg.poll_ns)));
+}
+
+#if !XE1AP_HOST_MSX
+//
+// sel_response - how long the data took to settle after SEL changed at 'ts'
+//
+static sim_time_t sel_response(sim_time_t ts, sim_time_t until)
+{
+  sim_time_t last = ts;
+  int i;
+
+  for (i = 1; i < wave_count; i++)
+    if ((wave[i].t > ts) && (wave[i].t <= until) &&
+        ((wave[i].v & WAVE_MASK) != (wave[i - 1].v & WAVE_MASK)))
+      last = wave[i].t;
+
+  return last - ts;
+}
+#endif
+
+static void read_frame(uint32_t f)
+{
+  sim_time_t t0;
+  uint8_t nyb[REF_NYBBLES], want[REF_NYBBLES];
+  sim_pad_t pad[2], got;
+  char why[128];
+  uint8_t v;
+  int i, n, k;
+#if !XE1AP_HOST_MSX
+  uint8_t rs[REF_NYBBLES];          // Run/Select, at each poll which saw TRG ready
+  sim_time_t sel_t[2 * REF_NYBBLES];
+  int sels = 0;
+#endif
+
+  wave_start();
+  t0 = pulse();
+
+  for (i = 0; i < REF_NYBBLES; i++)
+  {
+    uint8_t trg = (i & 1) ? REF_TRG_READY2 : REF_TRG_READY1;
+
+    while (((v = pins_now()) & 0x03) != trg)
+    {
+      if (host_t - t0 > READ_TIMEOUT)
+      {
+        wave_on = false;
+        reads++;
+        snprintf(why, sizeof(why), "nybble %d never ready (TRG1/TRG2 at %d)", i + 1, v & 0x03);
+        if (!lost_at_switch(f, t0, "read", why))
+        {
+          reads_timeout++;
+          note_error(f, t0, "read", why);
+        }
+#if !XE1AP_HOST_MSX
+        sim_pin_drive(SEL_PIN, false);
+#endif
+        return;
+      }
+      poll_wait();
+    }
+#if XE1AP_HOST_MSX
+    host_wait(ns(sim_host_cfg.sel_delay_ns));
+    nyb[i] = sim_ref_unpins(pins_now() >> 4);
+#else
+    rs[i] = v & 0x0C;
+    sim_pin_drive(SEL_PIN, true);
+    sel_t[sels++] = host_t;
+    host_wait(ns(sim_host_cfg.sel_delay_ns));
+    nyb[i] = sim_ref_unpins(pins_now() & 0x0F);
+
+    sim_pin_drive(SEL_PIN, false);
+    sel_t[sels++] = host_t;
+    host_wait(ns(sim_host_cfg.sel_delay_ns));
+#endif
+  }
+
+  wave_on = false;
+  reads++;
+
+  n = expected(t0, pad);
+
+  for (k = 0; k < n; k++)
+  {
+    sim_ref_encode(&pad[k], want);
+    if (memcmp(nyb, want, REF_NYBBLES) != 0)
+      continue;
+
+#if !XE1AP_HOST_MSX
+    for (i = 0; i < REF_NYBBLES; i++)
+      if (rs[i] != sim_ref_run_select(&pad[k]))
+        break;
+    if (i < REF_NYBBLES)
+      continue;
+#endif
+    break;
+  }
+
+  if (wave_overflow)
+    k = n;
+
+  if (k == n)
+  {
+    if (wave_overflow)
+      snprintf(why, sizeof(why), "too many changes to record");
+    else if (n == 0)
+      snprintf(why, sizeof(why), "no frame published yet");
+    else
+    {
+      bool ok = sim_ref_decode(nyb, &got);
+
+      snprintf(why, sizeof(why), "x=%02x y=%02x t=%02x buttons=%03x%s, expected x=%02x y=%02x t=%02x buttons=%03x",
+               got.x, got.y, got.throttle, got.pressed, ok ? "" : " (malformed)",
+               pad[0].x, pad[0].y, pad[0].throttle, pad[0].pressed);
+    }
+    if (!lost_at_switch(f, t0, "read", why))
+    {
+      reads_bad++;
+      note_error(f, t0, "read", why);
+    }
+    return;
+  }
+
+  raced += (k > 0);
+
+#if !XE1AP_HOST_MSX
+  for (i = 0; i < sels; i++)
+  {
+    sim_time_t r = sel_response(sel_t[i], sel_t[i] + ns(sim_host_cfg.sel_delay_ns));
+
+    if (r > sel_max)
+      sel_max = r;
+  }
+#endif
+
+  if (sim_host_cfg.trace)
+    printf("  frame %lu at %.3fms: read x=%02x y=%02x t=%02x buttons=%03x, done at %.3fus%s\n",
+           (unsigned long)f, t0 / (double)SIM_US(1000), pad[k].x, pad[k].y, pad[k].throttle,
+           pad[k].pressed, us(host_t - t0), k ? " (report published at the edge)" : "");
+}
+
+#if !XE1AP_HOST_MSX
+//
+// scan_frame - read as a joypad, as the PC Engine's own routine does
+//
+static void scan_frame(uint32_t f)
+{
+  sim_time_t t0, ts;
+  sim_pad_t pad[2];
+  uint8_t dirs, buttons;
+  char why[128] = "no frame published yet";
+  int n, k;
+
+  // (CLR stays low between scans; it is only high here after a frame of the
+  // XE-1AP protocol)
+  sim_pin_drive(CLR_PIN, false);
+  host_wait(ns(sim_host_cfg.scan_pulse_ns));
+
+  wave_start();
+  sim_pin_drive(SEL_PIN, true);
+  sim_pin_drive(CLR_PIN, true);
+  t0 = host_t;
+  host_wait(ns(sim_host_cfg.scan_pulse_ns));
+  sim_pin_drive(CLR_PIN, false);
+  host_wait(ns(sim_host_cfg.sel_delay_ns));
+  dirs = pins_now() & 0x0F;
+
+  sim_pin_drive(SEL_PIN, false);
+  ts = host_t;
+  host_wait(ns(sim_host_cfg.sel_delay_ns));
+  buttons = pins_now() & 0x0F;
+  wave_on = false;
+
+  scans++;
+  n = expected(t0, pad);
+
+  for (k = 0; k < n; k++)
+    if ((dirs == sim_ref_pad(&pad[k], true)) && (buttons == sim_ref_pad(&pad[k], false)))
+      break;
+
+  if (wave_overflow)
+  {
+    snprintf(why, sizeof(why), "too many changes to record");
+    k = n;
+  }
+  else if ((k == n) && (n > 0))
+    snprintf(why, sizeof(why), "directions %x, buttons %x; expected %x, %x (x=%02x y=%02x hat=%x buttons=%03x)",
+             dirs, buttons, sim_ref_pad(&pad[0], true), sim_ref_pad(&pad[0], false),
+             pad[0].x, pad[0].y, pad[0].hat, pad[0].pressed);
+
+  if (k == n)
+  {
+    if (!lost_at_switch(f, t0, "scan", why))
+    {
+      scans_bad++;
+      note_error(f, t0, "scan", why);
+    }
+    return;
+  }
+
+  raced += (k > 0);
+  if (sel_response(ts, host_t) > sel_max)
+    sel_max = sel_response(ts, host_t);
+
+  if (sim_host_cfg.trace)
+    printf("  frame %lu at %.3fms: scan directions %x buttons %x%s\n",
+           (unsigned long)f, t0 / (double)SIM_US(1000), dirs, buttons,
+           k ? " (report published at the edge)" : "");
+}
+#endif
+
+// frame f is read as a joypad
+//
+static bool pad_frame(uint32_t f)
+{
+#if XE1AP_HOST_MSX
+  (void)f;
+  return false;
+#else
+  return (sim_host_cfg.pad_frames != 0) && ((f / sim_host_cfg.pad_frames) % 4 == 2);
+#endif
+}
+
+//
+// console - one frame every frame_us, taking turns at the modes (or read
+//           as a joypad)
+//
+static void console(void)
+{
+  sim_time_t next = host_t;
+  uint32_t f;
+
+  phase_count = sim_ref_phases(phases);
+
+#if XE1AP_HOST_MSX
+  sim_pin_drive(REQ_PIN, true);
+#else
+  sim_pin_drive(SEL_PIN, false);
+  sim_pin_drive(CLR_PIN, true);
+#endif
+
+  for (f = 0; f < sim_host_cfg.frames; f++)
+  {
+    host_t = next;
+    sim_sleep_until(host_t);
+    next += SIM_US(sim_host_cfg.frame_us);
+
+    at_switch = (f > 0) && (pad_frame(f) != pad_frame(f - 1));
+    switches += at_switch;
+
+#if !XE1AP_HOST_MSX
+    if (pad_frame(f))
+      scan_frame(f);
+    else
+#endif
+    if (modes[f % MODES] == MODE_READ)
+      read_frame(f);
+    else
+      scope_frame(f, modes[f % MODES]);
+  }
+
+  done = true;
+
+  while (1)
+    sim_sleep_until(SIM_NEVER);
+}
+
+void sim_host_start(sim_time_t at)
+{
+  host_t = at;
+  sim_thread_start(SIM_CONSOLE, console, at);
+}
+
+bool sim_host_done(void)
+{
+  return done;
+}
+
+//--------------------------------------------------------------------+
+// Results
+//--------------------------------------------------------------------+
+
+bool sim_host_report(void)
+{
+  bool pass;
+
+  printf("scope: %lu frames, %lu bad", (unsigned long)scoped, (unsigned long)scoped_bad);
+  if (scoped > scoped_bad)
+    printf("; delay %.3f-%.3fus, edges within %.3fus of each other (limit %.3fus)",
+           us(delay_min), us(delay_max), us(spread_max), us(2 * EDGE_TOL));
+  printf("\n");
+
+  printf("reads: %lu frames, %lu bad, %lu timed out", (unsigned long)reads,
+         (unsigned long)reads_bad, (unsigned long)reads_timeout);
+#if !XE1AP_HOST_MSX
+  printf("; SEL to data settled %.3fus max (limit %.3fus)", us(sel_max), us(SEL_MAX));
+#endif
+  printf("\n");
+
+#if !XE1AP_HOST_MSX
+  printf("scans (as a joypad): %lu, %lu bad; %lu switches, %lu frames lost at them\n",
+         (unsigned long)scans, (unsigned long)scans_bad, (unsigned long)switches, (unsigned long)lost);
+#endif
+
+  printf("frames from a report published at the edge: %lu\n", (unsigned long)raced);
+
+  pass = (scoped > 0) && (reads > 0) && (scoped_bad == 0) && (reads_bad == 0) &&
+         (reads_timeout == 0) && (scans_bad == 0) && (sel_max <= SEL_MAX) && !wave_overflow;
+
+  return pass;
+}
@@ -0,0 +1,141 @@
+/*
+ * sim_main.c - host-side simulator for XE1AP: runs the firmware against a
+ *              simulated console and a DualShock 4 with random inputs
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim_xe1ap.h"
+#include "analog.h"
+
+extern int  xe1ap_main(void);       // the firmware's main() (see the Makefile)
+
+extern void telemetry_command(int c);
+
+#define SIM_SETTLE_US   200000      // firmware start-up
+#define SIM_HOST_US     5000        // from the first report to the first frame
+#define SIM_TAIL_US     1000
+
+static uint32_t seed = 1;
+
+
+uint32_t sim_random(uint32_t n)
+{
+  seed = (seed * 1103515245u) + 12345u;
+  return ((seed >> 8) % n);
+}
+
+static void usage(const char *name)
+{
+  fprintf(stderr,
+          "usage: %s [options]\n"
+          "  -s <n>   random seed (default %lu)\n"
+          "  -n <n>   frames (default %lu)\n"
+          "  -r <us>  USB report interval (default %lu)\n"
+          "  -c <n>   controllers, 1 or 2 (default %lu)\n"
+          "  -f <us>  frame period (default %lu)\n"
+          "  -p <n>   read every 4th run of n frames as a joypad (default %lu; PC Engine)\n"
+          "  -v       show the firmware's output\n"
+          "  -V       show every frame\n"
+          "  -t       show the firmware's telemetry at the end\n",
+          name, (unsigned long)seed, (unsigned long)sim_host_cfg.frames,
+          (unsigned long)sim_report_us, (unsigned long)sim_controllers,
+          (unsigned long)sim_host_cfg.frame_us, (unsigned long)sim_host_cfg.pad_frames);
+}
+
+static void firmware(void)
+{
+  xe1ap_main();
+}
+
+// the DMA runs, and the console's probes look at the pins, every cycle
+//
+static bool hw_cycle(void)
+{
+  sim_wave_cycle();
+  return sim_dma_cycle();
+}
+
+int main(int argc, char *argv[])
+{
+  bool telemetry = false;
+  bool pass;
+  sim_time_t end;
+  int c;
+
+  while ((c = getopt(argc, argv, "s:n:r:c:f:p:vVt")) != -1)
+  {
+    switch (c)
+    {
+      case 's': seed = strtoul(optarg, NULL, 0); break;
+      case 'n': sim_host_cfg.frames = strtoul(optarg, NULL, 0); break;
+      case 'r': sim_report_us = strtoul(optarg, NULL, 0); break;
+      case 'c': sim_controllers = strtoul(optarg, NULL, 0); break;
+      case 'f': sim_host_cfg.frame_us = strtoul(optarg, NULL, 0); break;
+      case 'p': sim_host_cfg.pad_frames = strtoul(optarg, NULL, 0); break;
+      case 'v': sim_firmware_output = true; break;
+      case 'V': sim_host_cfg.trace = true; break;
+      case 't': telemetry = true; break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  if ((optind != argc) || (sim_controllers < 1) || (sim_controllers > 2))
+  {
+    usage(argv[0]);
+    return 2;
+  }
+
+  printf("%s: seed %lu, %lu frames every %luus, reports every %luus%s\n",
+         XE1AP_HOST_MSX ? "MSX" : "PC Engine", (unsigned long)seed,
+         (unsigned long)sim_host_cfg.frames, (unsigned long)sim_host_cfg.frame_us,
+         (unsigned long)sim_report_us, (sim_controllers > 1) ? " from each of 2 controllers" : "");
+
+  sim_hw_cycle = hw_cycle;
+  sim_thread_start(SIM_CORE0, firmware, 0);
+  sim_run(SIM_US(SIM_SETTLE_US));
+
+  // so that the values go through unchanged ('d' and 'f' on the console)
+  analog_tune.deadzone = 0;
+  analog_tune.filter = false;
+
+  sim_usb_start(SIM_US(SIM_SETTLE_US));
+  sim_host_start(SIM_US(SIM_SETTLE_US + SIM_HOST_US));
+
+  end = SIM_US(SIM_SETTLE_US + SIM_HOST_US + SIM_TAIL_US) +
+        (sim_time_t)sim_host_cfg.frames * SIM_US(sim_host_cfg.frame_us);
+  sim_run(end);
+
+  if (telemetry)
+  {
+    sim_firmware_output = true;
+    telemetry_command('t');
+  }
+
+  printf("reports: %lu sent, %lu frames published\n",
+         (unsigned long)sim_pad_reports, (unsigned long)sim_pad_publishes);
+
+  pass = sim_host_report() && sim_host_done();
+
+  if (sim_dma_unacknowledged())
+  {
+    printf("DMA interrupts not cleared by the handler: %lu\n", (unsigned long)sim_dma_unacknowledged());
+    pass = false;
+  }
+
+  if (!pass)
+  {
+    printf("FAIL\n");
+    return 1;
+  }
+
+  printf("PASS\n");
+  return 0;
+}
@@ -0,0 +1,197 @@
+/*
+ * sim_ref.c - reference model of the XE-1AP: what an actual joystick sends,
+ *             and when
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <string.h>
+
+#include "sim_xe1ap.h"
+
+//--------------------------------------------------------------------+
+// This is written from the protocol description (see Readme.md), not
+// from the firmware: the order and polarity of the nybbles, the bit
+// order on the PC Engine's data lines, and the timing of each phase.
+//
+// The timing is the one taken from an actual joystick which the firmware
+// aims for (frame.c): a 68us lead-in, then for each byte: first nybble
+// valid 13us, changing 3+1us, second nybble valid 13us, changing 4us,
+// waiting 15+1us (the next byte's first nybble appears for the last 1us).
+// The last byte ends with the wait, which is held until the next frame.
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  uint8_t trg;
+  uint8_t which;                    // 0 = the byte's first nybble, 1 = second, 2 = next byte's first
+  uint8_t us;
+} ref_timing_t;
+
+static const ref_timing_t lead_in = { REF_TRG_WAIT, 0, 68 };
+
+static const ref_timing_t byte_timing[] =
+{
+  { REF_TRG_READY1, 0, 13 },
+  { REF_TRG_CHANGE, 0,  3 },
+  { REF_TRG_CHANGE, 1,  1 },
+  { REF_TRG_READY2, 1, 13 },
+  { REF_TRG_CHANGE, 1,  4 },
+  { REF_TRG_WAIT,   1, 15 },
+  { REF_TRG_WAIT,   2,  1 },
+};
+
+#define BYTES           (REF_NYBBLES / 2)
+#define BYTE_TIMINGS    (sizeof(byte_timing) / sizeof(byte_timing[0]))
+
+
+int sim_ref_phases(sim_ref_phase_t *phase)
+{
+  sim_time_t t = SIM_US(lead_in.us);
+  unsigned i, j;
+  int n = 0;
+
+  phase[n].start = 0;
+  phase[n].end = t;
+  phase[n].trg = lead_in.trg;
+  phase[n].nybble = 0;
+  n++;
+
+  for (i = 0; i < BYTES; i++)
+  {
+    for (j = 0; j < BYTE_TIMINGS; j++)
+    {
+      phase[n].start = t;
+      phase[n].trg = byte_timing[j].trg;
+      phase[n].nybble = (i * 2) + byte_timing[j].which;
+
+      // the last byte has no next one: its wait is held
+      if ((i == BYTES - 1) && (byte_timing[j].trg == REF_TRG_WAIT))
+      {
+        phase[n].end = SIM_NEVER;
+        return n + 1;
+      }
+
+      t += SIM_US(byte_timing[j].us);
+      phase[n].end = t;
+      n++;
+    }
+  }
+
+  return n;
+}
+
+static inline uint8_t bit(const sim_pad_t *pad, int button)
+{
+  return (pad->pressed >> button) & 1;
+}
+
+//
+// sim_ref_encode - the 12 nybbles (all low-active)
+//                  bit 3 is the first button named in each of these:
+//                   1) A, B, C, D (A is A or A'; B is B or B')
+//                   2) E1, E2, Start, Select
+//                   3) Y high  4) X high  5) throttle high  6) 0000
+//                   7) Y low   8) X low   9) throttle low  10) 0000
+//                  11) A, B, A', B'
+//                  12) 1111
+//
+void sim_ref_encode(const sim_pad_t *pad, uint8_t nybble[REF_NYBBLES])
+{
+  uint8_t a = bit(pad, REF_A) | bit(pad, REF_A2);
+  uint8_t b = bit(pad, REF_B) | bit(pad, REF_B2);
+
+  nybble[0]  = ~((a << 3) | (b << 2) | (bit(pad, REF_C) << 1) | bit(pad, REF_D)) & 0x0F;
+  nybble[1]  = ~((bit(pad, REF_E1) << 3) | (bit(pad, REF_E2) << 2) |
+                 (bit(pad, REF_START) << 1) | bit(pad, REF_SELECT)) & 0x0F;
+  nybble[2]  = pad->y >> 4;
+  nybble[3]  = pad->x >> 4;
+  nybble[4]  = pad->throttle >> 4;
+  nybble[5]  = 0x0;
+  nybble[6]  = pad->y & 0x0F;
+  nybble[7]  = pad->x & 0x0F;
+  nybble[8]  = pad->throttle & 0x0F;
+  nybble[9]  = 0x0;
+  nybble[10] = ~((bit(pad, REF_A) << 3) | (bit(pad, REF_B) << 2) |
+                 (bit(pad, REF_A2) << 1) | bit(pad, REF_B2)) & 0x0F;
+  nybble[11] = 0xF;
+}
+
+bool sim_ref_decode(const uint8_t nybble[REF_NYBBLES], sim_pad_t *pad)
+{
+  uint8_t n0 = ~nybble[0] & 0x0F;
+  uint8_t n1 = ~nybble[1] & 0x0F;
+  uint8_t n10 = ~nybble[10] & 0x0F;
+  uint8_t check[REF_NYBBLES];
+
+  memset(pad, 0, sizeof(*pad));
+
+  pad->y = (nybble[2] << 4) | nybble[6];
+  pad->x = (nybble[3] << 4) | nybble[7];
+  pad->throttle = (nybble[4] << 4) | nybble[8];
+
+  pad->pressed = (((n10 >> 3) & 1) << REF_A) | (((n10 >> 2) & 1) << REF_B) |
+                 (((n10 >> 1) & 1) << REF_A2) | ((n10 & 1) << REF_B2) |
+                 (((n0 >> 1) & 1) << REF_C) | ((n0 & 1) << REF_D) |
+                 (((n1 >> 3) & 1) << REF_E1) | (((n1 >> 2) & 1) << REF_E2) |
+                 (((n1 >> 1) & 1) << REF_START) | ((n1 & 1) << REF_SELECT);
+
+  // the rest (merged A/B, the constant nybbles) must agree
+  sim_ref_encode(pad, check);
+  return memcmp(check, nybble, REF_NYBBLES) == 0;
+}
+
+#if XE1AP_HOST_MSX
+// Pins 1-4 are bits 0-3
+//
+uint8_t sim_ref_pins(uint8_t nybble)
+{
+  return nybble & 0x0F;
+}
+
+uint8_t sim_ref_unpins(uint8_t pins)
+{
+  return pins & 0x0F;
+}
+#else
+// The PC Engine reads D0-D3 as the nybble's bits 0, 3, 1, 2
+//
+uint8_t sim_ref_pins(uint8_t nybble)
+{
+  return (nybble & 1) | (((nybble >> 3) & 1) << 1) | (((nybble >> 1) & 1) << 2) | (((nybble >> 2) & 1) << 3);
+}
+
+uint8_t sim_ref_unpins(uint8_t pins)
+{
+  return (pins & 1) | (((pins >> 2) & 1) << 1) | (((pins >> 3) & 1) << 2) | (((pins >> 1) & 1) << 3);
+}
+#endif
+
+// With SEL low, D2 is Select and D3 is Run (low when pressed), as on a pad
+//
+uint8_t sim_ref_run_select(const sim_pad_t *pad)
+{
+  return (~((bit(pad, REF_START) << 1) | bit(pad, REF_SELECT)) & 0x03) << 2;
+}
+
+#if !XE1AP_HOST_MSX
+// Digital mode: a 2-button pad (low when pressed). With SEL high, D0-D3 are
+// Up, Right, Down and Left, for the d-pad, or the stick past
+// REF_PAD_THRESHOLD from the centre; with SEL low, they are I (A or A'),
+// II (B or B'), Select and Run
+//
+uint8_t sim_ref_pad(const sim_pad_t *pad, bool sel)
+{
+  // (the d-pad's directions, N to NW: Up 1, Right 2, Down 4, Left 8)
+  static const uint8_t hat_dirs[9] = { 0x1, 0x3, 0x2, 0x6, 0x4, 0xC, 0x8, 0x9, 0x0 };
+
+  if (sel)
+    return ~(((pad->x < REF_PAD_THRESHOLD) << 3) | ((pad->y >= 0x100 - REF_PAD_THRESHOLD) << 2) |
+             ((pad->x >= 0x100 - REF_PAD_THRESHOLD) << 1) | (pad->y < REF_PAD_THRESHOLD) |
+             hat_dirs[pad->hat]) & 0x0F;
+
+  return ~((bit(pad, REF_START) << 3) | (bit(pad, REF_SELECT) << 2) |
+           ((bit(pad, REF_B) | bit(pad, REF_B2)) << 1) | bit(pad, REF_A) | bit(pad, REF_A2)) & 0x0F;
+}
+#endif
@@ -0,0 +1,282 @@
+/*
+ * sim_usb.c - a simulated DualShock 4 with random inputs, and the TinyUSB
+ *             host functions
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_xe1ap.h"
+#include "pico/time.h"
+#include "tusb.h"
+
+//--------------------------------------------------------------------+
+// The controller sends a report every sim_report_us. Each one moves the
+// sticks and changes the buttons at random: mostly small moves, with
+// jumps to anywhere (and to the ends of travel) now and then. Once in a
+// while it holds the d-pad in some direction (seen only in digital mode).
+//
+// It is mounted as a DualShock 4 (VID/PID 054c:09cc), device 1 instance 0,
+// so the firmware uses its table entry; the reference model's buttons are
+// pressed on the DS4 buttons which the XE-1AP ones are mapped to (see
+// padmap.c).
+//
+// With sim_controllers = 2, a second one is mounted as instance 1 (as on
+// a two-port adapter; without a hub there is only one device), and both
+// report in the same USB frame. Now and then core 0 is busy for a whole
+// USB frame (CORE0_LATE_ODDS), so two frames' reports are handed to the
+// firmware back to back: four frames published within a few microseconds,
+// which may well be while the console is being sent one.
+//
+// Which report each frame came from is recorded as the firmware publishes
+// it (frame_publish() is wrapped; see the Makefile), so the console can
+// tell what it should have read.
+//--------------------------------------------------------------------+
+
+#define DS4_REPORT_LEN  64
+
+#define CONTROLLERS_MAX 2
+#define CORE0_LATE_ODDS 4           // with two controllers: 1 in this many tuh_task() calls
+
+typedef struct
+{
+  sim_time_t t;
+  sim_pad_t  pad;
+  uint8_t    controller;            // (its instance)
+} sim_report_t;
+
+typedef struct
+{
+  sim_time_t t;                     // when the frame was complete
+  uint32_t   report;
+} sim_publish_t;
+
+// DS4 button for each XE-1AP one: byte (after the report ID) and bit
+//
+static const uint8_t ds4_button[REF_BUTTONS][2] =
+{
+  [REF_A]      = { 4, 6 },          // circle
+  [REF_B]      = { 4, 5 },          // cross
+  [REF_C]      = { 5, 0 },          // L1
+  [REF_D]      = { 5, 2 },          // L2
+  [REF_E1]     = { 4, 4 },          // square
+  [REF_E2]     = { 4, 7 },          // triangle
+  [REF_START]  = { 5, 5 },          // option
+  [REF_SELECT] = { 5, 4 },          // share
+  [REF_A2]     = { 5, 1 },          // R1
+  [REF_B2]     = { 5, 3 },          // R2
+};
+
+uint32_t sim_report_us = 1000;
+uint32_t sim_controllers = 1;
+uint32_t sim_pad_reports = 0;
+uint32_t sim_pad_publishes = 0;
+
+static sim_report_t  *reports = NULL;
+static uint32_t       report_alloc = 0;
+static uint32_t       delivered = 0;
+static bool           mounted = false;
+static uint32_t       delivering = 0;   // report being handed to the firmware
+
+static sim_publish_t *publishes = NULL;
+static uint32_t       publish_alloc = 0;
+
+
+static uint8_t wander(uint8_t v)
+{
+  int32_t n;
+
+  switch (sim_random(16))
+  {
+    case 0:  return sim_random(256);
+    case 1:  return sim_random(2) ? 0xFF : 0x00;
+    case 2:  return 0x80;
+    default:
+      n = (int32_t)v + (int32_t)sim_random(17) - 8;
+      return (n < 0) ? 0 : (n > 255) ? 255 : n;
+  }
+}
+
+static void next_state(sim_pad_t *pad)
+{
+  pad->x = wander(pad->x);
+  pad->y = wander(pad->y);
+  pad->throttle = wander(pad->throttle);
+
+  if (sim_random(4) == 0)
+    pad->pressed ^= 1u << sim_random(REF_BUTTONS);
+
+  // the d-pad: held a while, then let go
+  if (sim_random(64) == 0)
+    pad->hat = (pad->hat == 8) ? sim_random(8) : 8;
+}
+
+//
+// controller - sends each report at its time (the USB interrupt wakes core 0)
+//
+static void controller(void)
+{
+  sim_pad_t pad[CONTROLLERS_MAX] = { { 0x80, 0x80, 0x80, 0, 8 }, { 0x80, 0x80, 0x80, 0, 8 } };
+  sim_time_t t = sim_now;
+  uint32_t i;
+
+  while (1)
+  {
+    t += SIM_US(sim_report_us);
+    sim_sleep_until(t);
+
+    for (i = 0; i < sim_controllers; i++)
+    {
+      next_state(&pad[i]);
+
+      if (sim_pad_reports >= report_alloc)
+      {
+        report_alloc = report_alloc ? (report_alloc * 2) : 1024;
+        reports = realloc(reports, report_alloc * sizeof(sim_report_t));
+      }
+      reports[sim_pad_reports].t = sim_now;
+      reports[sim_pad_reports].pad = pad[i];
+      reports[sim_pad_reports].controller = i;
+      sim_pad_reports++;
+    }
+
+    sim_event(SIM_CORE0);
+  }
+}
+
+void sim_usb_start(sim_time_t at)
+{
+  sim_thread_start(SIM_PAD, controller, at);
+}
+
+static void ds4_report(const sim_pad_t *pad, uint32_t n, uint8_t *r)
+{
+  uint8_t *d = r + 1;
+  int i;
+
+  memset(r, 0, DS4_REPORT_LEN);
+  r[0] = 1;                         // report ID
+
+  d[0] = pad->x;
+  d[1] = pad->y;
+  d[2] = 0x80;                      // Z (the right stick's X)
+  d[3] = 0xFF - pad->throttle;      // Rz: up for more
+  d[4] = pad->hat;
+  d[6] = (n & 0x3F) << 2;           // report counter
+
+  for (i = 0; i < REF_BUTTONS; i++)
+    if (pad->pressed & (1u << i))
+      d[ds4_button[i][0]] |= 1 << ds4_button[i][1];
+}
+
+//--------------------------------------------------------------------+
+// What the console should see: the firmware's frames, by report
+//--------------------------------------------------------------------+
+
+void __real_frame_publish(void);
+
+void __wrap_frame_publish(void)
+{
+  __real_frame_publish();
+
+  if (sim_pad_publishes >= publish_alloc)
+  {
+    publish_alloc = publish_alloc ? (publish_alloc * 2) : 1024;
+    publishes = realloc(publishes, publish_alloc * sizeof(sim_publish_t));
+  }
+
+  publishes[sim_pad_publishes].t = sim_now;
+  publishes[sim_pad_publishes].report = delivering;
+  sim_pad_publishes++;
+}
+
+// (the DMA chain reads the frame's pointer a few cycles after the edge)
+//
+#define RACE_CYCLES     SIM_US(1)
+
+bool sim_usb_expected(sim_time_t at, sim_pad_t *pad, sim_pad_t *racing, bool *raced)
+{
+  int i;
+
+  *raced = false;
+
+  for (i = (int)sim_pad_publishes - 1; (i >= 0) && (publishes[i].t > at); i--)
+  {
+    if (publishes[i].t <= at + RACE_CYCLES)
+    {
+      *racing = reports[publishes[i].report].pad;
+      *raced = true;
+    }
+  }
+
+  if (i < 0)
+    return false;
+
+  *pad = reports[publishes[i].report].pad;
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// TinyUSB host
+//--------------------------------------------------------------------+
+
+bool tusb_init(void)
+{
+  return true;
+}
+
+//
+// tuh_task - the real one returns at once when there is nothing to do; this
+//            one waits for the next report (up to 1ms), which only saves
+//            simulating the firmware's idle loop
+//
+void tuh_task(void)
+{
+  uint8_t r[DS4_REPORT_LEN];
+
+  sim_sync(SIM_CALL_CYCLES);
+
+  if (!mounted)
+  {
+    mounted = true;
+    tuh_hid_mount_cb(1, 0, NULL, 0);
+    if (sim_controllers > 1)
+      tuh_hid_mount_cb(1, 1, NULL, 0);
+  }
+
+  if (delivered == sim_pad_reports)
+    best_effort_wfe_or_timeout(make_timeout_time_us(1000));
+
+  if ((delivered < sim_pad_reports) && (sim_controllers > 1) && (sim_random(CORE0_LATE_ODDS) == 0))
+    sim_sync(SIM_US(sim_report_us));       // busy: the next USB frame's reports queue up too
+
+  while (delivered < sim_pad_reports)
+  {
+    delivering = delivered;
+    ds4_report(&reports[delivered].pad, delivered, r);
+    delivered++;
+
+    tuh_hid_report_received_cb(1, reports[delivering].controller, r, sizeof(r));
+  }
+}
+
+bool tuh_vid_pid_get(uint8_t dev_addr, uint16_t *vid, uint16_t *pid)
+{
+  (void)dev_addr;
+
+  *vid = 0x054c;
+  *pid = 0x09cc;
+  return true;
+}
+
+bool tuh_hid_receive_report(uint8_t dev_addr, uint8_t instance)
+{
+  (void)dev_addr;
+  (void)instance;
+
+  return true;
+}
@@ -0,0 +1,155 @@
+/*
+ * sim_xe1ap.h - host-side simulator for XE1AP: internal interfaces
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _SIM_XE1AP_H_
+#define _SIM_XE1AP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sim.h"
+#include "frame.h"                  // (XE1AP_HOST_MSX)
+
+//--------------------------------------------------------------------+
+// The firmware runs on PCEMouse's simulator (threads, pins and the PIO
+// interpreter; see PCEMouse/sim/sim.h), with a DMA model added, since
+// XE1AP sends each frame by a DMA chain. The threads are the firmware
+// (core 0), the console, and the USB controller; the console drives
+// CLR (and SEL) as a game would, and the output pins are recorded at
+// every cycle, so each frame can be checked against a model of the
+// actual joystick (sim_ref.c), in timing as well as in content.
+//--------------------------------------------------------------------+
+
+#define SIM_PAD         SIM_MOUSE   // the USB controller's thread
+
+// The simulator is built for the Adafruit KB2040 (see the Makefile), so
+// these are main.c's pins for it
+//
+#if XE1AP_HOST_MSX
+#define REQ_PIN         19          // active low
+#define TRG1_PIN        2
+#define DATA0_PIN       6
+#else
+#define SEL_PIN         18
+#define CLR_PIN         19
+#define OUTD0_PIN       26
+#endif
+
+// Random numbers (sim_main.c), the same sequence for the same seed
+//
+uint32_t sim_random(uint32_t n);    // 0 .. n-1
+
+//--------------------------------------------------------------------+
+// Reference model of the XE-1AP (sim_ref.c)
+//--------------------------------------------------------------------+
+
+// Buttons, one bit each in sim_pad_t.pressed
+//
+enum
+{
+  REF_A = 0,
+  REF_B,
+  REF_C,
+  REF_D,
+  REF_E1,
+  REF_E2,
+  REF_START,
+  REF_SELECT,
+  REF_A2,
+  REF_B2,
+  REF_BUTTONS
+};
+
+typedef struct
+{
+  uint8_t  x;                       // 0 = left
+  uint8_t  y;                       // 0 = up
+  uint8_t  throttle;                // 0xFF = up
+  uint16_t pressed;
+  uint8_t  hat;                     // d-pad: 0-7 = N, NE, ... NW; 8 = centred
+} sim_pad_t;
+
+#define REF_NYBBLES     12
+
+// TRG1 (bit 0) and TRG2 (bit 1)
+//
+#define REF_TRG_READY1  0           // first nybble of a byte valid
+#define REF_TRG_READY2  1           // second nybble valid
+#define REF_TRG_WAIT    2
+#define REF_TRG_CHANGE  3
+
+typedef struct
+{
+  sim_time_t start;                 // from the edge which starts the frame
+  sim_time_t end;                   // (the last phase is held: SIM_NEVER)
+  uint8_t    trg;
+  uint8_t    nybble;                // shown on the data lines
+} sim_ref_phase_t;
+
+#define REF_PHASES_MAX  48
+
+int     sim_ref_phases(sim_ref_phase_t *phase);       // returns how many
+void    sim_ref_encode(const sim_pad_t *pad, uint8_t nybble[REF_NYBBLES]);
+bool    sim_ref_decode(const uint8_t nybble[REF_NYBBLES], sim_pad_t *pad);   // false if malformed
+uint8_t sim_ref_pins(uint8_t nybble);   // on the data lines, in the host's bit order
+uint8_t sim_ref_unpins(uint8_t pins);
+uint8_t sim_ref_run_select(const sim_pad_t *pad);     // D2/D3 with SEL low (PC Engine)
+
+#define REF_PAD_THRESHOLD   0x40    // digital mode: the stick as directions (as padmap.c)
+
+uint8_t sim_ref_pad(const sim_pad_t *pad, bool sel);  // D0-D3 in digital mode (PC Engine)
+
+//--------------------------------------------------------------------+
+// USB controller (sim_usb.c)
+//--------------------------------------------------------------------+
+
+extern uint32_t sim_report_us;      // report interval
+extern uint32_t sim_controllers;    // 1, or 2 (on one adapter; see sim_usb.c)
+extern uint32_t sim_pad_reports;    // reports sent so far
+extern uint32_t sim_pad_publishes;  // frames published by the firmware
+
+void sim_usb_start(sim_time_t at);
+
+// the controller as it was in the newest frame published by 'at' (false if
+// none yet); and as it was in one published just after, within the time
+// the DMA chain takes to pick it up ('raced' false if none)
+//
+bool sim_usb_expected(sim_time_t at, sim_pad_t *pad, sim_pad_t *racing, bool *raced);
+
+//--------------------------------------------------------------------+
+// Console (sim_host.c)
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  uint32_t frames;                  // to read
+  uint32_t frame_us;                // from one frame to the next
+  uint32_t pulse_ns;                // CLR (REQ) pulse
+  uint32_t poll_ns;                 // longest time between two polls of TRG1/TRG2
+  uint32_t sel_delay_ns;            // SEL change (or TRG seen) to reading the data
+  uint32_t pad_frames;              // PC Engine: every 4th run of this many frames is
+                                    // read as a joypad instead (0 = never)
+  uint32_t scan_pulse_ns;           // CLR pulse of a joypad scan
+  bool     trace;                   // print every frame
+} sim_host_cfg_t;
+
+extern sim_host_cfg_t sim_host_cfg;
+
+void sim_host_start(sim_time_t at);
+bool sim_host_done(void);
+bool sim_host_report(void);         // prints the results; false on failure
+
+void sim_wave_cycle(void);          // records the pins (once per cycle)
+
+//--------------------------------------------------------------------+
+// DMA (sim_dma.c)
+//--------------------------------------------------------------------+
+
+bool sim_dma_cycle(void);           // see sim_hw_cycle (sim.h)
+uint32_t sim_dma_unacknowledged(void);  // interrupts which the handler did not clear
+
+#endif /* _SIM_XE1AP_H_ */
@@ -0,0 +1,488 @@
+/*
+ * analog.c - conditioning of the analog axes (calibration, deadzone,
+ *            response curve and jitter filter), in fixed point
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "analog.h"
+
+// Response curves
+// ---------------
+// Each is a mix of a straight line and a cube (of the deflection past the
+// deadzone): "linear" is the stick as it is, and the others give finer
+// control near the centre, for the same full deflection.
+//
+typedef struct
+{
+  const char *name;
+  uint16_t    cube;             // how much of the cube (out of 256)
+} analog_curve_t;
+
+static const analog_curve_t analog_curves[] =
+{
+  { "linear",   0 },
+  { "mild",    96 },
+  { "expo",   176 },
+  { "cubic",  256 },
+};
+
+#define ANALOG_CURVES   (sizeof(analog_curves) / sizeof(analog_curves[0]))
+
+// Filter limits
+//
+#define DT_MIN_US           125         // (a report every 125us at most)
+#define DT_RESET_US         100000      // start the filter again after a gap
+#define D_CUTOFF            (1 << 4)    // speed is filtered at 1 Hz (12.4)
+#define CUTOFF_MAX          (500 << 4)
+#define UNITS_PER_MS        33          // full deflection per second (ANALOG_FULL / 1000)
+#define ANALOG_SOURCES      4           // controllers kept at once (one per HID instance)
+
+static const analog_cal_t cal_default = { 0x8000, 0x0000, 0xFFFF };
+
+static const analog_tune_t analog_defaults =
+{
+  .deadzone = 1024,                     // about 3%: the DS4 jitters by 2 of 256 at rest
+  .curve = 0,
+  .filter = true,
+  .min_cutoff = 3 << 4,
+  .beta = 8 << 4,
+};
+
+analog_tune_t analog_tune;
+
+// Table for the selected curve; expanded into SRAM when it is chosen
+//
+static uint16_t lut[ANALOG_LUT_SIZE];
+
+typedef struct
+{
+  int32_t value;                        // filtered, 24.8 fixed point
+  int32_t speed;                        // filtered, units per ms (28.4)
+  int32_t last;                         // the last calibrated value
+} analog_filter_t;
+
+// Each controller has its own calibration and filter, or two of them would
+// be blended into one; a controller not seen before takes over the one idle
+// longest, and starts from the default calibration
+//
+typedef struct
+{
+  uint32_t        source;               // FRAME_SOURCE (0 = none)
+  uint32_t        us;                   // its last report
+  uint16_t        raw[ANALOG_AXES];     // its last values in (for calibration)
+  analog_cal_t    cal[ANALOG_AXES];
+  analog_filter_t axis[ANALOG_AXES];
+} analog_source_t;
+
+static analog_source_t  sources[ANALOG_SOURCES];
+static analog_source_t *latest = &sources[0];   // the last to report ('z' takes its centre)
+
+static bool measuring = false;
+
+
+static void analog_gains(analog_source_t *s)
+{
+  analog_cal_t *cal;
+  int32_t span;
+  int i;
+
+  for (i = 0; i < ANALOG_AXES; i++)
+  {
+    cal = &s->cal[i];
+
+    // (an end which is too close to the centre is left at the full range)
+    span = cal->centre - cal->low;
+    if (span < 1024)
+      span = cal->centre;
+    cal->span_low = span;
+    cal->gain_low = (span > 0) ? ((ANALOG_FULL << 12) / span) : 0;
+
+    span = cal->high - cal->centre;
+    if (span < 1024)
+      span = 0xFFFF - cal->centre;
+    cal->span_high = span;
+    cal->gain_high = (span > 0) ? ((ANALOG_FULL << 12) / span) : 0;
+  }
+}
+
+static void analog_curve_build(void)
+{
+  uint32_t cube = analog_curves[analog_tune.curve].cube;
+  uint32_t n, n3;
+  int i;
+
+  for (i = 0; i < ANALOG_LUT_SIZE; i++)
+  {
+    n = i << ANALOG_LUT_SHIFT;
+    if (n > ANALOG_FULL)
+      n = ANALOG_FULL;
+
+    n3 = (((n * n) >> 15) * n) >> 15;
+    lut[i] = ((n * (256 - cube)) + (n3 * cube)) >> 8;
+  }
+}
+
+//
+// source_init - a controller not seen before (0 = none) takes over a slot
+//
+static void source_init(analog_source_t *s, uint32_t source)
+{
+  int i;
+
+  memset(s, 0, sizeof(analog_source_t));
+  s->source = source;
+
+  for (i = 0; i < ANALOG_AXES; i++)
+  {
+    s->cal[i] = cal_default;
+    s->raw[i] = cal_default.centre;
+  }
+  analog_gains(s);
+}
+
+//
+// analog_init - the defaults (not on the hot path)
+//
+void analog_init(void)
+{
+  int i;
+
+  analog_tune = analog_defaults;
+  analog_curve_build();
+
+  for (i = 0; i < ANALOG_SOURCES; i++)
+    source_init(&sources[i], 0);
+  latest = &sources[0];
+}
+
+//
+// calibrate - raw value to +/-ANALOG_FULL (past the ends: held at the ends)
+//
+static inline int32_t calibrate(analog_cal_t const *cal, uint32_t v)
+{
+  int32_t d = (int32_t)v - cal->centre;
+
+  if (d >= 0)
+  {
+    if (d > cal->span_high)
+      d = cal->span_high;
+    d = (int32_t)(((uint32_t)d * cal->gain_high) >> 12);
+  }
+  else
+  {
+    if (-d > cal->span_low)
+      d = -cal->span_low;
+    d = -(int32_t)(((uint32_t)-d * cal->gain_low) >> 12);
+  }
+
+  return (d > ANALOG_FULL) ? ANALOG_FULL : d;
+}
+
+static inline int32_t mul_q16(int32_t a, uint32_t alpha)
+{
+  return (int32_t)(((int64_t)a * alpha) >> 16);
+}
+
+//
+// smoothing - a low-pass filter's factor (16 bits) for one step of dt_us at
+//             cutoff (12.4 Hz): 1 / (1 + tau / dt), where tau = 1 / (2 pi cutoff)
+//
+static inline uint32_t smoothing(uint32_t cutoff, uint32_t dt_us)
+{
+  // k = 2 pi cutoff dt, in 16.16 (2 pi / 16 / 1e6 = 1687 / 2^16)
+  uint32_t k = (uint32_t)(((uint64_t)cutoff * dt_us * 1687) >> 16);
+
+  if (k > (1 << 20))
+    k = 1 << 20;
+
+  return (k << 11) / ((65536 + k) >> 5);
+}
+
+//
+// one_euro - filter one calibrated value
+//
+static inline int32_t one_euro(analog_filter_t *f, int32_t v, uint32_t dt_us)
+{
+  uint32_t cutoff;
+  int32_t speed, abs_speed;
+
+  speed = ((v - f->last) * (1000 << 4)) / (int32_t)dt_us;
+  f->last = v;
+  f->speed += mul_q16(speed - f->speed, smoothing(D_CUTOFF, dt_us));
+
+  abs_speed = (f->speed < 0) ? -f->speed : f->speed;
+  abs_speed >>= 4;
+  if (abs_speed > (1 << 18))
+    abs_speed = 1 << 18;
+
+  cutoff = analog_tune.min_cutoff + ((analog_tune.beta * (uint32_t)abs_speed) / UNITS_PER_MS);
+  if (cutoff > CUTOFF_MAX)
+    cutoff = CUTOFF_MAX;
+
+  f->value += mul_q16((v * 256) - f->value, smoothing(cutoff, dt_us));
+
+  return (f->value + 128) >> 8;
+}
+
+//
+// source_for - the source's calibration and filter state; true if its filter
+//              is to start again (a new source, or a gap in its reports)
+//
+static inline bool source_for(uint32_t source, uint32_t now, analog_source_t **s, uint32_t *dt_us)
+{
+  analog_source_t *f = &sources[0];
+  bool reset = false;
+  int i;
+
+  for (i = 0; i < ANALOG_SOURCES; i++)
+  {
+    if (sources[i].source == source)
+    {
+      f = &sources[i];
+      break;
+    }
+    if ((now - sources[i].us) > (now - f->us))
+      f = &sources[i];
+  }
+
+  if (f->source != source)
+  {
+    source_init(f, source);
+    reset = true;
+  }
+
+  *s = f;
+  *dt_us = now - f->us;
+  f->us = now;
+
+  return reset || (*dt_us > DT_RESET_US);
+}
+
+//
+// shape - deadzone and response curve, for a distance from the centre
+//
+static inline int32_t shape(int32_t r)
+{
+  int32_t dz = analog_tune.deadzone;
+  int32_t n, i, frac;
+
+  if (r <= dz)
+    return 0;
+
+  n = ((r - dz) * ANALOG_FULL) / (ANALOG_FULL - dz);
+  if (n >= ANALOG_FULL)
+    return n;                   // (the corners of a square gate: straight on)
+
+  i = n >> ANALOG_LUT_SHIFT;
+  frac = n & ((1 << ANALOG_LUT_SHIFT) - 1);
+
+  return lut[i] + (((lut[i + 1] - lut[i]) * frac) >> ANALOG_LUT_SHIFT);
+}
+
+static inline uint32_t isqrt(uint32_t v)
+{
+  uint32_t r = 0;
+  uint32_t b = 1u << 30;
+
+  while (b > v)
+    b >>= 2;
+
+  while (b)
+  {
+    if (v >= r + b)
+    {
+      v -= r + b;
+      r = (r >> 1) + b;
+    }
+    else
+      r >>= 1;
+    b >>= 2;
+  }
+  return r;
+}
+
+static inline uint32_t to_raw(int32_t v)
+{
+  if (v > ANALOG_FULL)
+    v = ANALOG_FULL;
+  else if (v < -ANALOG_FULL)
+    v = -ANALOG_FULL;
+
+  return 0x8000 + v;
+}
+
+void __not_in_flash_func(analog_condition)(uint32_t source, bool slider, uint32_t *x, uint32_t *y, uint32_t *t)
+{
+  uint32_t *axis[ANALOG_AXES] = { x, y, t };
+  int32_t v[ANALOG_AXES];
+  analog_source_t *f;
+  analog_cal_t *cal;
+  uint32_t dt_us;
+  int32_t r, m, dz;
+  bool reset;
+  int i;
+
+  reset = source_for(source, time_us_32(), &f, &dt_us);
+  if (dt_us < DT_MIN_US)
+    dt_us = DT_MIN_US;
+  latest = f;
+
+  for (i = 0; i < ANALOG_AXES; i++)
+  {
+    f->raw[i] = *axis[i];
+    cal = &f->cal[i];
+
+    if (measuring)
+    {
+      if (f->raw[i] < cal->low)
+        cal->low = f->raw[i];
+      if (f->raw[i] > cal->high)
+        cal->high = f->raw[i];
+    }
+
+    v[i] = calibrate(cal, f->raw[i]);
+
+    // (with the filter off, it follows the stick, to start from there)
+    if (reset || !analog_tune.filter)
+    {
+      f->axis[i].value = v[i] * 256;
+      f->axis[i].speed = 0;
+      f->axis[i].last = v[i];
+    }
+    else
+      v[i] = one_euro(&f->axis[i], v[i], dt_us);
+  }
+
+  // X/Y: the deadzone and curve go by the distance from the centre, so
+  // the direction is kept
+  r = isqrt((uint32_t)(v[ANALOG_X] * v[ANALOG_X]) + (uint32_t)(v[ANALOG_Y] * v[ANALOG_Y]));
+  m = shape(r);
+  *x = to_raw((r > 0) ? ((v[ANALOG_X] * m) / r) : 0);
+  *y = to_raw((r > 0) ? ((v[ANALOG_Y] * m) / r) : 0);
+
+  // a slider rests at either end, not in the middle: the deadzone is at
+  // the low end instead, and it is straight on from there
+  r = v[ANALOG_THROTTLE];
+  if (slider)
+  {
+    dz = analog_tune.deadzone;
+    r += ANALOG_FULL;
+    r = (r <= dz) ? 0 : (int32_t)(((uint32_t)(r - dz) * (2 * ANALOG_FULL)) / ((2 * ANALOG_FULL) - dz));
+    *t = to_raw(r - ANALOG_FULL);
+  }
+  else
+    *t = to_raw((r < 0) ? -shape(-r) : shape(r));
+}
+
+//--------------------------------------------------------------------+
+// Console
+//--------------------------------------------------------------------+
+
+static void analog_print(void)
+{
+  static const char axis_name[ANALOG_AXES] = { 'X', 'Y', 'T' };
+  analog_source_t *s;
+  analog_cal_t *cal;
+  int i, j;
+
+  printf("Analog: deadzone %d/%d, curve %s, filter %s (cutoff %d.%02d Hz, beta %d.%02d)%s\r\n",
+         analog_tune.deadzone, ANALOG_FULL, analog_curves[analog_tune.curve].name,
+         analog_tune.filter ? "on" : "off",
+         analog_tune.min_cutoff >> 4, ((analog_tune.min_cutoff & 15) * 100) >> 4,
+         analog_tune.beta >> 4, ((analog_tune.beta & 15) * 100) >> 4,
+         measuring ? ", measuring travel" : "");
+
+  for (j = 0; j < ANALOG_SOURCES; j++)
+  {
+    s = &sources[j];
+    if (s->source == 0)
+      continue;
+
+    printf("  controller %d.%d%s\r\n", (int)(s->source >> 8), (int)(s->source & 0xFF),
+           (s == latest) ? " (last to report)" : "");
+
+    for (i = 0; i < ANALOG_AXES; i++)
+    {
+      cal = &s->cal[i];
+      printf("    %c: %04x < %04x > %04x (now %04x)\r\n", axis_name[i], cal->low, cal->centre, cal->high, s->raw[i]);
+    }
+  }
+}
+
+void analog_command(int c)
+{
+  int i, j;
+
+  switch (c)
+  {
+    case 'a':
+      break;
+    case 'z':
+      for (i = 0; i < ANALOG_AXES; i++)
+        latest->cal[i].centre = latest->raw[i];
+      break;
+    case 'x':
+      measuring = !measuring;
+      if (measuring)
+      {
+        for (j = 0; j < ANALOG_SOURCES; j++)
+          for (i = 0; i < ANALOG_AXES; i++)
+          {
+            sources[j].cal[i].low = sources[j].raw[i];
+            sources[j].cal[i].high = sources[j].raw[i];
+          }
+      }
+      break;
+    case 'd':
+      if (analog_tune.deadzone >= 256)
+        analog_tune.deadzone -= 256;
+      break;
+    case 'D':
+      if (analog_tune.deadzone < 8192)
+        analog_tune.deadzone += 256;
+      break;
+    case 'k':
+      analog_tune.curve = (analog_tune.curve + 1) % ANALOG_CURVES;
+      analog_curve_build();
+      break;
+    case 'f':
+      analog_tune.filter = !analog_tune.filter;
+      break;
+    case 'n':
+      if (analog_tune.min_cutoff > 8)
+        analog_tune.min_cutoff -= 8;
+      break;
+    case 'N':
+      if (analog_tune.min_cutoff < (100 << 4))
+        analog_tune.min_cutoff += 8;
+      break;
+    case 'b':
+      if (analog_tune.beta >= 16)
+        analog_tune.beta -= 16;
+      break;
+    case 'B':
+      if (analog_tune.beta < (100 << 4))
+        analog_tune.beta += 16;
+      break;
+    case 'u':
+      measuring = false;
+      analog_init();
+      break;
+    default:
+      return;
+  }
+
+  // (while measuring, the ends only move outwards, and the gains are worked
+  // out when it stops)
+  if (!measuring)
+    for (j = 0; j < ANALOG_SOURCES; j++)
+      analog_gains(&sources[j]);
+  analog_print();
+}
@@ -0,0 +1,92 @@
+/*
+ * analog.h - conditioning of the analog axes (calibration, deadzone,
+ *            response curve and jitter filter), in fixed point
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _ANALOG_H_
+#define _ANALOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//--------------------------------------------------------------------+
+// Every report's X, Y and throttle pass through here on the way to the
+// frame encoder (see padmap_encode()), while they are still 16 bits:
+//
+//  1) calibration: the centre and each end of travel, per axis of each
+//     controller, scaled to +/-32767 (one multiply per axis; the gains are
+//     worked out when the calibration changes)
+//  2) jitter filter: a One-Euro filter per axis of each controller (a
+//     low-pass filter whose cutoff rises with the speed of the stick, so
+//     it smooths the stick at rest but adds little lag to a quick movement)
+//  3) deadzone (radial for X/Y) and response curve, as a table of 65
+//     points with straight lines between them; a throttle on a slider
+//     only has the deadzone, at its low end
+//
+// All of it is integer arithmetic (the divides go to the RP2040's
+// hardware divider), a few microseconds per report.
+//
+// The settings can be changed at any time from the console (see
+// analog_command()); they all run on core 0, as the reports do.
+//--------------------------------------------------------------------+
+
+#define ANALOG_X            0           // (same order as MAP_X ...)
+#define ANALOG_Y            1
+#define ANALOG_THROTTLE     2
+#define ANALOG_AXES         3
+
+#define ANALOG_FULL         32767       // calibrated full deflection
+
+#define ANALOG_LUT_SHIFT    9           // 32768 / 512 = 64 steps
+#define ANALOG_LUT_SIZE     ((ANALOG_FULL >> ANALOG_LUT_SHIFT) + 2)
+
+typedef struct
+{
+  uint16_t centre;                      // raw values (16 bits)
+  uint16_t low;
+  uint16_t high;
+  uint16_t span_low;                    // worked out from the above
+  uint16_t span_high;
+  uint32_t gain_low;                    // 20.12 fixed point
+  uint32_t gain_high;
+} analog_cal_t;
+
+typedef struct
+{
+  uint16_t     deadzone;                // out of ANALOG_FULL
+  uint8_t      curve;                   // see analog.c
+  bool         filter;
+  uint16_t     min_cutoff;              // Hz (12.4 fixed point) at rest
+  uint16_t     beta;                    // Hz (12.4) added per full deflection per second
+} analog_tune_t;
+
+extern analog_tune_t analog_tune;
+
+void analog_init(void);
+
+// raw values in, conditioned values out (16 bits, 0x8000 = centre)
+//   source: the controller (FRAME_SOURCE), for its calibration and filter
+//   slider: the throttle is a slider, rather than centred
+//
+void analog_condition(uint32_t source, bool slider, uint32_t *x, uint32_t *y, uint32_t *t);
+
+//
+// analog_command - console commands:
+//     'a' shows the settings
+//     'z' takes the sticks' current position as the centre (of the
+//         controller which reported last)
+//     'x' starts measuring the ends of travel of every controller (move
+//         each axis all the way), and again to stop
+//     'd'/'D' makes the deadzone smaller/larger
+//     'k' moves on to the next response curve
+//     'f' turns the filter on or off
+//     'n'/'N' lowers/raises the filter's cutoff at rest
+//     'b'/'B' lowers/raises how quickly the cutoff rises with speed
+//     'u' goes back to the defaults
+//
+void analog_command(int c);
+
+#endif /* _ANALOG_H_ */
@@ -0,0 +1,313 @@
+/*
+ * frame.c - hand-off of the XE-1AP frame (six status words) from the
+ *           USB side (core 0) to the console side (DMA)
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/dma.h"
+#include "protocol.pio.h"
+
+#include "frame.h"
+
+// The protocol state machine runs at the system clock, so the phases are
+// counted in system clock cycles; each phase edge must land within this
+// much of where the actual joystick puts it
+//
+#define TOLERANCE_NS    100
+
+#if XE1AP_HOST_MSX
+#define LOOP_CYCLES     DIRECT_LOOP_CYCLES
+#define PHASE_CYCLES    DIRECT_PHASE_CYCLES
+#else
+#define LOOP_CYCLES     PROTOCOL_LOOP_CYCLES
+#define PHASE_CYCLES    PROTOCOL_PHASE_CYCLES
+#endif
+
+// Levels of TRG1 (D0) and TRG2 (D1) while SEL is low
+//
+#define TRG_READY1      0       // TRG2 low:  first nybble valid
+#define TRG_READY2      1       // TRG2 low:  second nybble valid
+#define TRG_WAIT        2       // TRG1 low:  waiting for the next byte
+#define TRG_CHANGE      3       // both high: data changing
+
+// Which nybble is shown while SEL is high
+//
+#define NYB_FIRST       0
+#define NYB_SECOND      1
+#define NYB_NEXT        2       // first nybble of the next byte
+
+#define BYTE_PHASES     7
+
+typedef struct
+{
+  uint8_t trg;
+  uint8_t nybble;
+  uint8_t us;
+} phase_time_t;
+
+// Timings taken from an actual joystick
+//
+static const phase_time_t lead_in = { TRG_WAIT, NYB_FIRST, 68 };
+
+static const phase_time_t byte_phases[BYTE_PHASES] =
+{
+  { TRG_READY1, NYB_FIRST,  13 },   // data valid
+  { TRG_CHANGE, NYB_FIRST,   3 },   // data invalid (but still held)
+  { TRG_CHANGE, NYB_SECOND,  1 },
+  { TRG_READY2, NYB_SECOND, 13 },   // data valid
+  { TRG_CHANGE, NYB_SECOND,  4 },   // data invalid
+  { TRG_WAIT,   NYB_SECOND, 15 },
+  { TRG_WAIT,   NYB_NEXT,    1 },   // next byte set up
+};
+
+#if XE1AP_HOST_MSX
+// Pins 1-4 are the nybble bits 0-3
+//
+static const uint8_t pin_order[16] =
+{
+  0x0, 0x1, 0x2, 0x3, 0x4, 0x5, 0x6, 0x7,
+  0x8, 0x9, 0xA, 0xB, 0xC, 0xD, 0xE, 0xF
+};
+#else
+// The PC Engine reads D0-D3 as the nybble bits 0, 3, 1, 2
+// (the XE-1AP did not multiplex these in the same sequence as the Megadrive)
+//
+static const uint8_t pin_order[16] =
+{
+  0x0, 0x1, 0x4, 0x5, 0x8, 0x9, 0xC, 0xD,
+  0x2, 0x3, 0x6, 0x7, 0xA, 0xB, 0xE, 0xF
+};
+#endif
+
+// Phase words without the nybbles (count and TRG levels), in the same order
+// as the frame's phases; worked out once at startup, for the system clock
+//
+static uint32_t timing[FRAME_PHASES];
+
+static xe1ap_frame_t frames[3];
+
+static uint8_t latest = 0;              // newest complete frame
+static uint8_t writing = 1;             // frame being filled by core 0
+
+static int frame_dma = -1;              // the DMA channel which sends the phases
+
+#if !XE1AP_HOST_MSX
+static bool digital = false;            // the pad is sent instead of the frame
+#endif
+
+// read by the DMA chain at each CLR edge
+//
+static const uint32_t * volatile newest = frames[0].phase;
+
+
+static const phase_time_t *phase_time(int k)
+{
+  return (k == 0) ? &lead_in : &byte_phases[(k - 1) % BYTE_PHASES];
+}
+
+//
+// frame_timing - work out the count for each phase at this system clock
+//              - each phase ends at the cycle nearest to where it should, so the
+//                rounding is carried over from one phase to the next, instead of
+//                adding up across the frame
+//              - false if any phase edge is out of tolerance, or a phase is too
+//                short to be counted
+//
+static bool frame_timing(uint32_t sys_hz)
+{
+  uint64_t us = 0;              // where the phase should end (from the CLR edge)
+  uint64_t cycles = 0;          // and where it does
+  int64_t  want, error_ns;
+  uint32_t count;
+  bool ok = true;
+  int k;
+
+  for (k = 0; k < FRAME_PHASES - 1; k++)
+  {
+    us += phase_time(k)->us;
+    want = (int64_t)(((us * sys_hz) + 500000) / 1000000) - (int64_t)cycles;
+
+    if (want < PHASE_CYCLES + LOOP_CYCLES)
+    {
+      ok = false;
+      want = PHASE_CYCLES + LOOP_CYCLES;
+    }
+
+    count = (want - PHASE_CYCLES + (LOOP_CYCLES / 2)) / LOOP_CYCLES;
+    if (count > 0xFFFFFF)
+    {
+      ok = false;
+      count = 0xFFFFFF;
+    }
+    cycles += (count * LOOP_CYCLES) + PHASE_CYCLES;
+
+    error_ns = (int64_t)((cycles * 1000000000) / sys_hz) - (int64_t)(us * 1000);
+    if ((error_ns > TOLERANCE_NS) || (error_ns < -TOLERANCE_NS))
+      ok = false;
+
+    timing[k] = (count << 8) | phase_time(k)->trg;
+  }
+
+  // count 0: held until the next frame
+  timing[k] = phase_time(k)->trg;
+
+  return ok;
+}
+
+//
+// frame_build - turn the bytes of a frame into the phases which the protocol
+//               state machine plays back (see protocol.pio)
+//
+static void __not_in_flash_func(frame_build)(xe1ap_frame_t *frame)
+{
+  uint32_t rs = ((frame->word[0] >> FRAME_RUN_SELECT_SHIFT) & 0x03) << 2;
+  uint32_t *phase = frame->phase;
+  uint32_t nybble[3];
+  int i, j, k;
+
+  phase[0] = timing[0] | rs | (pin_order[frame->word[0] & 0x0F] << 4);
+  k = 1;
+
+  for (i = 0; i < FRAME_WORDS; i++)
+  {
+    nybble[NYB_FIRST]  = pin_order[frame->word[i] & 0x0F] << 4;
+    nybble[NYB_SECOND] = pin_order[(frame->word[i] >> 4) & 0x0F] << 4;
+    nybble[NYB_NEXT]   = (i < FRAME_WORDS - 1) ? (pin_order[frame->word[i + 1] & 0x0F] << 4) : 0;
+
+    // (the last byte stops at the phase which is held)
+    for (j = 0; (j < BYTE_PHASES) && (k < FRAME_PHASES); j++, k++)
+      phase[k] = timing[k] | rs | nybble[byte_phases[j].nybble];
+  }
+
+#if !XE1AP_HOST_MSX
+  // count 0 throughout: played through at once, and the last one held
+  for (k = 0; k < FRAME_PHASES; k++)
+    frame->pad_phase[k] = frame->pad & 0xFF;
+#endif
+}
+
+// the phases which the DMA chain is pointed at
+//
+static inline const uint32_t *sent(xe1ap_frame_t const *frame)
+{
+#if !XE1AP_HOST_MSX
+  if (digital)
+    return frame->pad_phase;
+#endif
+  return frame->phase;
+}
+
+bool frame_init(const xe1ap_frame_t *initial, uint32_t sys_hz)
+{
+  bool ok;
+  int i;
+
+  ok = frame_timing(sys_hz);
+
+  for (i = 0; i < 3; i++)
+  {
+    memcpy(&frames[i], initial, sizeof(xe1ap_frame_t));
+    frame_build(&frames[i]);
+    frames[i].source = 0;
+    frames[i].stamp_us = time_us_32();
+  }
+
+  latest = 0;
+  writing = 1;
+  newest = sent(&frames[0]);
+
+  return ok;
+}
+
+void frame_set_dma(int channel)
+{
+  frame_dma = channel;
+}
+
+//
+// frame_begin - a copy which is neither the newest (the only one the DMA
+//               chain can start on) nor the one the DMA is still sending
+//
+xe1ap_frame_t *__not_in_flash_func(frame_begin)(void)
+{
+  xe1ap_frame_t const *busy = NULL;
+  int i;
+
+  if (frame_dma >= 0)
+    busy = frame_sending(dma_hw->ch[frame_dma].read_addr);
+
+  for (i = 0; i < 3; i++)
+    if ((i != latest) && (&frames[i] != busy))
+      break;
+
+  writing = i;
+  return &frames[writing];
+}
+
+void __not_in_flash_func(frame_publish)(void)
+{
+  frame_build(&frames[writing]);
+  frames[writing].stamp_us = time_us_32();
+
+  __dmb();                // the whole frame is written before it is seen
+  newest = sent(&frames[writing]);
+
+  latest = writing;
+}
+
+const uint32_t * const volatile *frame_source(void)
+{
+  return &newest;
+}
+
+uint32_t frame_idle(void)
+{
+  return newest[FRAME_PHASES - 1];
+}
+
+#if !XE1AP_HOST_MSX
+//
+// frame_set_digital - the newest frame is already built both ways, so only
+//                     the pointer changes; a frame (or pad) already on its
+//                     way is not affected
+//
+void frame_set_digital(bool on)
+{
+  digital = on;
+  newest = sent(&frames[latest]);
+}
+
+bool frame_digital(void)
+{
+  return digital;
+}
+#endif
+
+// (at the end of the frame, the address is just past its last phase)
+//
+static inline bool reading(uintptr_t read_addr, const uint32_t *phases)
+{
+  return (read_addr >= (uintptr_t)phases) && (read_addr <= (uintptr_t)(phases + FRAME_PHASES));
+}
+
+xe1ap_frame_t const *__not_in_flash_func(frame_sending)(uintptr_t read_addr)
+{
+  int i;
+
+  for (i = 0; i < 3; i++)
+  {
+    if (reading(read_addr, frames[i].phase))
+      return &frames[i];
+#if !XE1AP_HOST_MSX
+    if (reading(read_addr, frames[i].pad_phase))
+      return &frames[i];
+#endif
+  }
+  return NULL;
+}
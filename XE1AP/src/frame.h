@@ -0,0 +1,112 @@
+/*
+ * frame.h - hand-off of the XE-1AP frame (six status words) from the
+ *           USB side (core 0) to the console side (DMA)
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _FRAME_H_
+#define _FRAME_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//--------------------------------------------------------------------+
+// Three copies of the frame are kept. At each CLR edge, a DMA chain
+// reads the pointer to the newest complete one, and copies that frame's
+// phases into the protocol state machine (see main.c), so every frame
+// sent to the console is from a single report, and no CPU is involved.
+//
+// Sending a frame takes a few hundred microseconds, and with two
+// controllers (or reports queued up while core 0 was busy) several
+// frames may be published meanwhile. So the copy core 0 fills is never
+// the newest one (the only one the DMA chain can start on), nor the one
+// the DMA is still reading (frame_sending()); of three, one is always left.
+//
+// PC Engine, digital mode: a game which reads a joypad gets a 2-button pad
+// instead (see main.c for how it is told apart). Each frame also keeps
+// the pad as a list of phases, every one of them held (count 0) with the
+// pad's two nybbles, and the DMA chain is pointed at those: the protocol
+// state machine then plays them through at once, and holds the pad,
+// following SEL, as a joypad would. Switching between the two is just
+// which list the pointer is set to, for the next CLR edge.
+//--------------------------------------------------------------------+
+
+// Host connector, chosen at build time (see CMakeLists.txt):
+// - PC Engine (default): the outputs are multiplexed by SEL, and the data is
+//   in PC Engine bit order (protocol program)
+// - MSX / X68000 / PC-98: TRG1/TRG2 and the data have their own pins, which
+//   are driven directly, with the data in its own bit order (direct program)
+//
+#ifndef XE1AP_HOST_MSX
+#define XE1AP_HOST_MSX  0
+#endif
+
+#define FRAME_WORDS     6
+
+// The lead-in, then 7 phases per byte; the last byte has no 7th (setting up
+// the next byte), and ends with the phase which is held until the next frame
+//
+#define FRAME_PHASES    (1 + (FRAME_WORDS * 7) - 1)
+
+typedef struct
+{
+  uint32_t word[FRAME_WORDS];     // one byte (two nybbles) each; see hid_app.c
+  uint32_t phase[FRAME_PHASES];   // as played by the protocol state machine; see protocol.pio
+  uint32_t pad;                   // digital mode (FRAME_PAD_IDLE: nothing pressed)
+#if !XE1AP_HOST_MSX
+  uint32_t pad_phase[FRAME_PHASES];   // the pad, held (see above)
+#endif
+  uint32_t source;                // which controller it is from (FRAME_SOURCE; 0 = none)
+  uint32_t stamp_us;              // when it was published
+} xe1ap_frame_t;
+
+#define FRAME_SOURCE(dev_addr, instance)  (((dev_addr) << 8) | (instance))
+
+// Run and Select (SEL low, D2/D3) are taken from these bits of word 0
+// (PC Engine only; otherwise they are only sent in the data)
+//
+#define FRAME_RUN_SELECT_SHIFT  4
+
+// The pad (active low), as the phase's nybbles: with SEL low, bits 0-3 are
+// I, II, Select and Run; with SEL high, bits 4-7 are Up, Right, Down and Left
+//
+#define FRAME_PAD_IDLE  0xFF
+
+// sys_hz: the system clock, which the phases are timed by;
+//         false if the protocol can't be timed closely enough at this clock
+//
+bool frame_init(const xe1ap_frame_t *initial, uint32_t sys_hz);
+
+// core 0: fill in the words, pad (and source) of the frame returned by frame_begin(),
+//         then publish it (which builds the phases, and stamps the time)
+//
+xe1ap_frame_t *frame_begin(void);
+void           frame_publish(void);
+
+// the DMA chain: where the pointer to the newest complete frame's phases is kept
+//
+const uint32_t * const volatile *frame_source(void);
+
+// the phase held between frames (and before the first one)
+//
+uint32_t frame_idle(void);
+
+#if !XE1AP_HOST_MSX
+// digital mode: send the pad from the next CLR edge on (or the frame again)
+//
+void frame_set_digital(bool digital);
+bool frame_digital(void);
+#endif
+
+// the DMA channel which copies the phases into the protocol state machine,
+// so that frame_begin() keeps off the copy it is still reading
+//
+void frame_set_dma(int channel);
+
+// the frame which the DMA chain is reading from, by its read address
+//
+xe1ap_frame_t const *frame_sending(uintptr_t read_addr);
+
+#endif /* _FRAME_H_ */
@@ -27,7 +27,12 @@
 #include "tusb.h"
 
 // ----  start of customization block for XE1AP --------
-extern uint32_t statusword0, statusword1, statusword2, statusword3, statusword4, statusword5;
+#include "pico/stdlib.h"
+
+#include "frame.h"
+#include "hid_layout.h"
+#include "padmap.h"
+#include "telemetry.h"
 // ----   end  of customization block for XE1AP --------
 
 
@@ -66,61 +71,24 @@ extern uint32_t statusword0, statusword1, statusword2, statusword3, statusword4,
   - Rumble Many devices provide force-feedback features. But are mostly just simple rumble motors.
  */
 
-// Sony DS4 report layout detail https://www.psdevwiki.com/ps4/DS4-USB
-typedef struct TU_ATTR_PACKED
+// One map per HID interface (see padmap.h)
+//
+#define HID_DEV_SLOTS   (CFG_TUH_DEVICE_MAX + 1)
+
+typedef struct
 {
-  uint8_t x, y, z, rz; // joystick
-
-  struct {
-    uint8_t dpad     : 4; // (hat format, 0x08 is released, 0=N, 1=NE, 2=E, 3=SE, 4=S, 5=SW, 6=W, 7=NW)
-    uint8_t square   : 1; // west
-    uint8_t cross    : 1; // south
-    uint8_t circle   : 1; // east
-    uint8_t triangle : 1; // north
-  };
-
-  struct {
-    uint8_t l1     : 1;
-    uint8_t r1     : 1;
-    uint8_t l2     : 1;
-    uint8_t r2     : 1;
-    uint8_t share  : 1;
-    uint8_t option : 1;
-    uint8_t l3     : 1;
-    uint8_t r3     : 1;
-  };
-
-  struct {
-    uint8_t ps      : 1; // playstation button
-    uint8_t tpad    : 1; // track pad click
-    uint8_t counter : 6; // +1 each report
-  };
-
-  // comment out since not used by this example
-  // uint8_t l2_trigger; // 0 released, 0xff fully pressed
-  // uint8_t r2_trigger; // as above
-
-  //  uint16_t timestamp;
-  //  uint8_t  battery;
-  //
-  //  int16_t gyro[3];  // x, y, z;
-  //  int16_t accel[3]; // x, y, z
-
-  // there is still lots more info
-
-} sony_ds4_report_t;
-
-// check if device is Sony DualShock 4
-static inline bool is_sony_ds4(uint8_t dev_addr)
+  bool     active;
+  padmap_t map;
+} pad_dev_t;
+
+static pad_dev_t pad_dev[HID_DEV_SLOTS][CFG_TUH_HID];
+
+static inline pad_dev_t *pad_lookup(uint8_t dev_addr, uint8_t instance)
 {
-  uint16_t vid, pid;
-  tuh_vid_pid_get(dev_addr, &vid, &pid);
+  if ((dev_addr >= HID_DEV_SLOTS) || (instance >= CFG_TUH_HID))
+    return NULL;
 
-  return ( (vid == 0x054c && (pid == 0x09cc || pid == 0x05c4)) // Sony DualShock4 
-           || (vid == 0x0f0d && pid == 0x005e)                 // Hori FC4 
-           || (vid == 0x0f0d && pid == 0x00ee)                 // Hori PS4 Mini (PS4-099U) 
-           || (vid == 0x1f4f && pid == 0x1002)                 // ASW GG xrd controller
-         );
+  return &pad_dev[dev_addr][instance];
 }
 
 //--------------------------------------------------------------------+
@@ -144,13 +112,34 @@ void hid_app_task(void)
 void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_report, uint16_t desc_len)
 {
   uint16_t vid, pid;
+  pad_dev_t *dev = pad_lookup(dev_addr, instance);
+  hid_layout_t layout;
+
   tuh_vid_pid_get(dev_addr, &vid, &pid);
 
   printf("HID device address = %d, instance = %d is mounted\r\n", dev_addr, instance);
   printf("VID = %04x, PID = %04x\r\n", vid, pid);
 
-  // Sony DualShock 4 [CUH-ZCT2x]
-  if ( is_sony_ds4(dev_addr) )
+  if (dev == NULL)
+    return;
+
+  // Known devices first (by VID/PID), then anything whose report descriptor
+  // shows a gamepad or joystick
+  if (padmap_find(&dev->map, vid, pid))
+  {
+    printf("Known controller\r\n");
+    dev->active = true;
+  }
+  else
+  {
+    hid_layout_parse(&layout, desc_report, desc_len);
+    dev->active = padmap_from_layout(&dev->map, &layout);
+    if (dev->active)
+      printf("Gamepad (%d buttons%s%s)\r\n", layout.buttons.size,
+             layout.x.size ? ", stick" : "", layout.hat.size ? ", hat" : "");
+  }
+
+  if (dev->active)
   {
     // request to receive report
     // tuh_hid_report_received_cb() will be invoked when report is available
@@ -164,155 +153,55 @@ void tuh_hid_mount_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* desc_re
 // Invoked when device with hid interface is un-mounted
 void tuh_hid_umount_cb(uint8_t dev_addr, uint8_t instance)
 {
-  printf("HID device address = %d, instance = %d is unmounted\r\n", dev_addr, instance);
-
-}
-
-// check if different than 2
-bool diff_than_2(uint8_t x, uint8_t y)
-{
-  return (x - y > 2) || (y - x > 2);
-}
+  pad_dev_t *dev = pad_lookup(dev_addr, instance);
 
-// check if 2 reports are different enough
-bool diff_report(sony_ds4_report_t const* rpt1, sony_ds4_report_t const* rpt2)
-{
-  bool result;
-
-  // x, y, z, rz must different than 2 to be counted
-  result = diff_than_2(rpt1->x, rpt2->x) || diff_than_2(rpt1->y , rpt2->y ) ||
-           diff_than_2(rpt1->z, rpt2->z) || diff_than_2(rpt1->rz, rpt2->rz);
-
-  // check the reset with mem compare
-  result |= memcmp(&rpt1->rz + 1, &rpt2->rz + 1, sizeof(sony_ds4_report_t)-4);
+  printf("HID device address = %d, instance = %d is unmounted\r\n", dev_addr, instance);
 
-  return result;
+  if (dev != NULL)
+    dev->active = false;
 }
 
-void process_sony_ds4(uint8_t const* report, uint16_t len)
+// Invoked when received report from device via interrupt endpoint
+void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
 {
-  const char* dpad_str[] = { "N", "NE", "E", "SE", "S", "SW", "W", "NW", "none" };
+  uint32_t now = time_us_32();
+  pad_dev_t *dev = pad_lookup(dev_addr, instance);
 
-  // previous report used to compare for changes
-  static sony_ds4_report_t prev_report = { 0 };
-
-
-////////////
-static absolute_time_t last_called = 0;
-static absolute_time_t current_time = 0;
-static uint32_t worst_time = 0;
-static uint32_t first_time = 0;
-////////////
-
-
-  uint8_t const report_id = report[0];
-  report++;
-  len--;
-
-  // all buttons state is stored in ID 1
-  if (report_id == 1)
+  if ((dev != NULL) && dev->active)
   {
-    sony_ds4_report_t ds4_report;
-    memcpy(&ds4_report, report, sizeof(ds4_report));
-
-current_time = get_absolute_time();
-if (first_time != 0) {
-  if (absolute_time_diff_us(last_called, current_time) > worst_time) {
-    printf("%d", absolute_time_diff_us(last_called, current_time));
-    if (absolute_time_diff_us(last_called, current_time) > worst_time) {
-      printf("*");
-      worst_time = absolute_time_diff_us(last_called, current_time);
-    }
-    printf("\n");
-  }
-}
-last_called = current_time;
-first_time = 1;
-
-    // counter is +1, assign to make it easier to compare 2 report
-    prev_report.counter = ds4_report.counter;
-
-// ----  start of customization block for XE1AP --------
-
-   // Note: Data is sent, 2 nybbles (1 wth TRG1 LOW, 1 with TRG1 HIGH) per cycle,
-   //       for 6 cycles of the data transmission. These are sent as bytes, with 
-   //       Nybble 2 as most significant, and nybble 1 as least-signifcant
-   //
-   // The nybbles are in the following sequence:
-   //  1) Buttons A, B, C, D (note: A is "pressed" is either A or A' is pressed; same with B/B')
-   //  2) Buttons E1, E2, Start, Select
-   //  3) most-significant 4 bits of 'Y' axis
-   //  4) most-significant 4 bits of 'X' axis
-   //  5) most-significant 4 bits of 'throttle' axis
-   //  6) 0000
-   //  7) least-significant 4 bits of 'Y' axis
-   //  8) least-significant 4 bits of 'X' axis
-   //  9) least-significant 4 bits of 'throttle' axis
-   // 10) 0000
-   // 11) Buttons A, B, A', B' (These are only able to be differentiated by this nybble)
-   // 12) 1111
-   //
-
-    statusword0 = (ds4_report.square ? 0 : 0x80) |
-                  (ds4_report.triangle ? 0 : 0x40) | 
-                  (ds4_report.option ? 0 : 0x20) |
-                  (ds4_report.share ? 0 : 0x10) | 
-                  ((ds4_report.circle || ds4_report.r1) ? 0 : 0x08) |
-                  ((ds4_report.cross || ds4_report.r2) ? 0 : 0x04) |
-                  (ds4_report.l1 ? 0 : 0x02) |
-                  (ds4_report.l2 ? 0 : 0x01);
-    statusword1 = (ds4_report.x & 0xF0) | ((ds4_report.y & 0xF0) >> 4);
-    statusword2 = ((255 - ds4_report.rz) & 0xF0) >> 4;
-    statusword3 = ((ds4_report.x & 0x0F) << 4) | (ds4_report.y & 0x0F);
-    statusword4 = ((255 - ds4_report.rz) & 0x0F);
-    statusword5 = 0xF0 | (ds4_report.circle ? 0 : 0x08) | (ds4_report.cross ? 0 : 0x04) |
-                  (ds4_report.r1 ? 0: 0x02) | (ds4_report.r2 ? 0: 0x01);
-
-// ----   end  of new code customization block for XE1AP --------
-
-    // only print if changes since it is polled ~ 5ms
-    // Since count+1 after each report and  x, y, z, rz fluctuate within 1 or 2
-    // We need more than memcmp to check if report is different enough
-    if ( diff_report(&prev_report, &ds4_report) )
+    // ----  start of customization block for XE1AP --------
+
+    // Note: Data is sent, 2 nybbles (1 wth TRG1 LOW, 1 with TRG1 HIGH) per cycle,
+    //       for 6 cycles of the data transmission. These are sent as bytes, with 
+    //       Nybble 2 as most significant, and nybble 1 as least-signifcant
+    //
+    // The nybbles are in the following sequence:
+    //  1) Buttons A, B, C, D (note: A is "pressed" is either A or A' is pressed; same with B/B')
+    //  2) Buttons E1, E2, Start, Select
+    //  3) most-significant 4 bits of 'Y' axis
+    //  4) most-significant 4 bits of 'X' axis
+    //  5) most-significant 4 bits of 'throttle' axis
+    //  6) 0000
+    //  7) least-significant 4 bits of 'Y' axis
+    //  8) least-significant 4 bits of 'X' axis
+    //  9) least-significant 4 bits of 'throttle' axis
+    // 10) 0000
+    // 11) Buttons A, B, A', B' (These are only able to be differentiated by this nybble)
+    // 12) 1111
+    //
+
+    xe1ap_frame_t *frame = frame_begin();
+
+    // the console only ever sees complete frames (and only from the report
+    // which holds the controls)
+    frame->source = FRAME_SOURCE(dev_addr, instance);
+    if (padmap_frame(&dev->map, report, len, frame))
     {
-// ----  start of commented-out code customization block for XE1AP --------
-
-//      printf("(x, y, z, rz) = (%u, %u, %u, %u)\r\n", ds4_report.x, ds4_report.y, ds4_report.z, ds4_report.rz);
-//      printf("DPad = %s ", dpad_str[ds4_report.dpad]);
-//
-//      if (ds4_report.square   ) printf("Square ");
-//      if (ds4_report.cross    ) printf("Cross ");
-//      if (ds4_report.circle   ) printf("Circle ");
-//      if (ds4_report.triangle ) printf("Triangle ");
-//
-//      if (ds4_report.l1       ) printf("L1 ");
-//      if (ds4_report.r1       ) printf("R1 ");
-//      if (ds4_report.l2       ) printf("L2 ");
-//      if (ds4_report.r2       ) printf("R2 ");
-//
-//      if (ds4_report.share    ) printf("Share ");
-//      if (ds4_report.option   ) printf("Option ");
-//      if (ds4_report.l3       ) printf("L3 ");
-//      if (ds4_report.r3       ) printf("R3 ");
-//
-//      if (ds4_report.ps       ) printf("PS ");
-//      if (ds4_report.tpad     ) printf("TPad ");
-//
-//      printf("\r\n");
-// ----   end  of commented-out code customization block for XE1AP --------
-
+      frame_publish();
+      telemetry_report(now, frame->source, padmap_counter(&dev->map, report, len), dev->map.counter_bits);
     }
 
-    prev_report = ds4_report;
-  }
-}
-
-// Invoked when received report from device via interrupt endpoint
-void tuh_hid_report_received_cb(uint8_t dev_addr, uint8_t instance, uint8_t const* report, uint16_t len)
-{
-  if ( is_sony_ds4(dev_addr) )
-  {
-    process_sony_ds4(report, len);
+    // ----   end  of customization block for XE1AP --------
   }
 
   // continue to request to receive report
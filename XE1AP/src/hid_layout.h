@@ -0,0 +1,54 @@
+/*
+ * hid_layout.h - where the fields are in a HID device's reports, found
+ *                once from its report descriptor (at mount)
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _HID_LAYOUT_H_
+#define _HID_LAYOUT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//--------------------------------------------------------------------+
+// The report descriptor is walked once, when the device is mounted;
+// the first gamepad or joystick application collection is used, and
+// the position of each field we need is recorded (see padmap.c for
+// how these are turned into the XE-1AP frame).
+//
+// (Taken from PCEMouse, keeping only what gamepads need.)
+//--------------------------------------------------------------------+
+
+enum
+{
+  HID_KIND_NONE = 0,
+  HID_KIND_GAMEPAD            // gamepads and joysticks
+};
+
+typedef struct
+{
+  uint16_t bit;               // offset from the start of the report's data
+  uint8_t  size;              // in bits (0 = not present)
+  bool     is_signed;
+  int32_t  lmin;              // logical range
+  int32_t  lmax;
+} hid_field_t;
+
+typedef struct
+{
+  uint8_t     kind;
+  uint8_t     report_id;      // 0 = reports have no ID byte
+  hid_field_t x;
+  hid_field_t y;
+  hid_field_t z;
+  hid_field_t rz;
+  hid_field_t slider;
+  hid_field_t hat;
+  hid_field_t buttons;        // button 1 upwards, one bit each (size = count)
+} hid_layout_t;
+
+void hid_layout_parse(hid_layout_t *layout, uint8_t const *desc, uint16_t desc_len);
+
+#endif /* _HID_LAYOUT_H_ */
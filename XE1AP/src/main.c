@@ -50,11 +50,18 @@
 
 #include "pico/stdlib.h"
 #include "pico/time.h"
-#include "pico/multicore.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
 #include "hardware/pio.h"
+#include "hardware/vreg.h"
 #include "clock.pio.h"
 #include "protocol.pio.h"
-#include "multplex.pio.h"
+
+#include "analog.h"
+#include "frame.h"
+#include "telemetry.h"
+#include "xinput.h"
 
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
@@ -63,6 +70,19 @@
 
 #ifdef ADAFRUIT_KB2040          // if build for Adafruit KB2040 board
 
+#if XE1AP_HOST_MSX              // MSX / X68000 / PC-98 board (see frame.h)
+
+#define CLKIN_PIN       19              // REQ (connector pin 8); active low, so its input is inverted
+
+#define TRG1_PIN        2               // connector pin 6; Note - start of the 'out' group
+#define TRG2_PIN        3               // connector pin 7
+#define DATA0_PIN       6               // connector pins 1-4; must be TRG1_PIN + 4
+#define DATA1_PIN       7
+#define DATA2_PIN       8
+#define DATA3_PIN       9
+
+#else                           // PC Engine board
+
 #define DATAIN_PIN      18
 #define CLKIN_PIN       DATAIN_PIN + 1  // Note - in pins must be a consecutive 'in' group
 
@@ -71,37 +91,123 @@
 #define OUTD2_PIN       28
 #define OUTD3_PIN       29
 
-#define TEMPD0_PIN      2		// Note - 'out' pins for protocol, 'in' pins for multplex
-#define TEMPD1_PIN      3
-#define TEMPD2_PIN      4
-#define TEMPD3_PIN      5
-#define TEMPD4_PIN      6
-#define TEMPD5_PIN      7
-#define TEMPD6_PIN      8
-#define TEMPD7_PIN      9
+#endif
 
 #endif
 
+// System clock: the XE-1AP timing is worked out from whichever is chosen,
+// and a faster one gets each USB report handled sooner
+//
+#define SYS_CLOCK_KHZ   125000          // SDK default
+//#define SYS_CLOCK_KHZ   200000
+//#define SYS_CLOCK_KHZ   250000          // core voltage is raised for this one
+
 //--------------------------------------------------------------------+
 // MACRO CONSTANT TYPEDEF PROTYPES
 //--------------------------------------------------------------------+
 void led_blinking_task(void);
+void console_task(void);
 
 extern void cdc_task(void);
 extern void hid_app_task(void);
 
-uint32_t statusword0, statusword1, statusword2, statusword3, statusword4, statusword5;
-uint32_t outword0, outword1, outword2, outword3, outword4, outword5;
-volatile bool output_exclude;
+// Initial values at startup
+// before any USB packets come in
+//
+static const xe1ap_frame_t initial_frame =
+{
+  { 0x000000FF, 0x00000077, 0x00000007, 0x000000FF, 0x0000000F, 0x000000FF },
+  .pad = FRAME_PAD_IDLE
+};
 
 PIO pio;
-uint sm1, sm2, sm3;   // sm1 = clock; sm2 = protocol; sm3 = multplex
+uint sm1, sm2;        // sm1 = clock; sm2 = protocol
+#if !XE1AP_HOST_MSX
+uint sm3;             // sm3 = detect (XE-1AP protocol or joypad scan)
+
+// CLR still high this long after it rises: the XE-1AP protocol (a joypad
+// scan only pulses it; see clock.pio)
+//
+#define DETECT_WINDOW_US        16
+#endif
+
+// DMA chain which sends a frame at each CLR edge:
+//   dma_edge  - waits for the clock state machine's edge word (and discards it)
+//   dma_point - points dma_frame at the newest complete frame (see frame.h)
+//   dma_frame - copies the frame's phases into the protocol state machine,
+//               then re-arms dma_edge for the next edge
+//
+static int dma_edge, dma_point, dma_frame;
+static uint32_t dma_discard;
+
+#ifdef TELEMETRY
+//
+// frame_edge_irq - at each CLR edge, once dma_point has started dma_frame on
+//                  a frame: how old that frame is (this only measures; the
+//                  frame is already on its way without it)
+//
+static void __not_in_flash_func(frame_edge_irq)(void)
+{
+  uint32_t now = time_us_32();
+  xe1ap_frame_t const *f;
+
+  dma_hw->ints0 = 1u << dma_point;
+
+  f = frame_sending(dma_hw->ch[dma_frame].read_addr);
+  if (f != NULL)
+    telemetry_edge(now, f->source, now - f->stamp_us);
+}
+#endif
+
+#if !XE1AP_HOST_MSX
+//
+// mode_task - follow the way the console reads the controller, from the
+//             newest CLR edge which the detect state machine has timed:
+//             digital mode (a 2-button pad; see frame.h) as soon as a game
+//             scans it as a joypad, and back to the XE-1AP protocol as
+//             soon as one reads it as that.
+//
+//     Note: The edge which shows the change has already been answered the
+//           old way, so the frame (or scan) read from it is lost; the next
+//           one is the new way. One is all that is lost: the detect state
+//           machine has its answer within DETECT_WINDOW_US of the edge,
+//           and this loop comes round well within a frame.
+//
+static void mode_task(void)
+{
+  uint32_t window = DETECT_HELD;
+  bool seen = false;
+  bool digital;
+
+  while (!pio_sm_is_rx_fifo_empty(pio, sm3))
+  {
+    window = pio_sm_get(pio, sm3);
+    seen = true;
+  }
+
+  if (!seen)
+    return;
+
+  digital = (window != DETECT_HELD);
+  if (digital == frame_digital())
+    return;
+
+  frame_set_digital(digital);
+
+  // and hold the new way's idle phase, unless a frame is on its way (that
+  // one ends by holding its own, until the next edge)
+  if (!dma_channel_is_busy(dma_frame))
+    pio_sm_put(pio, sm2, frame_idle());
 
+  printf("Console reads %s\r\n", digital ? "a joypad (digital mode)" : "the XE-1AP protocol");
+}
+#endif
 
 // process_signals - inner-loop processing of events:
 //                   - USB polling
 //                   - event processing
 //                   - detection of when a PCE scan is no longer in process (reset period)
+//                   - which way the console reads the controller (PC Engine)
 //
 static void __not_in_flash_func(process_signals)(void)
 {
@@ -112,6 +218,11 @@ static void __not_in_flash_func(process_signals)(void)
 #ifndef ADAFRUIT_QTPY_RP2040
     led_blinking_task();
 #endif
+    telemetry_task();
+    console_task();
+#if !XE1AP_HOST_MSX
+    mode_task();
+#endif
 
 #if CFG_TUH_CDC
     cdc_task();
@@ -120,75 +231,90 @@ static void __not_in_flash_func(process_signals)(void)
 #if CFG_TUH_HID
     hid_app_task();
 #endif
-
-    if (!output_exclude) {
-       outword0 = statusword0;
-       outword1 = statusword1;
-       outword2 = statusword2;
-       outword3 = statusword3;
-       outword4 = statusword4;
-       outword5 = statusword5;
-    }
-    gpio_put(TEMPD2_PIN, outword0 & 0x10);
-    gpio_put(TEMPD3_PIN, outword0 & 0x20);  // After remapping
   }
 }
 
 //
-// core1_entry - inner-loop for the second core
-//             - when the "CLR" line is de-asserted, set lock flag
-//               protecting the output state machine from inconsistent data
+// frame_dma_init - set up the DMA chain which sends each frame, so that
+//                  (after the posedge of CLR) the frame reaches the protocol
+//                  state machine with no help from either CPU
+//
+//     Note: Data is sent, 2 nybbles (1 wth TRG1 LOW, 1 with TRG1 HIGH) per cycle,
+//           for 6 cycles of the data transmission. These are kept as bytes, with
+//           Nybble 2 as most significant, and nybble 1 as least-signifcant, and
+//           made into timed phases for the protocol state machine (see frame.c)
 //
-static void __not_in_flash_func(core1_entry)(void)
+//     The nybbles are in the following sequence:
+//      1) Buttons A, B, C, D (note: A is "pressed" is either A or A' is pressed; same with B/B')
+//      2) Buttons E1, E2, Start, Select
+//      3) most-significant 4 bits of 'Y' axis
+//      4) most-significant 4 bits of 'X' axis
+//      5) most-significant 4 bits of 'throttle' axis
+//      6) 0000
+//      7) least-significant 4 bits of 'Y' axis
+//      8) least-significant 4 bits of 'X' axis
+//      9) least-significant 4 bits of 'throttle' axis
+//     10) 0000
+//     11) Buttons A, B, A', B' (These are only able to be differentiated by this nybble)
+//     12) 1111
+//
+//     The protocol state machine takes exactly one frame's phases per edge, so
+//     the FIFO stays in step without being cleared.
+//
+static void frame_dma_init(void)
 {
-static bool rx_bit = 0;
+  dma_channel_config c;
+
+  dma_edge = dma_claim_unused_channel(true);
+  dma_point = dma_claim_unused_channel(true);
+  dma_frame = dma_claim_unused_channel(true);
+
+  c = dma_channel_get_default_config(dma_frame);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, true);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm2, true));
+  channel_config_set_chain_to(&c, dma_edge);
+  dma_channel_configure(dma_frame, &c, &pio->txf[sm2], NULL, FRAME_PHASES, false);
+  frame_set_dma(dma_frame);
+
+  c = dma_channel_get_default_config(dma_point);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  dma_channel_configure(dma_point, &c, &dma_hw->ch[dma_frame].al3_read_addr_trig,
+                        frame_source(), 1, false);
+
+  c = dma_channel_get_default_config(dma_edge);
+  channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+  channel_config_set_read_increment(&c, false);
+  channel_config_set_write_increment(&c, false);
+  channel_config_set_dreq(&c, pio_get_dreq(pio, sm1, false));
+  channel_config_set_chain_to(&c, dma_point);
+  dma_channel_configure(dma_edge, &c, &dma_discard, &pio->rxf[sm1], 1, false);
+
+#ifdef TELEMETRY
+  dma_channel_set_irq0_enabled(dma_point, true);
+  irq_set_exclusive_handler(DMA_IRQ_0, frame_edge_irq);
+  irq_set_enabled(DMA_IRQ_0, true);
+#endif
 
-  while (1)
-  {
-     // wait for (and sync with) posedge of CLR signal; rx_data is throwaway
-     rx_bit = pio_sm_get_blocking(pio, sm1);
-
-     pio_sm_clear_fifos(pio, sm2);
-
-     // Now we are in an update-sequence; set a lock
-     // to prevent update during output transaction
-     output_exclude = true;
-
-     // Assume data is already formatted in output_word and push it to the state machine
-     //
-     // Note: Data is sent, 2 nybbles (1 wth TRG1 LOW, 1 with TRG1 HIGH) per cycle,
-     //       for 6 cycles of the data transmission. These are sent as bytes, with
-     //       Nybble 2 as most significant, and nybble 1 as least-signifcant
-     //
-     // The nybbles are in the following sequence:
-     //  1) Buttons A, B, C, D (note: A is "pressed" is either A or A' is pressed; same with B/B')
-     //  2) Buttons E1, E2, Start, Select
-     //  3) most-significant 4 bits of 'Y' axis
-     //  4) most-significant 4 bits of 'X' axis
-     //  5) most-significant 4 bits of 'throttle' axis
-     //  6) 0000
-     //  7) least-significant 4 bits of 'Y' axis
-     //  8) least-significant 4 bits of 'X' axis
-     //  9) least-significant 4 bits of 'throttle' axis
-     // 10) 0000
-     // 11) Buttons A, B, A', B' (These are only able to be differentiated by this nybble)
-     // 12) 1111
-     //
-
-     pio_sm_put_blocking(pio, sm2, outword0);
-     pio_sm_put_blocking(pio, sm2, outword1);
-     pio_sm_put_blocking(pio, sm2, outword2);
-     pio_sm_put_blocking(pio, sm2, outword3);
-     pio_sm_put_blocking(pio, sm2, outword4);
-     pio_sm_put_blocking(pio, sm2, outword5);
-
-     output_exclude = false;
-  }
+  dma_channel_start(dma_edge);
 }
 
 /*------------- MAIN -------------*/
 int main(void)
 {
+bool clock_ok;
+
+  // Before anything (UART, USB, PIO) is set up from the system clock
+  if (SYS_CLOCK_KHZ > 200000)
+  {
+    vreg_set_voltage(VREG_VOLTAGE_1_15);
+    sleep_ms(10);
+  }
+  clock_ok = set_sys_clock_khz(SYS_CLOCK_KHZ, false);
+
   board_init();
 
   // Pause briefly for stability before starting activity
@@ -197,18 +323,19 @@ int main(void)
   printf("TinyUSB Host HID Controller Example\r\n");
   printf("Note: Events only displayed for explictly supported controllers\r\n");
 
-//
-// Initialize the pins representing SEL and START on the multiplexed nybble
-// All others belong to the PIOs
-//
-  gpio_init(TEMPD2_PIN);
-  gpio_set_dir(TEMPD2_PIN, true);
-  gpio_put(TEMPD2_PIN, 1);
+  if (!clock_ok)
+    printf("System clock of %d kHz not possible; staying at %lu kHz\r\n", SYS_CLOCK_KHZ,
+           (unsigned long)(clock_get_hz(clk_sys) / 1000));
 
-  gpio_init(TEMPD3_PIN);
-  gpio_set_dir(TEMPD3_PIN, true);
-  gpio_put(TEMPD3_PIN, 1);
+  analog_init();
+  telemetry_init();
 
+  if (!frame_init(&initial_frame, clock_get_hz(clk_sys)))
+    printf("XE-1AP timing is out of tolerance at %lu Hz\r\n", (unsigned long)clock_get_hz(clk_sys));
+
+#if CFG_TUH_XINPUT && !XINPUT_HOST
+  printf("Xbox controllers need TinyUSB 0.16 or later\r\n");
+#endif
 
   tusb_init();
 
@@ -221,43 +348,50 @@ int main(void)
   uint offset1 = pio_add_program(pio, &clock_program);
   sm1 = pio_claim_unused_sm(pio, true);
   clock_program_init(pio, sm1, offset1, CLKIN_PIN);
+#if XE1AP_HOST_MSX
+  gpio_set_inover(CLKIN_PIN, GPIO_OVERRIDE_INVERT);   // the frame starts as REQ goes low
+#endif
 
-printf("pio1=%d; sm=%d; offset=%d; CLKIN_PIN=%d\n", pio, sm1, offset1, CLKIN_PIN);
+printf("pio1=%u; sm=%u; offset=%u; CLKIN_PIN=%d\n", pio_get_index(pio), sm1, offset1, CLKIN_PIN);
 
 
-  // Load the protocol (timed output) program, and configure a free state machine
+#if XE1AP_HOST_MSX
+  // Load the direct (timed output) program, and configure a free state machine
   // to run the program.
-  // Note that D0-D1 (button 1 & 2) are controlled by the "SET" pin group
-  //           D2-D3 (select/RUN buttons) are controlled by the GPIOs
-  //           D4-D7 (directions) are controlled by the "OUT" pin group
+  // Note that TRG1/TRG2 and the data nybble are all on their own pins
 
-  uint offset2 = pio_add_program(pio, &protocol_program);
+  uint offset2 = pio_add_program(pio, &direct_program);
   sm2 = pio_claim_unused_sm(pio, true);
-  protocol_program_init(pio, sm2, offset2, TEMPD0_PIN, TEMPD4_PIN);
+  direct_program_init(pio, sm2, offset2, TRG1_PIN, frame_idle());
 
-printf("pio2=%d; sm=%d; offset=%d; TEMPD0_PIN=%d, TEMPD4_PIN=%d\n", pio, sm2, offset2, TEMPD0_PIN, TEMPD4_PIN);
+printf("pio2=%u; sm=%u; offset=%u; TRG1=%d; DATA0=%d\n", pio_get_index(pio), sm2, offset2, TRG1_PIN, DATA0_PIN);
+#else
+  // Load the protocol (timed and multiplexed output) program, and configure a free
+  // state machine to run the program.
+  // Note that with SEL low,  D0-D1 are TRG1/TRG2 and D2-D3 are Run/Select
+  //           with SEL high, D0-D3 are the data nybble
 
+  uint offset2 = pio_add_program(pio, &protocol_program);
+  sm2 = pio_claim_unused_sm(pio, true);
+  protocol_program_init(pio, sm2, offset2, DATAIN_PIN, OUTD0_PIN, frame_idle());
 
-  // Load the plex (multiplex output) program, and configure a free state machine
-  // to run the program.
+printf("pio2=%u; sm=%u; offset=%u; DATAIN=%d; OUTD0=%d\n", pio_get_index(pio), sm2, offset2, DATAIN_PIN, OUTD0_PIN);
 
-  uint offset3 = pio_add_program(pio, &multplex_program);
+  // Load the detect program, which times CLR at each rising edge (so that a
+  // game reading a joypad gets one; see mode_task), and configure a free
+  // state machine to run the program.
+  // Note that this fills the PIO's instruction memory
+
+  uint offset3 = pio_add_program(pio, &detect_program);
   sm3 = pio_claim_unused_sm(pio, true);
-  multplex_program_init(pio, sm3, offset3, DATAIN_PIN, TEMPD0_PIN, OUTD0_PIN);
+  detect_program_init(pio, sm3, offset3, CLKIN_PIN, DETECT_WINDOW_US, clock_get_hz(clk_sys));
 
-printf("pio3=%d; sm=%d; offset=%d; DATAIN=%d; TEMPD0=%d; OUTD0=%d\n", pio, sm3, offset3, DATAIN_PIN, TEMPD0_PIN, OUTD0_PIN);
+printf("pio3=%u; sm=%u; offset=%u; CLKIN_PIN=%d\n", pio_get_index(pio), sm3, offset3, CLKIN_PIN);
+#endif
 
-// Initial values at startup
-// before any USB packets come in
-//
-  statusword0 = 0x000000FF;
-  statusword1 = 0x00000077;
-  statusword2 = 0x00000007;
-  statusword3 = 0x000000FF;
-  statusword4 = 0x0000000F;
-  statusword5 = 0x000000FF;
 
-  multicore_launch_core1(core1_entry);
+  // From here on, each frame is sent by DMA; core 1 is not used
+  frame_dma_init();
 
   process_signals();
 
@@ -285,3 +419,23 @@ void led_blinking_task(void)
 //  board_led_write(led_state);
   led_state = 1 - led_state; // toggle
 }
+
+//--------------------------------------------------------------------+
+// Console (UART) commands
+//--------------------------------------------------------------------+
+void console_task(void)
+{
+  const uint32_t interval_us = 20000;
+  static uint32_t start_us = 0;
+  int c;
+
+  // Poll every interval us
+  if (time_us_32() - start_us < interval_us) return; // not enough time
+  start_us = time_us_32();
+
+  c = getchar_timeout_us(0);
+  if (c == PICO_ERROR_TIMEOUT) return;
+
+  analog_command(c);
+  telemetry_command(c);
+}
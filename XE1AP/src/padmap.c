@@ -0,0 +1,399 @@
+/*
+ * padmap.c - turns a USB gamepad's report into the XE-1AP frame,
+ *            from a small per-device table
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "analog.h"
+#include "padmap.h"
+
+// Table entries
+//
+#define AXIS8(byte, flip)   { (byte), 0, 0xFF, 0, (flip) }
+#define HAT4(byte, shift)   { (byte), (shift), 0x0F, 0, 0 }
+#define NO_AXIS             AXIS8(MAP_CENTER, 0)
+#define NO_HAT              HAT4(MAP_CENTER, 4)     // (0x80 >> 4 = 8: centred)
+#define BUTTON(byte, bit)   { (byte), (bit) }
+#define NO_BUTTON           BUTTON(MAP_ZERO, 0)
+
+// Digital mode (see frame.h): how far the stick goes from the centre, at
+// 8 bits, before it is a direction
+//
+#define PAD_THRESHOLD   0x40
+
+// Sony DS4 report layout detail https://www.psdevwiki.com/ps4/DS4-USB
+// (after the report ID):
+//   0-3: X, Y, Z, Rz
+//   4:   hat (bits 0-3), square, cross, circle, triangle
+//   5:   L1, R1, L2, R2, share, option, L3, R3
+//   6:   PS, T-pad click, report counter (bits 2-7)
+//
+static const padmap_t ds4_map =
+{
+  .report_id = 1,
+  .axis =
+  {
+    [MAP_X]        = AXIS8(0, 0),
+    [MAP_Y]        = AXIS8(1, 0),
+    [MAP_THROTTLE] = AXIS8(3, 0xFF),      // right stick, up for more
+  },
+  .slider = false,
+  .hat = HAT4(4, 0),
+  .hat_min = 0,
+  .button =
+  {
+    [MAP_A]      = BUTTON(4, 6),          // circle
+    [MAP_B]      = BUTTON(4, 5),          // cross
+    [MAP_C]      = BUTTON(5, 0),          // L1
+    [MAP_D]      = BUTTON(5, 2),          // L2
+    [MAP_E1]     = BUTTON(4, 4),          // square
+    [MAP_E2]     = BUTTON(4, 7),          // triangle
+    [MAP_START]  = BUTTON(5, 5),          // option
+    [MAP_SELECT] = BUTTON(5, 4),          // share
+    [MAP_A2]     = BUTTON(5, 1),          // R1
+    [MAP_B2]     = BUTTON(5, 3),          // R2
+  },
+  .counter_byte = 6,
+  .counter_shift = 2,
+  .counter_bits = 6,
+};
+
+typedef struct
+{
+  uint16_t        vid;
+  uint16_t        pid;
+  padmap_t const *map;
+} padmap_device_t;
+
+static const padmap_device_t devices[] =
+{
+  { 0x054c, 0x09cc, &ds4_map },           // Sony DualShock4
+  { 0x054c, 0x05c4, &ds4_map },
+  { 0x0f0d, 0x005e, &ds4_map },           // Hori FC4
+  { 0x0f0d, 0x00ee, &ds4_map },           // Hori PS4 Mini (PS4-099U)
+  { 0x1f4f, 0x1002, &ds4_map },           // ASW GG xrd controller
+};
+
+// Report descriptor devices: which HID button (from 1) is which XE-1AP button
+// (in the order most pads number them: west, south, east, north, L1, R1, L2, R2,
+// select, start)
+//
+static const uint8_t generic_buttons[MAP_BUTTONS] =
+{
+  [MAP_A]      = 3,
+  [MAP_B]      = 2,
+  [MAP_C]      = 5,
+  [MAP_D]      = 7,
+  [MAP_E1]     = 1,
+  [MAP_E2]     = 4,
+  [MAP_START]  = 10,
+  [MAP_SELECT] = 9,
+  [MAP_A2]     = 6,
+  [MAP_B2]     = 8,
+};
+
+// Hat switch as axes: N, NE, E, SE, S, SW, W, NW, then centred
+//
+static const uint8_t hat_x[16] =
+{
+  0x80, 0xFF, 0xFF, 0xFF, 0x80, 0x00, 0x00, 0x00,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+static const uint8_t hat_y[16] =
+{
+  0x00, 0x00, 0x80, 0xFF, 0xFF, 0xFF, 0x80, 0x00,
+  0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80
+};
+
+// and as d-pad directions (digital mode)
+//
+#define DIR_UR  (MAP_DIR_UP | MAP_DIR_RIGHT)
+#define DIR_DR  (MAP_DIR_DOWN | MAP_DIR_RIGHT)
+#define DIR_DL  (MAP_DIR_DOWN | MAP_DIR_LEFT)
+#define DIR_UL  (MAP_DIR_UP | MAP_DIR_LEFT)
+
+static const uint8_t hat_dirs[16] =
+{
+  MAP_DIR_UP, DIR_UR, MAP_DIR_RIGHT, DIR_DR, MAP_DIR_DOWN, DIR_DL, MAP_DIR_LEFT, DIR_UL,
+  0, 0, 0, 0, 0, 0, 0, 0
+};
+
+
+bool padmap_find(padmap_t *map, uint16_t vid, uint16_t pid)
+{
+  unsigned i;
+
+  for (i = 0; i < sizeof(devices) / sizeof(devices[0]); i++)
+  {
+    if ((devices[i].vid == vid) && (devices[i].pid == pid))
+    {
+      *map = *devices[i].map;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static int bit_length(uint32_t v)
+{
+  int n = 0;
+
+  while (v)
+  {
+    n++;
+    v >>= 1;
+  }
+  return n;
+}
+
+//
+// field_axis - the top 8 bits of a field's logical range, as an axis
+//
+static void field_axis(map_field_t *f, hid_field_t const *h, bool reverse)
+{
+  static const map_field_t none = NO_AXIS;
+  uint32_t span;
+  int bits;
+  int top;
+
+  if ((h->size == 0) || ((h->bit >> 3) >= MAP_REPORT_MAX))
+  {
+    *f = none;
+    return;
+  }
+
+  // a 10-bit stick sent in 16 bits still fills the whole range
+  if (h->lmin < 0)
+  {
+    span = ((uint32_t)(-(h->lmin + 1)) > (uint32_t)h->lmax) ? (uint32_t)(-(h->lmin + 1)) : (uint32_t)h->lmax;
+    bits = bit_length(span) + 1;
+  }
+  else
+    bits = bit_length((uint32_t)h->lmax);
+
+  if ((bits < 1) || (bits > h->size) || (h->lmax <= h->lmin))
+    bits = h->size;
+
+  if (bits >= 8)
+  {
+    top = h->bit + bits - 8;
+    f->byte = top >> 3;
+    f->shift = top & 7;
+    f->mask = 0xFF;
+    f->left = 0;
+  }
+  else
+  {
+    f->byte = h->bit >> 3;
+    f->shift = h->bit & 7;
+    f->mask = (1 << bits) - 1;
+    f->left = 8 - bits;
+  }
+
+  f->flip = (h->is_signed ? 0x80 : 0) ^ (reverse ? 0xFF : 0);
+
+  if (f->byte >= MAP_REPORT_MAX)
+    *f = none;
+}
+
+//
+// padmap_from_layout - a map for a device which isn't in the table, from the
+//                      fields found in its report descriptor
+//
+bool padmap_from_layout(padmap_t *map, hid_layout_t const *layout)
+{
+  static const map_field_t no_hat = NO_HAT;
+  static const map_field_t hat_axis[2] = { AXIS8(MAP_HAT_X, 0), AXIS8(MAP_HAT_Y, 0) };
+  uint16_t bit;
+  int i;
+
+  if (layout->kind != HID_KIND_GAMEPAD)
+    return false;
+
+  map->report_id = layout->report_id;
+  map->counter_bits = 0;
+
+  // the stick, or else the hat switch
+  if (layout->x.size && layout->y.size)
+  {
+    field_axis(&map->axis[MAP_X], &layout->x, false);
+    field_axis(&map->axis[MAP_Y], &layout->y, false);
+  }
+  else
+  {
+    map->axis[MAP_X] = hat_axis[0];
+    map->axis[MAP_Y] = hat_axis[1];
+  }
+
+  // a slider, or else the right stick (up for more), or else Z
+  map->slider = (layout->slider.size != 0);
+  if (layout->slider.size)
+    field_axis(&map->axis[MAP_THROTTLE], &layout->slider, true);
+  else if (layout->rz.size)
+    field_axis(&map->axis[MAP_THROTTLE], &layout->rz, true);
+  else
+    field_axis(&map->axis[MAP_THROTTLE], &layout->z, false);
+
+  if (layout->hat.size && ((layout->hat.bit >> 3) < MAP_REPORT_MAX))
+  {
+    map->hat.byte = layout->hat.bit >> 3;
+    map->hat.shift = layout->hat.bit & 7;
+    map->hat.mask = 0x0F;
+    map->hat.left = 0;
+    map->hat.flip = 0;
+    map->hat_min = layout->hat.lmin;
+  }
+  else
+  {
+    map->hat = no_hat;
+    map->hat_min = 0;
+  }
+
+  for (i = 0; i < MAP_BUTTONS; i++)
+  {
+    bit = layout->buttons.bit + generic_buttons[i] - 1;
+
+    if ((generic_buttons[i] <= layout->buttons.size) && ((bit >> 3) < MAP_REPORT_MAX))
+    {
+      map->button[i].byte = bit >> 3;
+      map->button[i].bit = bit & 7;
+    }
+    else
+    {
+      map->button[i].byte = MAP_ZERO;
+      map->button[i].bit = 0;
+    }
+  }
+
+  return true;
+}
+
+static inline uint32_t field_get(uint8_t const *buf, map_field_t const *f)
+{
+  uint32_t w = buf[f->byte] | (buf[f->byte + 1] << 8);
+
+  return ((((w >> f->shift) & f->mask) << f->left) ^ f->flip) & 0xFF;
+}
+
+//
+// padmap_frame - one report into the frame's six bytes (see hid_app.c for the
+//                order of the nybbles); the same work whatever the report holds
+//
+bool __not_in_flash_func(padmap_frame)(padmap_t const *map, uint8_t const *report, uint16_t len,
+                                       xe1ap_frame_t *frame)
+{
+  uint8_t buf[MAP_SCRATCH];
+  uint32_t hat, x, y, t;
+  uint32_t p = 0;             // pressed, one bit per XE-1AP button
+  int i;
+
+  if (map->report_id != 0)
+  {
+    if ((len == 0) || (report[0] != map->report_id))
+      return false;
+
+    report++;
+    len--;
+  }
+
+  if (len > MAP_REPORT_MAX)
+    len = MAP_REPORT_MAX;
+
+  memcpy(buf, report, len);
+  memset(buf + len, 0, MAP_SCRATCH - len);
+  buf[MAP_CENTER] = 0x80;
+
+  hat = ((((buf[map->hat.byte] | (buf[map->hat.byte + 1] << 8)) >> map->hat.shift) & map->hat.mask)
+         - map->hat_min) & 0x0F;
+  buf[MAP_HAT_X] = hat_x[hat];
+  buf[MAP_HAT_Y] = hat_y[hat];
+
+  x = field_get(buf, &map->axis[MAP_X]);
+  y = field_get(buf, &map->axis[MAP_Y]);
+  t = field_get(buf, &map->axis[MAP_THROTTLE]);
+
+  for (i = 0; i < MAP_BUTTONS; i++)
+    p |= ((buf[map->button[i].byte] >> map->button[i].bit) & 1) << i;
+
+  // (8 bits to 16: 0xFF becomes 0xFFFF)
+  padmap_encode(frame, (x << 8) | x, (y << 8) | y, (t << 8) | t, p, hat_dirs[hat], map->slider);
+
+  return true;
+}
+
+int padmap_counter(padmap_t const *map, uint8_t const *report, uint16_t len)
+{
+  if (map->report_id != 0)
+  {
+    if ((len == 0) || (report[0] != map->report_id))
+      return -1;
+
+    report++;
+    len--;
+  }
+
+  if ((map->counter_bits == 0) || (map->counter_byte >= len))
+    return -1;
+
+  return (report[map->counter_byte] >> map->counter_shift) & ((1 << map->counter_bits) - 1);
+}
+
+//
+// padmap_encode - the frame's six bytes (see hid_app.c for the order of the
+//                 nybbles), and its pad, from any kind of controller
+//
+void __not_in_flash_func(padmap_encode)(xe1ap_frame_t *frame, uint32_t x, uint32_t y, uint32_t t, uint32_t p,
+                                        uint32_t dirs, bool slider)
+{
+  uint32_t a, b;
+
+  // calibration, filter, deadzone and curve, at 16 bits
+  analog_condition(frame->source, slider, &x, &y, &t);
+
+  // the XE-1AP sends 8 bits per axis
+  x >>= 8;
+  y >>= 8;
+  t >>= 8;
+
+  // A and B show as pressed in the first nybble for either A/A' or B/B'
+  a = ((p >> MAP_A) | (p >> MAP_A2)) & 1;
+  b = ((p >> MAP_B) | (p >> MAP_B2)) & 1;
+
+  frame->word[0] = ~((((p >> MAP_E1) & 1) << 7) |
+                     (((p >> MAP_E2) & 1) << 6) |
+                     (((p >> MAP_START) & 1) << 5) |
+                     (((p >> MAP_SELECT) & 1) << 4) |
+                     (a << 3) |
+                     (b << 2) |
+                     (((p >> MAP_C) & 1) << 1) |
+                     ((p >> MAP_D) & 1)) & 0xFF;
+  frame->word[1] = (x & 0xF0) | (y >> 4);
+  frame->word[2] = t >> 4;
+  frame->word[3] = ((x & 0x0F) << 4) | (y & 0x0F);
+  frame->word[4] = t & 0x0F;
+  frame->word[5] = 0xF0 | (~((((p >> MAP_A) & 1) << 3) |
+                             (((p >> MAP_B) & 1) << 2) |
+                             (((p >> MAP_A2) & 1) << 1) |
+                             ((p >> MAP_B2) & 1)) & 0x0F);
+
+  // digital mode: I and II are A and B (or A' and B'), and the d-pad, or
+  // the stick past PAD_THRESHOLD, is a direction
+  dirs |= ((x < PAD_THRESHOLD) << 3) |
+          ((y >= 0x100 - PAD_THRESHOLD) << 2) |
+          ((x >= 0x100 - PAD_THRESHOLD) << 1) |
+          (y < PAD_THRESHOLD);
+
+  frame->pad = ~((((p >> MAP_START) & 1) << 3) |
+                 (((p >> MAP_SELECT) & 1) << 2) |
+                 (b << 1) |
+                 a |
+                 (dirs << 4)) & 0xFF;
+}
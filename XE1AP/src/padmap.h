@@ -0,0 +1,121 @@
+/*
+ * padmap.h - turns a USB gamepad's report into the XE-1AP frame,
+ *            from a small per-device table
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _PADMAP_H_
+#define _PADMAP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "frame.h"
+#include "hid_layout.h"
+
+//--------------------------------------------------------------------+
+// Each device gets a map when it is mounted: either one from the static
+// table (by VID/PID), or one made from its report descriptor. The map
+// says where each axis and button is in the report, already worked out
+// as byte/shift/mask, so that making a frame out of a report is the
+// same straight run of loads, shifts and masks for every device, with
+// no branches on the report's contents.
+//
+// The report is first copied into a scratch buffer, followed by a few
+// constant bytes (for things a device doesn't have), and the hat switch
+// as X/Y (for devices without a stick).
+//--------------------------------------------------------------------+
+
+// XE-1AP axes
+//
+#define MAP_X           0
+#define MAP_Y           1
+#define MAP_THROTTLE    2
+#define MAP_AXES        3
+
+// XE-1AP buttons
+//
+#define MAP_A           0
+#define MAP_B           1
+#define MAP_C           2
+#define MAP_D           3
+#define MAP_E1          4
+#define MAP_E2          5
+#define MAP_START       6
+#define MAP_SELECT      7
+#define MAP_A2          8       // A' (the frame's first nybble shows A or A')
+#define MAP_B2          9       // B'
+#define MAP_BUTTONS     10
+
+// D-pad directions, in the order the pad shows them (see frame.h)
+//
+#define MAP_DIR_UP      0x1
+#define MAP_DIR_RIGHT   0x2
+#define MAP_DIR_DOWN    0x4
+#define MAP_DIR_LEFT    0x8
+
+// The scratch buffer: report data, then these bytes
+//
+#define MAP_REPORT_MAX  64
+#define MAP_ZERO        (MAP_REPORT_MAX + 0)    // 0x00: buttons not present
+#define MAP_CENTER      (MAP_REPORT_MAX + 1)    // 0x80: axes not present (and hat not present)
+#define MAP_HAT_X       (MAP_REPORT_MAX + 2)    // the hat switch, as axes
+#define MAP_HAT_Y       (MAP_REPORT_MAX + 3)
+#define MAP_SCRATCH     (MAP_REPORT_MAX + 5)    // (one more, for 16-bit reads)
+
+typedef struct
+{
+  uint8_t byte;                 // where the field starts, in the scratch buffer
+  uint8_t shift;                // 16 bits are read from there, and shifted right
+  uint8_t mask;
+  uint8_t left;                 // fields under 8 bits are shifted back up
+  uint8_t flip;                 // XORed at the end: 0x80 for signed, 0xFF for reversed
+} map_field_t;
+
+typedef struct
+{
+  uint8_t byte;
+  uint8_t bit;
+} map_button_t;
+
+typedef struct
+{
+  uint8_t      report_id;       // 0 = reports have no ID byte
+  map_field_t  axis[MAP_AXES];  // 8 bits, 0x80 = centre
+  bool         slider;          // the throttle is a slider (it rests at an end)
+  map_field_t  hat;             // 4 bits; 0-7 = N, NE, ... NW (else centred)
+  uint8_t      hat_min;         // taken off the hat's value first
+  map_button_t button[MAP_BUTTONS];
+  uint8_t      counter_byte;    // the device's own report counter, if it has one
+  uint8_t      counter_shift;   // (for telemetry: a gap in it is a lost report)
+  uint8_t      counter_bits;    // 0 = none
+} padmap_t;
+
+// at mount (not on the hot path): false if the device can't be used
+//
+bool padmap_find(padmap_t *map, uint16_t vid, uint16_t pid);
+bool padmap_from_layout(padmap_t *map, hid_layout_t const *layout);
+
+// for each report: false if the report isn't the one with our fields
+//
+bool padmap_frame(padmap_t const *map, uint8_t const *report, uint16_t len, xe1ap_frame_t *frame);
+
+// the report's counter (-1 if the device has none)
+//
+int padmap_counter(padmap_t const *map, uint8_t const *report, uint16_t len);
+
+// the frame encoder shared by every kind of controller:
+//   x, y, t: 16 bits (0x8000 = centre; Y: 0 = forward; throttle: 0xFFFF = most),
+//            as they come from the controller (they go through analog.h here)
+//   pressed: one bit per XE-1AP button (1 << MAP_A, ...)
+//   dirs:    the d-pad (MAP_DIR_UP, ...), added to the stick's directions
+//            in digital mode
+//   slider:  the throttle is a slider (see analog.h)
+//   (frame->source is set first, for the analog filter)
+//
+void padmap_encode(xe1ap_frame_t *frame, uint32_t x, uint32_t y, uint32_t t, uint32_t pressed,
+                   uint32_t dirs, bool slider);
+
+#endif /* _PADMAP_H_ */
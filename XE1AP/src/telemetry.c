@@ -0,0 +1,258 @@
+/*
+ * telemetry.c - report-interval, lost-report and frame-age measurement
+ *               for XE1AP
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "telemetry.h"
+
+#ifdef TELEMETRY
+
+RING_DEFINE(telem_reports, telem_event_t, 256);  // USB callbacks; up to 1000/sec
+RING_DEFINE(telem_edges, telem_event_t, 64);     // DMA interrupt; ~60/sec
+
+#define TELEM_DRAIN_MAX      32         // events folded in per call (bounds the time taken)
+#define TELEM_IDLE_US        20000      // report gaps longer than this are idle, not jitter
+
+typedef struct
+{
+  uint32_t bucket[TELEM_HIST_BUCKETS];
+  uint32_t count;
+  uint32_t max_us;
+  uint64_t sum_us;
+} telem_hist_t;
+
+typedef struct
+{
+  bool         used;
+  uint16_t     source;
+  uint32_t     reports;
+  uint32_t     prev_us;
+  uint32_t     idle_gaps;
+  int          counter_prev;    // -1 = none yet
+  uint32_t     lost;            // gaps in the controller's report counter
+  uint32_t     repeated;        // the same counter again
+  telem_hist_t interval;        // between reports
+  telem_hist_t age;             // of the frame, at each CLR edge
+} telem_dev_t;
+
+static telem_dev_t devs[TELEM_DEVICES];
+
+static uint32_t edges;
+static uint32_t edges_no_report;        // the initial frame (no controller yet)
+static uint32_t untracked;              // events from controllers past TELEM_DEVICES
+
+static uint32_t lost_reports_base;      // ring counters are reported
+static uint32_t lost_edges_base;        // relative to when the statistics were cleared
+
+
+static void telem_hist_add(telem_hist_t *h, uint32_t us)
+{
+  uint32_t i = us / TELEM_HIST_STEP_US;
+
+  if (i >= TELEM_HIST_BUCKETS)
+    i = TELEM_HIST_BUCKETS - 1;
+
+  h->bucket[i]++;
+  h->count++;
+  h->sum_us += us;
+  if (us > h->max_us)
+    h->max_us = us;
+}
+
+// upper edge of the bucket holding the given percentile
+static uint32_t telem_hist_percentile(const telem_hist_t *h, uint32_t percent)
+{
+  uint32_t target = (uint32_t)(((uint64_t)h->count * percent + 99) / 100);
+  uint32_t seen = 0;
+  int i;
+
+  for (i = 0; i < TELEM_HIST_BUCKETS; i++)
+  {
+    seen += h->bucket[i];
+    if (seen >= target)
+      break;
+  }
+  return ((i + 1) * TELEM_HIST_STEP_US);
+}
+
+void telemetry_init(void)
+{
+  memset(devs, 0, sizeof(devs));
+
+  edges = 0;
+  edges_no_report = 0;
+  untracked = 0;
+
+  lost_reports_base = telem_reports.dropped;
+  lost_edges_base = telem_edges.dropped;
+}
+
+static telem_dev_t *telem_dev(uint16_t source)
+{
+  int i;
+
+  for (i = 0; i < TELEM_DEVICES; i++)
+  {
+    if (devs[i].used && (devs[i].source == source))
+      return &devs[i];
+  }
+
+  for (i = 0; i < TELEM_DEVICES; i++)
+  {
+    if (!devs[i].used)
+    {
+      devs[i].used = true;
+      devs[i].source = source;
+      devs[i].counter_prev = -1;
+      return &devs[i];
+    }
+  }
+
+  untracked++;
+  return NULL;
+}
+
+static void telem_fold_report(const telem_event_t *ev)
+{
+  telem_dev_t *d = telem_dev(ev->source);
+  uint32_t interval, step;
+
+  if (d == NULL)
+    return;
+
+  interval = ev->t_us - d->prev_us;
+  d->prev_us = ev->t_us;
+
+  if (ev->counter_bits != 0)
+  {
+    if (d->counter_prev >= 0)
+    {
+      step = (ev->counter - d->counter_prev) & ((1 << ev->counter_bits) - 1);
+      if (step == 0)
+        d->repeated++;
+      else
+        d->lost += step - 1;
+    }
+    d->counter_prev = ev->counter;
+  }
+
+  if (d->reports++ == 0)
+    return;
+
+  if (interval > TELEM_IDLE_US)
+  {
+    d->idle_gaps++;
+    return;
+  }
+
+  telem_hist_add(&d->interval, interval);
+}
+
+static void telem_fold_edge(const telem_event_t *ev)
+{
+  telem_dev_t *d;
+
+  edges++;
+
+  if (ev->source == 0)
+  {
+    edges_no_report++;
+    return;
+  }
+
+  d = telem_dev(ev->source);
+  if (d != NULL)
+    telem_hist_add(&d->age, ev->age_us);
+}
+
+static void telem_print_hist(const char *name, const telem_hist_t *h)
+{
+  int i;
+
+  if (h->count == 0)
+  {
+    printf("  %s: no samples\r\n", name);
+    return;
+  }
+
+  printf("  %s: n=%lu avg=%luus p50<%luus p99<%luus max=%luus\r\n", name,
+         (unsigned long)h->count, (unsigned long)(h->sum_us / h->count),
+         (unsigned long)telem_hist_percentile(h, 50),
+         (unsigned long)telem_hist_percentile(h, 99),
+         (unsigned long)h->max_us);
+
+  for (i = 0; i < TELEM_HIST_BUCKETS; i++)
+  {
+    if (h->bucket[i] == 0)
+      continue;
+    printf("    %5u-%5uus%s %lu\r\n", i * TELEM_HIST_STEP_US, (i + 1) * TELEM_HIST_STEP_US,
+           (i == TELEM_HIST_BUCKETS - 1) ? "+" : " ", (unsigned long)h->bucket[i]);
+  }
+}
+
+static void telem_print(void)
+{
+  telem_dev_t *d;
+  int i;
+
+  printf("\r\n--- telemetry ---\r\n");
+
+  printf("CLR edges: %lu (%lu before any report)\r\n",
+         (unsigned long)edges, (unsigned long)edges_no_report);
+
+  for (i = 0; i < TELEM_DEVICES; i++)
+  {
+    d = &devs[i];
+    if (!d->used)
+      continue;
+
+    printf("controller %d.%d: reports=%lu idle gaps=%lu", d->source >> 8, d->source & 0xFF,
+           (unsigned long)d->reports, (unsigned long)d->idle_gaps);
+    if (d->counter_prev >= 0)
+      printf(" lost=%lu repeated=%lu", (unsigned long)d->lost, (unsigned long)d->repeated);
+    printf("\r\n");
+
+    telem_print_hist("report interval", &d->interval);
+    telem_print_hist("frame age at CLR", &d->age);
+  }
+
+  printf("events lost: reports=%lu edges=%lu; untracked controllers=%lu\r\n",
+         (unsigned long)(telem_reports.dropped - lost_reports_base),
+         (unsigned long)(telem_edges.dropped - lost_edges_base),
+         (unsigned long)untracked);
+}
+
+//
+// telemetry_task - fold queued events into the statistics;
+//                  called from the core 0 main loop
+//
+void telemetry_task(void)
+{
+  telem_event_t ev;
+  int n;
+
+  for (n = 0; (n < TELEM_DRAIN_MAX) && ring_get(&telem_reports, &ev); n++)
+    telem_fold_report(&ev);
+
+  for (n = 0; (n < TELEM_DRAIN_MAX) && ring_get(&telem_edges, &ev); n++)
+    telem_fold_edge(&ev);
+}
+
+//
+// telemetry_command - console commands: 't' prints, 'c' clears
+//
+void telemetry_command(int c)
+{
+  if ((c == 't') || (c == 'T'))
+    telem_print();
+  else if ((c == 'c') || (c == 'C'))
+    telemetry_init();
+}
+
+#endif
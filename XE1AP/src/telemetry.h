@@ -0,0 +1,81 @@
+/*
+ * telemetry.h - report-interval, lost-report and frame-age measurement
+ *               for XE1AP
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _TELEMETRY_H_
+#define _TELEMETRY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "ring.h"
+
+// Comment out the following line to compile the telemetry out entirely:
+#define TELEMETRY  true
+
+//--------------------------------------------------------------------+
+// Hot-path code only timestamps an event and puts it into a ring (one
+// ring per producer): the USB callbacks record each report, with the
+// controller's own report counter if it has one, and the DMA interrupt
+// at each CLR edge records how old the frame being sent is (from when
+// it was published; see frame.h).
+//
+// telemetry_task() runs in the core 0 main loop, folds the events into
+// statistics per controller, and prints them when asked to over the UART
+// console ('t' = print, 'c' = clear). The USB port is in host mode, so
+// there is no CDC channel.
+//--------------------------------------------------------------------+
+
+typedef struct
+{
+  uint32_t t_us;
+  uint32_t age_us;      // edge: age of the frame sent
+  uint16_t source;      // controller (FRAME_SOURCE; see frame.h)
+  uint8_t  counter;     // report: the controller's report counter
+  uint8_t  counter_bits;// report: 0 = none; edge: 0xFF
+} telem_event_t;
+
+#define TELEM_EDGE          0xFF
+
+#define TELEM_DEVICES       4           // controllers tracked (the first ones seen)
+#define TELEM_HIST_BUCKETS  64
+#define TELEM_HIST_STEP_US  250         // last bucket also holds anything longer
+
+#ifdef TELEMETRY
+
+extern ring_t telem_reports;
+extern ring_t telem_edges;
+
+void telemetry_init(void);
+void telemetry_task(void);
+void telemetry_command(int c);
+
+// counter: -1 if the controller has none
+//
+static inline void telemetry_report(uint32_t now_us, uint16_t source, int counter, uint8_t counter_bits)
+{
+  telem_event_t ev = { now_us, 0, source, (uint8_t)counter, (counter < 0) ? 0 : counter_bits };
+  ring_put(&telem_reports, &ev);
+}
+
+static inline void telemetry_edge(uint32_t now_us, uint16_t source, uint32_t age_us)
+{
+  telem_event_t ev = { now_us, age_us, source, 0, TELEM_EDGE };
+  ring_put(&telem_edges, &ev);
+}
+
+#else
+
+static inline void telemetry_init(void) { }
+static inline void telemetry_task(void) { }
+static inline void telemetry_command(int c) { }
+static inline void telemetry_report(uint32_t now_us, uint16_t source, int counter, uint8_t counter_bits) { }
+static inline void telemetry_edge(uint32_t now_us, uint16_t source, uint32_t age_us) { }
+
+#endif
+
+#endif /* _TELEMETRY_H_ */
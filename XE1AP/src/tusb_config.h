@@ -79,6 +79,7 @@
 #define CFG_TUH_HID                 4 // typical keyboard + mouse device can have 3-4 HID interfaces
 #define CFG_TUH_MSC                 0
 #define CFG_TUH_VENDOR              0
+#define CFG_TUH_XINPUT              1 // Xbox controllers (see xinput.h; TinyUSB 0.16 or later)
 
 // max device support (excluding hub device)
 // 1 hub typically has 4 ports
@@ -0,0 +1,344 @@
+/*
+ * xinput.c - Xbox 360 / Xbox One (XInput / GIP) controllers, as a TinyUSB
+ *            application host driver
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#include "bsp/board.h"
+#include "tusb.h"
+
+#include "xinput.h"
+
+#if XINPUT_HOST
+
+#include "host/usbh_pvt.h"
+#include "pico/stdlib.h"
+
+#include "frame.h"
+#include "padmap.h"
+#include "telemetry.h"
+
+#define XINPUT_360      0
+#define XINPUT_ONE      1
+
+#define XINPUT_EP_BUFSIZE   64
+
+typedef struct
+{
+  uint8_t dev_addr;             // 0 = free
+  uint8_t itf_num;
+  uint8_t type;
+  uint8_t ep_in;
+  uint8_t ep_out;
+  uint8_t report[XINPUT_EP_BUFSIZE];
+} xinput_dev_t;
+
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static xinput_dev_t xinput_dev[CFG_TUH_DEVICE_MAX];
+
+// Xbox One controllers send nothing until they are told to start
+//
+CFG_TUSB_MEM_SECTION CFG_TUSB_MEM_ALIGN static uint8_t gip_start[] = { 0x05, 0x20, 0x00, 0x01, 0x00 };
+
+// Report layouts detail https://github.com/torvalds/linux/blob/master/drivers/input/joystick/xpad.c
+//
+// Xbox 360 (type 0x00, 20 bytes):
+//   2: up, down, left, right, start, back, LS, RS
+//   3: LB, RB, guide, -, A, B, X, Y
+//   4-5: LT, RT (8 bits)
+//   6-13: LX, LY, RX, RY (signed 16 bits, up is positive)
+//
+// Xbox One (type 0x20, 18 bytes or more):
+//   2: sequence number
+//   4: sync, -, menu, view, A, B, X, Y
+//   5: up, down, left, right, LB, RB, LS, RS
+//   6-9: LT, RT (10 bits, in 16)
+//   10-17: LX, LY, RX, RY (signed 16 bits, up is positive)
+//
+// The buttons go where the DualShock 4 ones do (see padmap.c), by position;
+// the triggers are the throttle (RT for more, LT for less), so D and B' are
+// the stick buttons. The d-pad is a pad's directions in digital mode.
+//
+typedef struct
+{
+  uint8_t type;                 // first byte of the reports with the controls
+  uint8_t len;                  // shortest such report
+  uint8_t buttons;              // 16 bits of buttons
+  uint8_t dpad;                 // up, down, left, right: from this bit of them
+  uint8_t triggers;             // LT, RT
+  uint8_t trigger_bits;         // (in one byte each, or two)
+  uint8_t sticks;               // LX, LY
+  uint8_t counter;              // report counter (for telemetry)
+  uint8_t counter_bits;         // 0 = none
+  uint8_t button[MAP_BUTTONS];  // bit, in the 16 bits of buttons
+} xinput_layout_t;
+
+static const xinput_layout_t layouts[2] =
+{
+  [XINPUT_360] =
+  {
+    .type = 0x00, .len = 14, .buttons = 2, .dpad = 0, .triggers = 4, .trigger_bits = 8, .sticks = 6,
+    .counter_bits = 0,
+    .button =
+    {
+      [MAP_A]      = 13,          // B
+      [MAP_B]      = 12,          // A
+      [MAP_C]      = 8,           // LB
+      [MAP_D]      = 6,           // LS
+      [MAP_E1]     = 14,          // X
+      [MAP_E2]     = 15,          // Y
+      [MAP_START]  = 4,           // start
+      [MAP_SELECT] = 5,           // back
+      [MAP_A2]     = 9,           // RB
+      [MAP_B2]     = 7,           // RS
+    },
+  },
+  [XINPUT_ONE] =
+  {
+    .type = 0x20, .len = 18, .buttons = 4, .dpad = 8, .triggers = 6, .trigger_bits = 10, .sticks = 10,
+    .counter = 2, .counter_bits = 8,
+    .button =
+    {
+      [MAP_A]      = 5,           // B
+      [MAP_B]      = 4,           // A
+      [MAP_C]      = 12,          // LB
+      [MAP_D]      = 14,          // LS
+      [MAP_E1]     = 6,           // X
+      [MAP_E2]     = 7,           // Y
+      [MAP_START]  = 2,           // menu
+      [MAP_SELECT] = 3,           // view
+      [MAP_A2]     = 13,          // RB
+      [MAP_B2]     = 15,          // RS
+    },
+  },
+};
+
+static inline uint32_t get16(uint8_t const *p)
+{
+  return p[0] | (p[1] << 8);
+}
+
+static xinput_dev_t *xinput_lookup(uint8_t dev_addr)
+{
+  int i;
+
+  for (i = 0; i < CFG_TUH_DEVICE_MAX; i++)
+  {
+    if (xinput_dev[i].dev_addr == dev_addr)
+      return &xinput_dev[i];
+  }
+  return NULL;
+}
+
+static bool xinput_receive(xinput_dev_t *dev)
+{
+  if (!usbh_edpt_claim(dev->dev_addr, dev->ep_in))
+    return false;
+
+  if (!usbh_edpt_xfer(dev->dev_addr, dev->ep_in, dev->report, sizeof(dev->report)))
+  {
+    usbh_edpt_release(dev->dev_addr, dev->ep_in);
+    return false;
+  }
+  return true;
+}
+
+//
+// xinput_report - one report into the frame; the axes stay at 16 bits until
+//                 the encoder
+//
+static void __not_in_flash_func(xinput_report)(xinput_dev_t const *dev, uint32_t len)
+{
+  xinput_layout_t const *layout = &layouts[dev->type];
+  uint8_t const *r = dev->report;
+  uint32_t now = time_us_32();
+  xe1ap_frame_t *frame;
+  uint32_t buttons, d, dirs, lt, rt, x, y, t;
+  uint32_t p = 0;
+  int bits;
+  int i;
+
+  if ((len < layout->len) || (r[0] != layout->type))
+    return;
+
+  buttons = get16(r + layout->buttons);
+  for (i = 0; i < MAP_BUTTONS; i++)
+    p |= ((buttons >> layout->button[i]) & 1) << i;
+
+  // the d-pad, for digital mode
+  d = buttons >> layout->dpad;
+  dirs = ((d & 1) ? MAP_DIR_UP : 0) | ((d & 2) ? MAP_DIR_DOWN : 0) |
+         ((d & 4) ? MAP_DIR_LEFT : 0) | ((d & 8) ? MAP_DIR_RIGHT : 0);
+
+  // signed to offset (0x8000 = centre); Y is flipped, to 0 = forward
+  x = get16(r + layout->sticks) ^ 0x8000;
+  y = get16(r + layout->sticks + 2) ^ 0x7FFF;
+
+  // each trigger to 15 bits (the top bits repeated below), then either side
+  // of centre
+  bits = layout->trigger_bits;
+  lt = get16(r + layout->triggers) & ((1 << bits) - 1);
+  rt = get16(r + layout->triggers + ((bits + 7) >> 3)) & ((1 << bits) - 1);
+
+  lt = ((lt << (15 - bits)) | (lt >> (2 * bits - 15))) & 0x7FFF;
+  rt = ((rt << (15 - bits)) | (rt >> (2 * bits - 15))) & 0x7FFF;
+  t = 0x8000 + rt - lt;
+
+  frame = frame_begin();
+  frame->source = FRAME_SOURCE(dev->dev_addr, dev->itf_num);
+  padmap_encode(frame, x, y, t, p, dirs, false);
+  frame_publish();
+
+  telemetry_report(now, frame->source, layout->counter_bits ? r[layout->counter] : -1, layout->counter_bits);
+}
+
+//--------------------------------------------------------------------+
+// Class driver
+//--------------------------------------------------------------------+
+
+static void xinput_init(void)
+{
+  tu_memclr(xinput_dev, sizeof(xinput_dev));
+}
+
+static bool xinput_open(uint8_t rhport, uint8_t dev_addr, tusb_desc_interface_t const *desc_itf, uint16_t max_len)
+{
+  uint8_t const *p = (uint8_t const *) desc_itf;
+  uint8_t const *end = p + max_len;
+  tusb_desc_endpoint_t const *ep;
+  xinput_dev_t *dev;
+  uint8_t type;
+  int found = 0;
+
+  (void) rhport;
+
+  if (desc_itf->bInterfaceClass != XINPUT_CLASS)
+    return false;
+
+  if ((desc_itf->bInterfaceSubClass == XINPUT_SUBCLASS_360) && (desc_itf->bInterfaceProtocol == XINPUT_PROTOCOL_360))
+    type = XINPUT_360;
+  else if ((desc_itf->bInterfaceSubClass == XINPUT_SUBCLASS_ONE) && (desc_itf->bInterfaceProtocol == XINPUT_PROTOCOL_ONE))
+    type = XINPUT_ONE;
+  else
+    return false;
+
+  // only the first such interface (the others are audio and the like)
+  if (xinput_lookup(dev_addr) != NULL)
+    return false;
+
+  dev = xinput_lookup(0);
+  if (dev == NULL)
+    return false;
+
+  dev->ep_in = 0;
+  dev->ep_out = 0;
+
+  // (the 360 has a vendor descriptor before its endpoints)
+  for (p = tu_desc_next(p); (p < end) && (found < desc_itf->bNumEndpoints); p = tu_desc_next(p))
+  {
+    if (tu_desc_type(p) == TUSB_DESC_INTERFACE)
+      break;
+
+    if (tu_desc_type(p) != TUSB_DESC_ENDPOINT)
+      continue;
+
+    ep = (tusb_desc_endpoint_t const *) p;
+    if (ep->bmAttributes.xfer != TUSB_XFER_INTERRUPT)
+      continue;
+
+    if (!tuh_edpt_open(dev_addr, ep))
+      return false;
+
+    if (tu_edpt_dir(ep->bEndpointAddress) == TUSB_DIR_IN)
+      dev->ep_in = ep->bEndpointAddress;
+    else
+      dev->ep_out = ep->bEndpointAddress;
+    found++;
+  }
+
+  if (dev->ep_in == 0)
+    return false;
+
+  dev->dev_addr = dev_addr;
+  dev->itf_num = desc_itf->bInterfaceNumber;
+  dev->type = type;
+
+  return true;
+}
+
+static bool xinput_set_config(uint8_t dev_addr, uint8_t itf_num)
+{
+  xinput_dev_t *dev = xinput_lookup(dev_addr);
+
+  if (dev == NULL)
+    return false;
+
+  printf("XInput device address = %d is mounted (%s)\r\n", dev_addr,
+         (dev->type == XINPUT_ONE) ? "Xbox One" : "Xbox 360");
+
+  if ((dev->type == XINPUT_ONE) && (dev->ep_out != 0))
+  {
+    if (usbh_edpt_claim(dev_addr, dev->ep_out))
+    {
+      if (!usbh_edpt_xfer(dev_addr, dev->ep_out, gip_start, sizeof(gip_start)))
+        usbh_edpt_release(dev_addr, dev->ep_out);
+    }
+  }
+
+  if (!xinput_receive(dev))
+    printf("Error: cannot request to receive report\r\n");
+
+  usbh_driver_set_config_complete(dev_addr, itf_num);
+  return true;
+}
+
+static bool xinput_xfer_cb(uint8_t dev_addr, uint8_t ep_addr, xfer_result_t result, uint32_t xferred_bytes)
+{
+  xinput_dev_t *dev = xinput_lookup(dev_addr);
+
+  if ((dev == NULL) || (ep_addr != dev->ep_in))
+    return true;
+
+  if (result == XFER_RESULT_SUCCESS)
+    xinput_report(dev, xferred_bytes);
+
+  // continue to request to receive report
+  if (!xinput_receive(dev))
+    printf("Error: cannot request to receive report\r\n");
+
+  return true;
+}
+
+static void xinput_close(uint8_t dev_addr)
+{
+  xinput_dev_t *dev = xinput_lookup(dev_addr);
+
+  if (dev == NULL)
+    return;
+
+  printf("XInput device address = %d is unmounted\r\n", dev_addr);
+  dev->dev_addr = 0;
+}
+
+static const usbh_class_driver_t xinput_driver =
+{
+#if CFG_TUSB_DEBUG >= 2
+  .name       = "XINPUT",
+#endif
+  .init       = xinput_init,
+  .open       = xinput_open,
+  .set_config = xinput_set_config,
+  .xfer_cb    = xinput_xfer_cb,
+  .close      = xinput_close,
+};
+
+// TinyUSB asks for the application's drivers when the host stack starts
+//
+usbh_class_driver_t const *usbh_app_driver_get_cb(uint8_t *driver_count)
+{
+  *driver_count = 1;
+  return &xinput_driver;
+}
+
+#endif /* XINPUT_HOST */
@@ -0,0 +1,35 @@
+/*
+ * xinput.h - Xbox 360 / Xbox One (XInput / GIP) controllers, as a TinyUSB
+ *            application host driver
+ *
+ * Part of PC_Engine_RP2040_Projects (MIT License; see LICENSE)
+ *
+ */
+
+#ifndef _XINPUT_H_
+#define _XINPUT_H_
+
+#include "tusb.h"
+
+//--------------------------------------------------------------------+
+// These controllers are not HID (vendor class 0xFF), so TinyUSB does not
+// claim them; this driver does, through the application driver hook
+// (usbh_app_driver_get_cb), which TinyUSB has from version 0.16 on. The
+// TinyUSB in Pico-SDK 1.5.0 is 0.15, so the driver is left out of the
+// build unless a newer TinyUSB is used (PICO_TINYUSB_PATH).
+//
+// Reports go to the same frame encoder as HID controllers (see padmap.h),
+// with the sticks and triggers at their full precision.
+//--------------------------------------------------------------------+
+
+#define XINPUT_HOST     (CFG_TUH_XINPUT && ((TUSB_VERSION_MAJOR > 0) || (TUSB_VERSION_MINOR >= 16)))
+
+// Interfaces claimed
+//
+#define XINPUT_CLASS            0xFF
+#define XINPUT_SUBCLASS_360     0x5D    // Xbox 360 (and most XInput pads)
+#define XINPUT_PROTOCOL_360     0x01
+#define XINPUT_SUBCLASS_ONE     0x47    // Xbox One / Series (GIP)
+#define XINPUT_PROTOCOL_ONE     0xD0
+
+#endif /* _XINPUT_H_ */